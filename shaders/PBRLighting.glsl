@@ -1,4 +1,6 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
 
 const float PI = 3.14159265359;
 
@@ -11,19 +13,19 @@ layout(location = 2) in vec2 inTexCoords;
 layout(location = 0) out vec3 Normal;
 layout(location = 1) out vec3 Pos;
 layout(location = 2) out vec2 TexCoords;
+invariant gl_Position;
 
 
-layout(binding = 0) uniform _{
-    mat4 _model;
-    mat4 _view;
-    mat4 _proj;
-};
+#include "include/objects.glsl"
+
+#include "include/frame.glsl"
 
 
 void main() {
-    gl_Position = _proj * _view * _model * vec4(inPosition, 1.0);
-    Pos = vec3(_model * vec4(inPosition, 1.0));
-    Normal = mat3(transpose(inverse(_model))) * inNormal;
+    mat4 model = objectModel();
+    gl_Position = _frame.proj * _frame.view * model * vec4(inPosition, 1.0);
+    Pos = vec3(model * vec4(inPosition, 1.0));
+    Normal = mat3(transpose(inverse(model))) * inNormal;
     TexCoords = inTexCoords;
 }
 
@@ -37,19 +39,20 @@ layout(location = 2) in vec2 TexCoords;
 
 layout(location = 0) out vec4 outColor;
 
-layout(binding = 3) uniform _{
-    //vec3 lightcolor;
-    vec3 lightPos;
-    vec3 _viewPos;
-};
+#include "include/frame.glsl"
+#include "include/clusteredLights.glsl"
+#include "include/shadows.glsl"
+#include "include/bindless.glsl"
 
-layout(binding = 2) uniform _1{
+layout(set = 1, binding = 2) uniform _1{
     vec3 inAlbedo;
     float inMetallic;
     float inRoughness;
     float inReflectance;
 };
-layout(binding = 9) uniform samplerCube Skybox;
+layout(set = 1, binding = 9) uniform textures{
+    TextureCube Skybox;
+};
 
 
 vec3 fresnelSchlick(float cosTheta, vec3 F0){
@@ -88,11 +91,11 @@ float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness){
 
 
 void main() {
-    vec3 V = normalize(_viewPos - FragPos);
+    vec3 V = normalize(_frame.viewPos.xyz - FragPos);
     vec3 N = normalize(Normal);
     vec3 R = reflect(-V, N);
 
-    vec3 metallicColor = texture(Skybox, R).rgb;
+    vec3 metallicColor = texture(bindlessCube(Skybox), R).rgb;
 
     float metallic = clamp(inMetallic,0.0,1.0);
     float roughness = clamp(inRoughness,0.0,1.0);
@@ -100,28 +103,33 @@ void main() {
     vec3 albedo = inAlbedo;
     vec3 reflectColor = albedo * (1.0 - reflectance) + metallicColor * reflectance * (1.0 - roughness);
 
-    const vec3 lightColor = vec3(1.0, 1.0, 1.0);
+    //vec3 F0 = albedo * (1.0 - metallic) + metallicColor * metallic;
+    vec3 F0 = mix(vec3(0.16), albedo, metallic);
 
-    vec3 L = normalize(lightPos - FragPos);
-    vec3 H = normalize(V + L);
+    vec3 Lo = vec3(0.0);
 
-    float dist = length(lightPos - FragPos);
-    float attenuation = 1.0 / (dist * dist);
-    vec3 radiance = lightColor * attenuation;
+    uint cluster = clusterIndex(gl_FragCoord);
+    uint lightCount = clusterLightCount(cluster);
+    float viewDepth = linearDepth(gl_FragCoord.z);
 
-    //vec3 F0 = albedo * (1.0 - metallic) + metallicColor * metallic;
-    vec3 F0 = mix(vec3(0.16), albedo, metallic);
-    vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
+    for(uint i = 0; i < lightCount; i++){
+        vec3 L;
+        Light lightSource = clusterLight(cluster, i);
+        vec3 radiance = lightRadiance(lightSource, FragPos, L) * lightShadow(lightSource, FragPos, N, viewDepth);
+        vec3 H = normalize(V + L);
+
+        vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
 
-    vec3 kD = vec3(1.0) - F;
-    kD *= 1.1 - metallic;
+        vec3 kD = vec3(1.0) - F;
+        kD *= 1.1 - metallic;
 
-    float NDF = DistributionGGX(N, H, roughness);       
-    float G = GeometrySmith(N, V, L, roughness);
-    vec3 specular = (NDF * G * albedo) / (4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001);
+        float NDF = DistributionGGX(N, H, roughness);       
+        float G = GeometrySmith(N, V, L, roughness);
+        vec3 specular = (NDF * G * albedo) / (4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001);
 
-    float NdotL = max(dot(N, L), 0.0);                
-    vec3 Lo = (kD * reflectColor / PI + specular)  * radiance * NdotL;
+        float NdotL = max(dot(N, L), 0.0);                
+        Lo += (kD * reflectColor / PI + specular)  * radiance * NdotL;
+    }
 
     vec3 ambient = vec3(0.001) * reflectColor;
 
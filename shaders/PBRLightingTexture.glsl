@@ -1,4 +1,6 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
 
 const float PI = 3.14159265359;
 
@@ -11,19 +13,19 @@ layout(location = 2) in vec2 inTexCoords;
 layout(location = 0) out vec3 Normal;
 layout(location = 1) out vec3 Pos;
 layout(location = 2) out vec2 TexCoords;
+invariant gl_Position;
 
 
-layout(binding = 0) uniform _{
-    mat4 _model;
-    mat4 _view;
-    mat4 _proj;
-};
+#include "include/objects.glsl"
+
+#include "include/frame.glsl"
 
 
 void main() {
-    gl_Position = _proj * _view * _model * vec4(inPosition, 1.0);
-    Pos = vec3(_model * vec4(inPosition, 1.0));
-    Normal = mat3(transpose(inverse(_model))) * inNormal;
+    mat4 model = objectModel();
+    gl_Position = _frame.proj * _frame.view * model * vec4(inPosition, 1.0);
+    Pos = vec3(model * vec4(inPosition, 1.0));
+    Normal = mat3(transpose(inverse(model))) * inNormal;
     TexCoords = inTexCoords;
 }
 
@@ -37,20 +39,21 @@ layout(location = 2) in vec2 TexCoords;
 
 layout(location = 0) out vec4 outColor;
 
-layout(binding = 3) uniform _{
-    //vec3 lightcolor;
-    vec3 lightPos;
-    vec3 _viewPos;
+#include "include/frame.glsl"
+#include "include/clusteredLights.glsl"
+#include "include/shadows.glsl"
+#include "include/bindless.glsl"
+
+layout(set = 1, binding = 2) uniform textures{
+    Texture2D albedoTex;
+    Texture2D normTex;
+    Texture2D heightTex;
+    Texture2D aoTex;
+    Texture2D metallicTex;
+    Texture2D roughnessTex;
+    TextureCube Skybox;
 };
 
-layout(binding = 2) uniform sampler2D albedoTex;
-layout(binding = 4) uniform sampler2D normTex;
-layout(binding = 5) uniform sampler2D heightTex;
-layout(binding = 6) uniform sampler2D aoTex;
-layout(binding = 7) uniform sampler2D metallicTex;
-layout(binding = 8) uniform sampler2D roughnessTex;
-layout(binding = 9) uniform samplerCube Skybox;
-
 
 mat3 cotangent_frame(vec3 N, vec3 p, vec2 uv){ 
     // get edge vectors of the pixel triangle 
@@ -68,10 +71,10 @@ mat3 cotangent_frame(vec3 N, vec3 p, vec2 uv){
     return mat3(T * invmax, B * invmax, N ); 
 }
 
-vec3 perturb_normal(vec3 N, vec3 V, vec2 texcoord, sampler2D tak){
+vec3 perturb_normal(vec3 N, vec3 V, vec2 texcoord, Texture2D tak){
     // assume N, the interpolated vertex normal and 
     // V, the view vector (vertex to eye) 
-    vec3 map = texture(tak, texcoord).xyz; 
+    vec3 map = textureBindless(tak, texcoord).xyz; 
     mat3 TBN = cotangent_frame( N, -V, texcoord ); 
     return normalize( TBN * map );
 }
@@ -85,18 +88,18 @@ vec2 ParallaxMapping(vec2 texCoord, vec3 viewDir){
     vec2 deltaTexCoords = P / numLayers;
 
     vec2  currentTexCoords = texCoord;
-    float currentDepthMapValue = texture(heightTex, currentTexCoords).r;
+    float currentDepthMapValue = textureBindless(heightTex, currentTexCoords).r;
     
     while(currentLayerDepth < currentDepthMapValue){
         currentTexCoords -= deltaTexCoords;
-        currentDepthMapValue = texture(heightTex, currentTexCoords).r;  
+        currentDepthMapValue = textureBindless(heightTex, currentTexCoords).r;  
         currentLayerDepth += layerDepth;  
     }
 
     vec2 prevTexCoords = currentTexCoords + deltaTexCoords;
 
     float afterDepth  = currentDepthMapValue - currentLayerDepth;
-    float beforeDepth = texture(heightTex, prevTexCoords).r - currentLayerDepth + layerDepth;
+    float beforeDepth = textureBindless(heightTex, prevTexCoords).r - currentLayerDepth + layerDepth;
     
     float weight = afterDepth / (afterDepth - beforeDepth);
     vec2 finalTexCoords = prevTexCoords * weight + currentTexCoords * (1.0 - weight);
@@ -141,30 +144,31 @@ float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness){
 }
 
 void main() {
-    vec3 V = normalize(_viewPos - FragPos);
+    vec3 V = normalize(_frame.viewPos.xyz - FragPos);
     vec2 texCoord = ParallaxMapping(TexCoords,  V);
     vec3 N = perturb_normal(Normal, V, texCoord, normTex);
     vec3 R = reflect(-V, normalize(Normal));
 
-    vec3 albedo = pow(texture(albedoTex, texCoord).rgb, vec3(2.2));
-    float metallic = texture(metallicTex, texCoord).r;
-    float roughness = texture(roughnessTex, texCoord).r;
-    float AO = texture(aoTex, texCoord).r;
-    vec3 metallicColor = texture(Skybox, R).rgb;
-
-    const vec3 lightColor = vec3(1.0, 1.0, 1.0);
+    vec3 albedo = pow(textureBindless(albedoTex, texCoord).rgb, vec3(2.2));
+    float metallic = textureBindless(metallicTex, texCoord).r;
+    float roughness = textureBindless(roughnessTex, texCoord).r;
+    float AO = textureBindless(aoTex, texCoord).r;
+    vec3 metallicColor = texture(bindlessCube(Skybox), R).rgb;
 
     vec3 F0 = vec3(0.04);
     F0 = mix(F0, albedo, metallic);
 
     vec3 Lo = vec3(0.0);
-    for(int i = 0; i < 1; i++){
-        vec3 L = normalize(lightPos - FragPos);
-        vec3 H = normalize(V + L);
 
-        float dist = length(lightPos - FragPos);
-        float attenuation = 1.0 / (dist * dist);
-        vec3 radiance = lightColor * attenuation;
+    uint cluster = clusterIndex(gl_FragCoord);
+    uint lightCount = clusterLightCount(cluster);
+    float viewDepth = linearDepth(gl_FragCoord.z);
+
+    for(uint i = 0; i < lightCount; i++){
+        vec3 L;
+        Light lightSource = clusterLight(cluster, i);
+        vec3 radiance = lightRadiance(lightSource, FragPos, L) * lightShadow(lightSource, FragPos, normalize(Normal), viewDepth);
+        vec3 H = normalize(V + L);
 
         float NDF = DistributionGGX(N, H, roughness);       
         float G = GeometrySmith(N, V, L, roughness);
@@ -0,0 +1,70 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#ifdef COMPUTE
+
+#define CLUSTER_LIGHTS_ACCESS writeonly
+#include "include/clusteredLights.glsl"
+
+layout(local_size_x = 64) in;
+
+// Point on the view ray through a pixel at the given view space depth
+vec3 viewPosition(vec2 pixel, float depth){
+    vec2 ndc = pixel / _lights.tile.zw * 2.0 - 1.0;
+    vec4 view = _lights.invProj * vec4(ndc, 0.0, 1.0);
+    view.xyz /= view.w;
+    return view.xyz * (depth / -view.z);
+}
+
+bool sphereIntersectsAabb(vec3 center, float radius, vec3 aabbMin, vec3 aabbMax){
+    vec3 closest = clamp(center, aabbMin, aabbMax);
+    vec3 delta = closest - center;
+    return dot(delta, delta) <= radius * radius;
+}
+
+void main() {
+    uint clusterCount = _lights.grid.x * _lights.grid.y * _lights.grid.z;
+    uint cluster = gl_GlobalInvocationID.x;
+
+    if(cluster >= clusterCount){
+        return;
+    }
+
+    uvec3 id = uvec3(cluster % _lights.grid.x, (cluster / _lights.grid.x) % _lights.grid.y, cluster / (_lights.grid.x * _lights.grid.y));
+
+    // Exponential depth slices, inverse of the slice computation in clusterIndex
+    float near = exp((float(id.z) - _lights.depth.w) / _lights.depth.z);
+    float far = exp((float(id.z + 1) - _lights.depth.w) / _lights.depth.z);
+
+    vec2 tileMin = vec2(id.xy) * _lights.tile.xy;
+    vec2 tileMax = min(vec2(id.xy + 1) * _lights.tile.xy, _lights.tile.zw);
+
+    vec3 p0 = viewPosition(tileMin, near), p1 = viewPosition(tileMax, near);
+    vec3 p2 = viewPosition(tileMin, far), p3 = viewPosition(tileMax, far);
+
+    vec3 aabbMin = min(min(p0, p1), min(p2, p3));
+    vec3 aabbMax = max(max(p0, p1), max(p2, p3));
+
+    uint base = cluster * (MAX_CLUSTER_LIGHTS + 1);
+    uint count = 0;
+
+    for(uint i = 0; i < _lights.grid.w && count < MAX_CLUSTER_LIGHTS; i++){
+        Light light = _lights.lights[i];
+
+        bool visible = uint(light.directionType.w) == LIGHT_DIRECTIONAL;
+
+        if(!visible){
+            vec3 center = (_lights.view * vec4(light.positionRange.xyz, 1.0)).xyz;
+            visible = sphereIntersectsAabb(center, light.positionRange.w, aabbMin, aabbMax);
+        }
+
+        if(visible){
+            _clusterLights.indices[base + 1 + count] = i;
+            count++;
+        }
+    }
+
+    _clusterLights.indices[base] = count;
+}
+
+#endif
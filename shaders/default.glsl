@@ -1,4 +1,6 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
 
 #ifdef VERTEX
 
@@ -8,15 +10,15 @@ layout(location = 2) in vec2 inTexCoords;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 texCoords;
+invariant gl_Position;
 
-layout(binding = 0) uniform _{
-    mat4 _model;
-    mat4 _view;
-    mat4 _proj;
-};
+#include "include/objects.glsl"
+
+#include "include/frame.glsl"
 
 void main() {
-    gl_Position = _proj * _view * _model * vec4(inPosition, 1.0);
+    mat4 model = objectModel();
+    gl_Position = _frame.proj * _frame.view * model * vec4(inPosition, 1.0);
     texCoords = inTexCoords;
     fragColor = vec3(1.0, 1.0, 0.0);
 }
@@ -30,13 +32,15 @@ layout(location = 0) out vec4 outColor;
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 texCoords;
 
-layout(binding = 1) uniform sampler2D tex;
-layout(binding = 2) uniform _{
+#include "include/bindless.glsl"
+
+layout(set = 1, binding = 2) uniform _{
+    Texture2D tex;
     vec3 color;
 };
 
 void main() {
-    outColor = texture(tex, texCoords);
+    outColor = textureBindless(tex, texCoords);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,151 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#ifdef COMPUTE
+
+#include "include/objects.glsl"
+
+layout(local_size_x = 64) in;
+
+// Compacted VkDrawIndexedIndirectCommand of each bucket, 5 uints per command
+layout(std430, binding = 1) writeonly buffer DrawCommandBuffer{
+    uint commands[];
+} _drawCommands;
+
+layout(std430, binding = 2) buffer DrawCountBuffer{
+    uint counts[];
+} _drawCounts;
+
+// 1 for objects visible in the last late phase, persistent across frames
+layout(std430, binding = 3) buffer VisibilityBuffer{
+    uint visible[];
+} _visibility;
+
+layout(std430, binding = 4) buffer CullingStatsBuffer{
+    uint frustumCulled;
+    uint occluded;
+    uint earlyDraws;
+    uint lateDraws;
+} _cullingStats;
+
+// Farthest depth pyramid of the early phase depth, bound for the late phase
+layout(binding = 5) uniform sampler2D _hiZ;
+
+bool isVisible(Object object){
+    vec3 center = (object.boundsMin.xyz + object.boundsMax.xyz) * 0.5;
+    vec3 extent = (object.boundsMax.xyz - object.boundsMin.xyz) * 0.5;
+
+    vec3 worldCenter = vec3(object.model * vec4(center, 1.0));
+    mat3 model = mat3(object.model);
+    vec3 worldExtent = mat3(abs(model[0]), abs(model[1]), abs(model[2])) * extent;
+
+    for(int i = 0; i < 6; i++){
+        vec4 plane = _objects.frustum[i];
+        if(dot(plane.xyz, worldCenter) + dot(abs(plane.xyz), worldExtent) + plane.w < 0.0){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Bounds projected to the screen are compared with the farthest depth of the pyramid texels they cover
+bool isOccluded(Object object){
+    mat4 modelViewProj = _objects.proj * _objects.view * object.model;
+
+    vec3 ndcMin = vec3(1.0);
+    vec3 ndcMax = vec3(-1.0);
+
+    for(int i = 0; i < 8; i++){
+        vec3 corner = mix(object.boundsMin.xyz, object.boundsMax.xyz, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+        vec4 clip = modelViewProj * vec4(corner, 1.0);
+
+        // Bounds crossing the camera plane cannot be projected
+        if(clip.w <= 0.0){
+            return false;
+        }
+
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc);
+        ndcMax = max(ndcMax, ndc);
+    }
+
+    vec2 extent = _objects.hiZ.xy;
+    vec2 pixelMin = clamp((ndcMin.xy * 0.5 + 0.5) * extent, vec2(0.0), extent - 1.0);
+    vec2 pixelMax = clamp((ndcMax.xy * 0.5 + 0.5) * extent, vec2(0.0), extent - 1.0);
+
+    // A texel of level n covers 2^(n+1) pixels, the level is picked so the rectangle spans at most 2x2 texels
+    vec2 size = pixelMax - pixelMin;
+    int level = int(clamp(ceil(log2(max(max(size.x, size.y), 1.0))) - 1.0, 0.0, _objects.hiZ.z - 1.0));
+
+    ivec2 texelMin = ivec2(pixelMin) >> (level + 1);
+    ivec2 texelMax = ivec2(pixelMax) >> (level + 1);
+
+    float depth = max(
+        max(texelFetch(_hiZ, texelMin, level).r, texelFetch(_hiZ, ivec2(texelMax.x, texelMin.y), level).r),
+        max(texelFetch(_hiZ, ivec2(texelMin.x, texelMax.y), level).r, texelFetch(_hiZ, texelMax, level).r)
+    );
+
+    return ndcMin.z > depth;
+}
+
+// Early phase: objects visible last frame are drawn into the depth pre-pass
+// Late phase: every object is tested against the pyramid built from that depth, newly visible ones are drawn by the main pass,
+// so objects coming into view appear in the same frame instead of a frame late
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+
+    if(index >= _objects.count.x){
+        return;
+    }
+
+    Object object = _objects.objects[index];
+    bool occlusion = _objects.hiZ.w != 0.0;
+    bool late = _objects.count.w != 0;
+    bool wasVisible = _visibility.visible[index] != 0;
+
+    if(occlusion && !late && !wasVisible){
+        return;
+    }
+
+    bool visible = _objects.count.y == 0 || isVisible(object);
+
+    if(!visible && (late || !occlusion)){
+        atomicAdd(_cullingStats.frustumCulled, 1);
+    }
+
+    if(late){
+        if(visible && isOccluded(object)){
+            visible = false;
+            atomicAdd(_cullingStats.occluded, 1);
+        }
+
+        _visibility.visible[index] = visible ? 1 : 0;
+
+        // Drawn in the early phase already
+        if(wasVisible){
+            return;
+        }
+    }
+
+    if(!visible){
+        return;
+    }
+
+    if(late){
+        atomicAdd(_cullingStats.lateDraws, 1);
+    }else{
+        atomicAdd(_cullingStats.earlyDraws, 1);
+    }
+
+    // Late commands and counts follow the early ones
+    uint slot = atomicAdd(_drawCounts.counts[object.draw.z + (late ? _objects.count.z : 0)], 1);
+    uint command = (object.draw.w + slot + (late ? _objects.count.x : 0)) * 5;
+
+    _drawCommands.commands[command + 0] = object.draw.x; // indexCount
+    _drawCommands.commands[command + 1] = 1; // instanceCount
+    _drawCommands.commands[command + 2] = 0; // firstIndex
+    _drawCommands.commands[command + 3] = 0; // vertexOffset
+    _drawCommands.commands[command + 4] = index; // firstInstance, object index in the vertex shader
+}
+
+#endif
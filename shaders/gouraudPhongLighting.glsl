@@ -1,4 +1,5 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 #ifdef VERTEX
 
@@ -7,49 +8,47 @@ layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inTexCoords;
 
 layout(location = 0) out vec3 inColor;
+invariant gl_Position;
 
+#include "include/clusteredLights.glsl"
+#include "include/objects.glsl"
 
-layout(binding = 0) uniform _{
-    mat4 _model;
-    mat4 _view;
-    mat4 _proj;
-};
+#include "include/frame.glsl"
 
-layout(binding = 1) uniform mat{
+layout(set = 1, binding = 1) uniform mat{
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
     float shininess;
 } material;
 
-layout(binding = 2) uniform ya{
-    //vec3 lightcolor;
-    vec3 lightPos;
-    vec3 _viewPos;
-};
-
 
 void main() {
-    gl_Position = _proj * _view * _model * vec4(inPosition, 1.0);
-
-    vec3 fragPos = vec3(_model * vec4(inPosition, 1.0));
-    vec3 normal = mat3(transpose(inverse(_model))) * inNormal;
+    mat4 model = objectModel();
+    gl_Position = _frame.proj * _frame.view * model * vec4(inPosition, 1.0);
 
-    const vec3 lightColor = vec3(1.0, 1, 1);
+    vec3 fragPos = vec3(model * vec4(inPosition, 1.0));
+    vec3 normal = mat3(transpose(inverse(model))) * inNormal;
 
-    vec3 ambient = material.ambient * lightColor;
+    vec3 result = material.ambient;
 
     vec3 norm = normalize(normal);
-    vec3 lightDir = normalize(lightPos - fragPos);
-    float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = (diff * material.diffuse) * lightColor;
+    vec3 viewDir = normalize(_frame.viewPos.xyz - fragPos);
+
+    // Lit per vertex, there is no fragment position to pick a cluster with, so all lights are evaluated
+    for(uint i = 0; i < _lights.grid.w; i++){
+        vec3 lightDir;
+        vec3 lightColor = lightRadiance(_lights.lights[i], fragPos, lightDir);
+
+        float diff = max(dot(norm, lightDir), 0.0);
+        vec3 diffuse = (diff * material.diffuse) * lightColor;
 
-    vec3 viewDir = normalize(_viewPos - fragPos);
-    vec3 reflectDir = reflect(-lightDir, norm);  
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specular = lightColor * (spec * material.specular);
+        vec3 reflectDir = reflect(-lightDir, norm);  
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+        vec3 specular = lightColor * (spec * material.specular);
 
-    vec3 result = ambient + diffuse + specular;
+        result += diffuse + specular;
+    }
 
     inColor = result;
 }
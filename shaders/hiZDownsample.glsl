@@ -0,0 +1,43 @@
+#version 450
+
+#ifdef COMPUTE
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// One descriptor set per pyramid level, each texel keeps the farthest depth of the 2x2 source texels it covers
+layout(binding = 0) uniform _{
+    uvec4 _hiZLevel; // xy valid size of the source (render extent for the depth buffer), z 1 when the source is the depth buffer
+};
+
+layout(binding = 1) uniform sampler2D _hiZDepth;
+layout(binding = 2, r32f) uniform readonly image2D _hiZSource;
+layout(binding = 3, r32f) uniform writeonly image2D _hiZDestination;
+
+float sourceDepth(ivec2 texel){
+    // Odd sizes are covered by the last texel, nothing outside of the rendered area is read
+    texel = min(texel, ivec2(_hiZLevel.xy) - 1);
+
+    if(_hiZLevel.z != 0){
+        return texelFetch(_hiZDepth, texel, 0).r;
+    }
+    return imageLoad(_hiZSource, texel).r;
+}
+
+void main() {
+    uvec2 size = (_hiZLevel.xy + 1) / 2;
+
+    if(any(greaterThanEqual(gl_GlobalInvocationID.xy, size))){
+        return;
+    }
+
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy) * 2;
+
+    float depth = max(
+        max(sourceDepth(texel), sourceDepth(texel + ivec2(1, 0))),
+        max(sourceDepth(texel + ivec2(0, 1)), sourceDepth(texel + ivec2(1, 1)))
+    );
+
+    imageStore(_hiZDestination, ivec2(gl_GlobalInvocationID.xy), vec4(depth));
+}
+
+#endif
@@ -0,0 +1,28 @@
+// Global texture table of VulkanBindlessTextures, needs #extension GL_EXT_nonuniform_qualifier : require in the including shader
+// Materials declare Texture2D/TextureCube members in their uniform blocks and get the texture's table index written there
+
+struct Texture2D{
+    uint index;
+};
+
+struct TextureCube{
+    uint index;
+};
+
+layout(set = 2, binding = 0) uniform sampler2D _textures[];
+layout(set = 2, binding = 1) uniform samplerCube _cubeTextures[];
+layout(set = 2, binding = 2) uniform sampler2DArray _textureArrays[];
+
+#define bindless(tex) _textures[nonuniformEXT((tex).index)] // only for textures that are not packed, prefer textureBindless
+#define bindlessCube(tex) _cubeTextures[nonuniformEXT((tex).index)]
+
+// Small textures packed by VulkanTextureArrays set the top bit, the array's table index is in the low 12 bits and the layer above them
+vec4 textureBindless(Texture2D tex, vec2 uv){
+    if((tex.index & 0x80000000u) != 0u){
+        uint array = tex.index & 0xFFFu;
+        uint layer = (tex.index >> 12) & 0x7FFFFu;
+        return texture(_textureArrays[nonuniformEXT(array)], vec3(uv, float(layer)));
+    }
+
+    return texture(_textures[nonuniformEXT(tex.index)], uv);
+}
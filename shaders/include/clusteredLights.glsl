@@ -0,0 +1,77 @@
+// Lights of the frame and their assignment to the view frustum clusters, filled by ClusteredLighting
+
+#define LIGHT_POINT 0
+#define LIGHT_SPOT 1
+#define LIGHT_DIRECTIONAL 2
+
+// Has to match ClusteredLighting::maxLightsPerCluster
+#define MAX_CLUSTER_LIGHTS 127
+
+#ifndef CLUSTER_LIGHTS_ACCESS
+#define CLUSTER_LIGHTS_ACCESS readonly
+#endif
+
+struct Light{
+    vec4 positionRange; // xyz world position, w range
+    vec4 colorIntensity; // rgb color, a intensity
+    vec4 directionType; // xyz direction, w type
+    vec4 spotCone; // x cos of inner angle, y cos of outer angle, z shadow index (negative without a shadow)
+};
+
+layout(std430, binding = 14) readonly buffer LightBuffer{
+    uvec4 grid; // cluster count in x, y, z and light count
+    vec4 depth; // near, far, slice scale, slice bias
+    vec4 tile; // tile size and render extent in pixels
+    mat4 view;
+    mat4 invProj;
+    Light lights[];
+} _lights;
+
+// Per cluster: light count followed by MAX_CLUSTER_LIGHTS light indices
+layout(std430, binding = 15) CLUSTER_LIGHTS_ACCESS buffer ClusterLightBuffer{
+    uint indices[];
+} _clusterLights;
+
+float linearDepth(float depth){
+    float near = _lights.depth.x, far = _lights.depth.y;
+    return near * far / (far - depth * (far - near));
+}
+
+uint clusterIndex(vec4 fragCoord){
+    uint slice = uint(clamp(log(linearDepth(fragCoord.z)) * _lights.depth.z + _lights.depth.w, 0.0, float(_lights.grid.z - 1)));
+    uvec2 tile = min(uvec2(fragCoord.xy / _lights.tile.xy), _lights.grid.xy - 1);
+    return tile.x + _lights.grid.x * (tile.y + _lights.grid.y * slice);
+}
+
+uint clusterLightCount(uint cluster){
+    return _clusterLights.indices[cluster * (MAX_CLUSTER_LIGHTS + 1)];
+}
+
+Light clusterLight(uint cluster, uint i){
+    return _lights.lights[_clusterLights.indices[cluster * (MAX_CLUSTER_LIGHTS + 1) + 1 + i]];
+}
+
+// Incoming radiance at pos and direction towards the light
+vec3 lightRadiance(Light light, vec3 pos, out vec3 L){
+    uint type = uint(light.directionType.w);
+
+    if(type == LIGHT_DIRECTIONAL){
+        L = normalize(-light.directionType.xyz);
+        return light.colorIntensity.rgb * light.colorIntensity.a;
+    }
+
+    vec3 toLight = light.positionRange.xyz - pos;
+    float dist2 = max(dot(toLight, toLight), 0.0001);
+    L = toLight * inversesqrt(dist2);
+
+    // Inverse square falloff windowed to reach zero at the light range
+    float ratio = dist2 / (light.positionRange.w * light.positionRange.w);
+    float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+    float attenuation = window * window / dist2;
+
+    if(type == LIGHT_SPOT){
+        attenuation *= smoothstep(light.spotCone.y, light.spotCone.x, dot(-L, normalize(light.directionType.xyz)));
+    }
+
+    return light.colorIntensity.rgb * light.colorIntensity.a * attenuation;
+}
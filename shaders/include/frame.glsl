@@ -0,0 +1,8 @@
+// Per frame engine data (VulkanFrameData), set 0 of every graphics pipeline
+
+layout(set = 0, binding = 0) uniform FrameBuffer{
+    mat4 view;
+    mat4 proj;
+    vec4 viewPos; // xyz
+    vec4 time; // x seconds since start, y frame time
+} _frame;
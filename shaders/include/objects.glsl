@@ -0,0 +1,22 @@
+// Per object data of the frame, filled by GpuDrivenRendering
+// Every draw of a scene object passes the object index as its first instance
+
+struct Object{
+    mat4 model;
+    vec4 boundsMin; // local space
+    vec4 boundsMax;
+    uvec4 draw; // x index count, z bucket, w first command of the bucket
+};
+
+layout(std430, binding = 13) readonly buffer ObjectBuffer{
+    mat4 view;
+    mat4 proj;
+    vec4 frustum[6]; // world space planes pointing inside
+    uvec4 count; // x object count, y 1 when frustum culling is enabled, z bucket count, w culling phase (written on the GPU, 1 for the late phase)
+    vec4 hiZ; // xy render extent in pixels, z depth pyramid levels, w 1 when occlusion culling is enabled
+    Object objects[];
+} _objects;
+
+mat4 objectModel(){
+    return _objects.objects[gl_InstanceIndex].model;
+}
@@ -0,0 +1,69 @@
+// Shadow maps rendered by ShadowMapping, include after clusteredLights.glsl
+
+// Have to match ShadowMapping::cascadeCount and ShadowMapping::maxPointShadows
+#define SHADOW_CASCADES 4
+#define MAX_POINT_SHADOWS 4
+
+layout(std430, binding = 10) readonly buffer ShadowBuffer{
+    vec4 cascadeSplits; // view space far distance of each cascade
+    vec4 params; // x cascade count (0 without a directional shadow), y normal offset
+    mat4 cascadeViewProj[SHADOW_CASCADES];
+    mat4 pointViewProj[MAX_POINT_SHADOWS * 6]; // +X, -X, +Y, -Y, +Z, -Z faces of each point light
+} _shadows;
+
+layout(binding = 11) uniform sampler2DArrayShadow _shadowCascades;
+layout(binding = 12) uniform sampler2DArrayShadow _shadowCubes;
+
+float sampleShadow(sampler2DArrayShadow shadowMap, mat4 viewProj, int layer, vec3 pos){
+    vec4 lightPos = viewProj * vec4(pos, 1.0);
+    vec3 coords = lightPos.xyz / lightPos.w;
+    vec2 uv = coords.xy * 0.5 + 0.5;
+
+    if(any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))) || coords.z > 1.0){
+        return 1.0;
+    }
+
+    return texture(shadowMap, vec4(uv, layer, coords.z));
+}
+
+// 0 in shadow, 1 lit, viewDepth is the linear view space depth of the fragment
+float lightShadow(Light light, vec3 pos, vec3 normal, float viewDepth){
+    int slot = int(light.spotCone.z);
+
+    if(slot < 0){
+        return 1.0;
+    }
+
+    uint type = uint(light.directionType.w);
+    vec3 offsetPos = pos + normal * _shadows.params.y;
+
+    if(type == LIGHT_DIRECTIONAL){
+        int cascades = int(_shadows.params.x);
+
+        for(int i = 0; i < cascades; i++){
+            if(viewDepth < _shadows.cascadeSplits[i]){
+                return sampleShadow(_shadowCascades, _shadows.cascadeViewProj[i], i, offsetPos);
+            }
+        }
+        return 1.0;
+    }
+
+    if(type == LIGHT_POINT){
+        vec3 dir = offsetPos - light.positionRange.xyz;
+        vec3 absDir = abs(dir);
+
+        int face;
+        if(absDir.x >= absDir.y && absDir.x >= absDir.z){
+            face = dir.x >= 0.0 ? 0 : 1;
+        }else if(absDir.y >= absDir.z){
+            face = dir.y >= 0.0 ? 2 : 3;
+        }else{
+            face = dir.z >= 0.0 ? 4 : 5;
+        }
+
+        int layer = slot * 6 + face;
+        return sampleShadow(_shadowCubes, _shadows.pointViewProj[layer], layer, offsetPos);
+    }
+
+    return 1.0;
+}
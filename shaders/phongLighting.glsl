@@ -1,4 +1,5 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 #ifdef VERTEX
 
@@ -9,19 +10,19 @@ layout(location = 2) in vec2 inTexCoords;
 layout(location = 0) out vec3 normal;
 layout(location = 1) out vec3 pos;
 layout(location = 2) out vec2 texCoords;
+invariant gl_Position;
 
 
-layout(binding = 0) uniform _{
-    mat4 _model;
-    mat4 _view;
-    mat4 _proj;
-};
+#include "include/objects.glsl"
+
+#include "include/frame.glsl"
 
 
 void main() {
-    gl_Position = _proj * _view * _model * vec4(inPosition, 1.0);
-    pos = vec3(_model * vec4(inPosition, 1.0));
-    normal = mat3(transpose(inverse(_model))) * inNormal;
+    mat4 model = objectModel();
+    gl_Position = _frame.proj * _frame.view * model * vec4(inPosition, 1.0);
+    pos = vec3(model * vec4(inPosition, 1.0));
+    normal = mat3(transpose(inverse(model))) * inNormal;
     texCoords = inTexCoords;
 }
 
@@ -35,36 +36,43 @@ layout(location = 2) in vec2 texCoords;
 
 layout(location = 0) out vec4 outColor;
 
-layout(binding = 1) uniform mat{
+#include "include/frame.glsl"
+#include "include/clusteredLights.glsl"
+#include "include/shadows.glsl"
+
+layout(set = 1, binding = 1) uniform mat{
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
     float shininess;
 } material;
 
-layout(binding = 2) uniform _{
-    //vec3 lightcolor;
-    vec3 lightPos;
-    vec3 _viewPos;
-};
-
 void main() {
 
-    const vec3 lightColor = vec3(1.0, 1.0, 1.0);
-
-    vec3 ambient = material.ambient * lightColor;
+    vec3 result = material.ambient;
 
     vec3 norm = normalize(normal);
-    vec3 lightDir = normalize(lightPos - fragPos);
-    float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = (diff * material.diffuse) * lightColor;
+    vec3 viewDir = normalize(_frame.viewPos.xyz - fragPos);
+
+    uint cluster = clusterIndex(gl_FragCoord);
+    uint lightCount = clusterLightCount(cluster);
+    float viewDepth = linearDepth(gl_FragCoord.z);
+
+    for(uint i = 0; i < lightCount; i++){
+        vec3 lightDir;
+        Light lightSource = clusterLight(cluster, i);
+        vec3 lightColor = lightRadiance(lightSource, fragPos, lightDir) * lightShadow(lightSource, fragPos, norm, viewDepth);
+
+        float diff = max(dot(norm, lightDir), 0.0);
+        vec3 diffuse = (diff * material.diffuse) * lightColor;
+
+        vec3 reflectDir = reflect(-lightDir, norm);  
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+        vec3 specular = lightColor * (spec * material.specular);
 
-    vec3 viewDir = normalize(_viewPos - fragPos);
-    vec3 reflectDir = reflect(-lightDir, norm);  
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specular = lightColor * (spec * material.specular);
+        result += diffuse + specular;
+    }
 
-    vec3 result = ambient + diffuse + specular;
     outColor = vec4(result, 1.0);
 }
 
@@ -0,0 +1,27 @@
+#version 450
+
+#ifdef VERTEX
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inTexCoords;
+
+// Shadow view and caster of the draw, pushed by ShadowMapping
+layout(push_constant) uniform _{
+    mat4 _viewProjModel;
+};
+
+
+void main() {
+    gl_Position = _viewProjModel * vec4(inPosition, 1.0);
+}
+
+#endif
+
+#ifdef FRAGMENT
+
+void main() {
+
+}
+
+#endif
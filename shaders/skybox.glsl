@@ -1,4 +1,6 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
 
 #ifdef VERTEX
 
@@ -8,14 +10,11 @@ layout(location = 2) in vec2 inTexCoords;
 
 layout(location = 0) out vec3 texCoords;
 
-layout(binding = 0) uniform _{
-    mat4 _view;
-    mat4 _proj;
-};
+#include "include/frame.glsl"
 
 void main() {
     texCoords = aPos;
-    gl_Position = _proj * _view * vec4(aPos, 1.0);
+    gl_Position = _frame.proj * mat4(mat3(_frame.view)) * vec4(aPos, 1.0);
     gl_Position = gl_Position.xyww;
 }
 
@@ -26,12 +25,16 @@ void main() {
 layout(location = 0) in vec3 texCoords; 
 layout(location = 0) out vec4 outColor;
 
-layout(binding = 1) uniform samplerCube Skybox;
+#include "include/bindless.glsl"
+
+layout(set = 1, binding = 1) uniform textures{
+    TextureCube Skybox;
+};
 
 void main() {
     vec3 coords = texCoords;
     coords.x = -coords.x;
-    outColor = texture(Skybox, coords);
+    outColor = texture(bindlessCube(Skybox), coords);
 }
 
 #endif
\ No newline at end of file
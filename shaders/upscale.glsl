@@ -0,0 +1,71 @@
+#version 450
+
+#ifdef VERTEX
+
+layout(location = 0) out vec2 TexCoords;
+
+void main() {
+    // Fullscreen triangle, counter clockwise in framebuffer space
+    TexCoords = vec2(gl_VertexIndex & 2, (gl_VertexIndex << 1) & 2);
+    gl_Position = vec4(TexCoords * 2.0 - 1.0, 0.0, 1.0);
+}
+
+#endif
+
+#ifdef FRAGMENT
+
+layout(location = 0) in vec2 TexCoords;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 1, binding = 1) uniform _{
+    vec2 _inputScale; // rendered part of the input image
+    vec2 _inputSize; // input image size in pixels
+    float _sharpness;
+};
+
+layout(set = 1, binding = 2) uniform sampler2D _input;
+
+
+vec3 fetch(vec2 pixel){
+    // Clamp to the rendered part, the rest of the image holds stale data
+    vec2 maxPixel = _inputSize * _inputScale - 0.5;
+    return textureLod(_input, clamp(pixel, vec2(0.5), maxPixel) / _inputSize, 0.0).rgb;
+}
+
+float luma(vec3 color){
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+void main() {
+    vec2 pixel = TexCoords * _inputSize * _inputScale;
+
+    // Edge adaptive upsampling (EASU like): estimate the local gradient and filter along the edge instead of across it
+    vec3 n = fetch(pixel + vec2( 0.0, -1.0));
+    vec3 s = fetch(pixel + vec2( 0.0,  1.0));
+    vec3 e = fetch(pixel + vec2( 1.0,  0.0));
+    vec3 w = fetch(pixel + vec2(-1.0,  0.0));
+    vec3 c = fetch(pixel);
+
+    vec2 gradient = vec2(luma(e) - luma(w), luma(s) - luma(n));
+    float edge = length(gradient);
+
+    vec3 color = c;
+
+    if(edge > 1.0 / 64.0){
+        vec2 along = vec2(-gradient.y, gradient.x) / edge;
+        vec3 a = fetch(pixel + along * 0.75);
+        vec3 b = fetch(pixel - along * 0.75);
+        color = mix(c, (a + b + c * 2.0) * 0.25, clamp(edge * 4.0, 0.0, 1.0));
+    }
+
+    // Robust contrast adaptive sharpening (RCAS like): sharpen with the cross neighbourhood, limited so no new extremes appear
+    vec3 minColor = min(min(min(n, s), min(e, w)), c);
+    vec3 maxColor = max(max(max(n, s), max(e, w)), c);
+    vec3 blur = (n + s + e + w) * 0.25;
+
+    vec3 sharpened = color + (color - blur) * _sharpness;
+    outColor = vec4(clamp(sharpened, minColor, maxColor), 1.0);
+}
+
+#endif
@@ -24,6 +24,7 @@ private:
     std::shared_ptr<VulkanDescriptorPool> descriptorPool;
 
     bool hasVulkanInited = false;
+    bool skipDrawData = false;
 
 public:
     ImGuiInterface(Vulkan& vulkan, GLFWwindow* window){
@@ -81,7 +82,11 @@ public:
     void render(VulkanCommandBuffer& commandBuffer){
         ImGui::Render();
 
-        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+        // Draw data recorded before a backend reinit references destroyed font descriptors
+        if(!skipDrawData){
+            ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+        }
+        skipDrawData = false;
 
         ImGui_ImplVulkan_NewFrame();
         ImGui_ImplGlfw_NewFrame();
@@ -89,9 +94,9 @@ public:
         ImGui::DockSpaceOverViewport(0, ImGui::GetMainViewport(), ImGuiDockNodeFlags_PassthruCentralNode);
     }
 
-    void initVulkan(std::shared_ptr<VulkanRenderPass> renderPass){
+    void initVulkan(std::shared_ptr<VulkanRenderPass> renderPass, uint32_t subpass = 0){
         
-        ImGui_ImplVulkan_InitInfo init_info = getImguiInitInfo(renderPass);
+        ImGui_ImplVulkan_InitInfo init_info = getImguiInitInfo(renderPass, subpass);
         ImGui_ImplVulkan_Init(&init_info);
         hasVulkanInited = true;
 
@@ -101,9 +106,21 @@ public:
         ImGui::DockSpaceOverViewport(0, ImGui::GetMainViewport(), ImGuiDockNodeFlags_PassthruCentralNode);
     }
 
+    // Pipeline of the backend is baked against one render pass and subpass, it has to be rebuilt when the target changes
+    void reinitVulkan(std::shared_ptr<VulkanRenderPass> renderPass, uint32_t subpass){
+        if(hasVulkanInited){
+            ImGui_ImplVulkan_Shutdown();
+        }
+
+        ImGui_ImplVulkan_InitInfo init_info = getImguiInitInfo(renderPass, subpass);
+        ImGui_ImplVulkan_Init(&init_info);
+        hasVulkanInited = true;
+        skipDrawData = true;
+    }
+
 private:
 
-    ImGui_ImplVulkan_InitInfo getImguiInitInfo(std::shared_ptr<VulkanRenderPass> renderPass){
+    ImGui_ImplVulkan_InitInfo getImguiInitInfo(std::shared_ptr<VulkanRenderPass> renderPass, uint32_t subpass){
 
         ImGui_ImplVulkan_InitInfo init_info = {};
         //init_info.ApiVersion = VK_API_VERSION_1_3;
@@ -115,7 +132,7 @@ private:
         init_info.PipelineCache = VK_NULL_HANDLE;
         init_info.DescriptorPool = *descriptorPool;
         init_info.RenderPass = *renderPass;
-        init_info.Subpass = 0;
+        init_info.Subpass = subpass;
         init_info.MinImageCount = device->getSwapChain()->getMinImageCount();
         init_info.ImageCount = device->getSwapChain()->getImageCount();
         init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
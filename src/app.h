@@ -16,12 +16,16 @@ using json = nlohmann::json;
 
 #include <iostream>
 #include <fstream>
+#include <optional>
 
 #include "vulkan/vulkanCore.h"
 #include "ImGuiInterface.h"
 #include "scene.h"
 #include "input.h"
 #include "fileDialog.h"
+#include "frameLimiter.h"
+#include "idlePolicy.h"
+#include "memoryDashboard.h"
 
 namespace MSIVulkanDemo{
 
@@ -36,6 +40,10 @@ private:
     std::unique_ptr<Vulkan> vulkan;
     bool windowResized = false;
     bool windowHidden = false;
+    bool windowFocused = true;
+
+    IdlePolicy idlePolicy;
+    const std::string configPath = "./config.json";
 
     bool guiMode = true;
     Input inputMap;
@@ -46,8 +54,20 @@ private:
     const std::chrono::steady_clock::time_point startTime = std::chrono::high_resolution_clock::now();
     uint32_t FPS = 0;
 
+    FrameLimiter frameLimiter;
+    bool lowLatencyMode = false;
+
+    std::optional<VkPresentModeKHR> pendingPresentMode;
+    std::optional<uint32_t> pendingImageCount;
+
+    std::chrono::steady_clock::time_point inputSampleTime;
+    float inputLatency = 0.0f; // ms, averaged over one second
+
     std::unique_ptr<Scene> scene;
 
+    std::unique_ptr<MemoryDashboard> memoryDashboard;
+    bool showMemoryDashboard = false;
+
 public:
     App(){
 
@@ -58,6 +78,7 @@ public:
         initWindow();
         vulkan = std::unique_ptr<Vulkan>(new Vulkan(window));
         imgui = std::shared_ptr<ImGuiInterface>(new ImGuiInterface(*vulkan, window));
+        memoryDashboard = std::unique_ptr<MemoryDashboard>(new MemoryDashboard(vulkan->getMemoryManager()));
         mainLoop();
         cleanup();
 
@@ -75,6 +96,8 @@ private:
         glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
         glfwSetKeyCallback(window, inputKeyCallback);
         glfwSetCursorPosCallback(window, cursorPositionCallback);
+        glfwSetWindowFocusCallback(window, windowFocusCallback);
+        glfwSetWindowIconifyCallback(window, windowIconifyCallback);
 
         FileDialog::fileDialog(window);
     }
@@ -92,6 +115,16 @@ private:
         app->windowResized = true;
     }
 
+    static void windowFocusCallback(GLFWwindow* window, int focused){
+        auto app = reinterpret_cast<App*>(glfwGetWindowUserPointer(window));
+        app->windowFocused = focused == GLFW_TRUE;
+    }
+
+    static void windowIconifyCallback(GLFWwindow* window, int iconified){
+        auto app = reinterpret_cast<App*>(glfwGetWindowUserPointer(window));
+        app->windowHidden = iconified == GLFW_TRUE;
+    }
+
     static void inputKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods){
         auto app = reinterpret_cast<App*>(glfwGetWindowUserPointer(window));
 
@@ -181,6 +214,22 @@ private:
         }
     }
 
+    // Input sample to frame completion and present submission, scanout is not visible without display timing extensions
+    void latencyCalc(float deltaTime){
+        static float cumulativeLatency = 0.0f, cumulativeTime = 0.0f;
+        static uint32_t frames = 0;
+
+        cumulativeLatency += std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - inputSampleTime).count();
+        cumulativeTime += deltaTime;
+        frames++;
+
+        if(cumulativeTime >= 1.0f){
+            inputLatency = cumulativeLatency / frames;
+            cumulativeLatency = cumulativeTime = 0.0f;
+            frames = 0;
+        }
+    }
+
     void loadScene(){
         scene = std::unique_ptr<Scene>(new SimpleScene());
         scene->loadGui(imgui);
@@ -189,35 +238,92 @@ private:
         scene->loadScene(*vulkan);
     }
 
+    void loadConfig(){
+        std::ifstream configFile(configPath);
+        if(!configFile.is_open()){
+            return;
+        }
+
+        json config = json::parse(configFile, nullptr, false);
+        if(config.is_discarded()){
+            std::cout << std::format("Failed to parse {}, using defaults", configPath) << std::endl;
+            return;
+        }
+
+        if(config.contains("idlePolicy")){
+            idlePolicy.loadFromJson(config["idlePolicy"]);
+        }
+    }
+
+    IdlePolicy::State windowState(){
+        if(windowHidden){
+            return IdlePolicy::State::Hidden;
+        }
+        return windowFocused ? IdlePolicy::State::Foreground : IdlePolicy::State::Background;
+    }
+
     void mainLoop(){
 
+        loadConfig();
         loadScene();
 
         while(!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
+            IdlePolicy::State state = windowState();
+
+            if(state == IdlePolicy::State::Foreground){
+                // Low latency mode waits before sampling input, so the wait does not age it
+                if(lowLatencyMode){
+                    frameLimiter.wait();
+                }
+                glfwPollEvents();
+            }else if(!idlePolicy.wait(window, state)){
+                // Suspended, time spent minimized is not passed to the scene
+                previousTime = std::chrono::high_resolution_clock::now();
+                continue;
+            }
+
+            inputSampleTime = std::chrono::high_resolution_clock::now();
 
             auto currentTime = std::chrono::high_resolution_clock::now();
             float deltaTime = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - previousTime).count();
-            
-            scene->updateScene(deltaTime, inputMap);
-            inputMap.update();
-            
-            fpsCalc(currentTime, startTime, deltaTime);
             previousTime = currentTime;
 
             if(windowHidden){
+                scene->updateScripts(deltaTime);
                 continue;
             }
+            
+            scene->updateScene(deltaTime, inputMap);
+            inputMap.update();
+            
+            fpsCalc(currentTime, startTime, deltaTime);
 
             if(windowResized){
                 vulkan->windowResized(window);
                 windowResized = false;
             }
 
+            if(pendingPresentMode){
+                vulkan->getSwapChain()->setPresentMode(*pendingPresentMode);
+                pendingPresentMode.reset();
+            }
+
+            if(pendingImageCount){
+                vulkan->getSwapChain()->setImageCount(*pendingImageCount);
+                ImGui_ImplVulkan_SetMinImageCount(vulkan->getSwapChain()->getMinImageCount());
+                pendingImageCount.reset();
+            }
+
             menuBar();
+            memoryDashboard->update();
 
             vulkan->drawFrame();
 
+            latencyCalc(deltaTime);
+
+            if(!lowLatencyMode && state == IdlePolicy::State::Foreground){
+                frameLimiter.wait();
+            }
         }
         vulkan->waitIdle();
     }
@@ -232,6 +338,11 @@ private:
             }
 
             ImGui::Text((std::to_string(FPS) + " fps").c_str());
+            ImGui::Text("%.1f ms latency", inputLatency);
+
+            if(scene->getDynamicResolution()){
+                scene->getDynamicResolution()->guiMenuBar();
+            }
 
             if (ImGui::BeginMenu("Scene")){
                 if (ImGui::MenuItem("Open scene", "Ctrl+O")){
@@ -252,8 +363,127 @@ private:
                 ImGui::EndMenu();
             }
 
+            if (ImGui::BeginMenu("Memory")){
+                ImGui::MenuItem("GPU memory dashboard", nullptr, &showMemoryDashboard);
+                scene->getResourceManager()->guiMenu();
+                if(scene->getTextureStreaming()){
+                    scene->getTextureStreaming()->guiMenu();
+                }
+                if(scene->getTextureArrays()){
+                    VulkanTextureArrays::arraysStats stats = scene->getTextureArrays()->getStats();
+                    ImGui::SeparatorText("Texture arrays");
+                    ImGui::Text("Packed textures: %u in %u arrays, %u layers", stats.textures, stats.arrays, stats.layers);
+                    ImGui::Text("Array memory: %.1f MiB", stats.bytes / (1024.0f * 1024.0f));
+                }
+                ImGui::Text("Texture samplers: %zu", vulkan->getDevice()->getTextureSamplerCount());
+                ImGui::EndMenu();
+            }
+
+            if (ImGui::BeginMenu("Present")){
+                presentMenu();
+                ImGui::EndMenu();
+            }
+
+            if (ImGui::BeginMenu("Render")){
+                bool mergeSubpasses = vulkan->getRenderGraph()->isSubpassMerging();
+                if (ImGui::MenuItem("Merge subpasses", nullptr, &mergeSubpasses)){
+                    vulkan->getRenderGraph()->setSubpassMerging(mergeSubpasses);
+                }
+
+                bool depthPrepass = scene->isDepthPrepassEnabled();
+                if (ImGui::MenuItem("Depth pre-pass", nullptr, &depthPrepass)){
+                    scene->setDepthPrepass(depthPrepass);
+                }
+
+                if(scene->getClusteredLighting()){
+                    scene->getClusteredLighting()->guiMenu();
+                }
+
+                if(scene->getShadowMapping()){
+                    scene->getShadowMapping()->guiMenu();
+                }
+
+                if(scene->getGpuDrivenRendering()){
+                    scene->getGpuDrivenRendering()->guiMenu();
+                }
+
+                auto fragmentInvocations = vulkan->getRenderGraph()->getFragmentInvocations();
+                if(!fragmentInvocations.empty()){
+                    ImGui::SeparatorText("Fragment invocations");
+                    for(const auto& [name, count] : fragmentInvocations){
+                        ImGui::Text("%s: %llu", name.c_str(), static_cast<unsigned long long>(count));
+                    }
+                }
+
+                ImGui::SeparatorText("Uploads");
+                ImGui::Text("Uniforms: %zu B/frame", vulkan->getRenderGraph()->getUniformBytesUploaded());
+
+                auto uniformMemory = vulkan->getRenderGraph()->getUniformMemoryStats();
+                ImGui::Text("Uniform memory: %.1f / %.1f KiB in %u pages, peak %.1f KiB, %u sets", uniformMemory.used / 1024.0f, uniformMemory.capacity / 1024.0f, uniformMemory.pages, uniformMemory.highWater / 1024.0f, uniformMemory.descriptorSets);
+
+                auto transientMemory = vulkan->getRenderGraph()->getTransientMemoryStats();
+                ImGui::SeparatorText("Transient attachments");
+                ImGui::Text("Memory: %.1f MiB, %.1f MiB before aliasing", transientMemory.aliasedSize / (1024.0f * 1024.0f), transientMemory.requestedSize / (1024.0f * 1024.0f));
+                ImGui::Text("Lazily allocated: %.1f MiB", transientMemory.lazySize / (1024.0f * 1024.0f));
+                ImGui::Text("%u resources in %u allocations", transientMemory.resourceCount, transientMemory.allocationCount);
+                ImGui::EndMenu();
+            }
+
             ImGui::EndMainMenuBar();
         }
+
+        if(showMemoryDashboard){
+            memoryDashboard->guiWindow(&showMemoryDashboard);
+        }
+    }
+
+    void presentMenu(){
+        auto swapChain = vulkan->getSwapChain();
+        auto& available = swapChain->getAvailablePresentModes();
+
+        const std::pair<VkPresentModeKHR, const char*> presentModes[] = {
+            {VK_PRESENT_MODE_FIFO_KHR, "FIFO (vsync)"},
+            {VK_PRESENT_MODE_FIFO_RELAXED_KHR, "FIFO relaxed"},
+            {VK_PRESENT_MODE_MAILBOX_KHR, "Mailbox"},
+            {VK_PRESENT_MODE_IMMEDIATE_KHR, "Immediate"}
+        };
+
+        ImGui::SeparatorText("Present mode");
+        for(const auto& [mode, name] : presentModes){
+            bool supported = std::find(available.begin(), available.end(), mode) != available.end();
+            if(ImGui::MenuItem(name, nullptr, swapChain->getPresentMode() == mode, supported)){
+                pendingPresentMode = mode;
+            }
+        }
+
+        // Recreate only once the slider is released, not on every drag step
+        static int imageCount = swapChain->getImageCount();
+        ImGui::SliderInt("Swapchain images", &imageCount, swapChain->getMinImageCount(), swapChain->getMaxImageCount());
+        if(ImGui::IsItemDeactivatedAfterEdit()){
+            pendingImageCount = imageCount;
+        }else if(!ImGui::IsItemActive()){
+            imageCount = swapChain->getImageCount();
+        }
+
+        ImGui::SeparatorText("Frame pacing");
+        bool limiterEnabled = frameLimiter.isEnabled();
+        if(ImGui::MenuItem("Frame limiter", nullptr, &limiterEnabled)){
+            frameLimiter.setEnabled(limiterEnabled);
+        }
+
+        float targetFps = frameLimiter.getTargetFps();
+        if(ImGui::SliderFloat("Target fps", &targetFps, 10.0f, 360.0f, "%.0f")){
+            frameLimiter.setTargetFps(targetFps);
+        }
+
+        ImGui::MenuItem("Low latency input", nullptr, &lowLatencyMode);
+        ImGui::Text("Input to present: %.2f ms", inputLatency);
+
+        ImGui::SeparatorText("Idle");
+        ImGui::MenuItem("Throttle in background", nullptr, &idlePolicy.throttleInBackground);
+        ImGui::SliderFloat("Background fps", &idlePolicy.backgroundFps, 1.0f, 60.0f, "%.0f");
+        ImGui::MenuItem("Suspend scripts when minimized", nullptr, &idlePolicy.suspendScriptsWhenHidden);
+        ImGui::SliderFloat("Minimized script rate", &idlePolicy.hiddenFps, 0.5f, 30.0f, "%.1f");
     }
 
     void cleanup(){
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "vulkan/vulkanCore.h"
+#include "vulkan/vulkanComputePipeline.h"
+#include "resources/shaderProgram.h"
+
+#include "imgui.h"
+
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace MSIVulkanDemo{
+
+
+// Packs the lights of the frame into one storage buffer and assigns them to a 3D grid of view frustum clusters with a compute pass,
+// lighting shaders then only loop over the lights of their fragment's cluster (shaders/include/clusteredLights.glsl)
+class ClusteredLighting{
+public:
+    enum LightType : uint32_t{
+        Point = 0,
+        Spot = 1,
+        Directional = 2
+    };
+
+    // std430 layout of Light in clusteredLights.glsl
+    struct Light{
+        glm::vec4 positionRange;
+        glm::vec4 colorIntensity;
+        glm::vec4 directionType;
+        glm::vec4 spotCone;
+    };
+
+    static constexpr uint32_t maxLights = 1024;
+    static constexpr uint32_t maxLightsPerCluster = 127; // MAX_CLUSTER_LIGHTS in the shader
+
+private:
+    struct header{
+        glm::uvec4 grid;
+        glm::vec4 depth;
+        glm::vec4 tile;
+        glm::mat4 view;
+        glm::mat4 invProj;
+    };
+
+    const glm::uvec3 gridSize = {16, 9, 24};
+    const uint32_t workGroupSize = 64;
+
+    std::shared_ptr<VulkanRenderGraph> renderGraph;
+    std::shared_ptr<VulkanComputePipeline> computePipeline;
+    std::shared_ptr<VulkanDescriptorPool> descriptorPool;
+
+    std::vector<std::shared_ptr<VulkanStorageBuffer>> lightBuffers;
+    std::vector<std::shared_ptr<VulkanStorageBuffer>> clusterBuffers;
+    std::vector<std::shared_ptr<VulkanDescriptorSet>> descriptorSets;
+
+    uint32_t lightCount = 0;
+    uint32_t droppedLights = 0;
+
+public:
+    ClusteredLighting(std::shared_ptr<VulkanRenderGraph> renderGraph, std::shared_ptr<VulkanDeviceI> device, std::string computeShaderPath): renderGraph(renderGraph){
+
+        computePipeline = std::make_shared<VulkanComputePipeline>(device, std::make_shared<GlslShader>(device, computeShaderPath, ShaderType::Compute));
+
+        uint32_t frames = renderGraph->getFramesInFlight();
+        descriptorPool = device->createDescriptorPool({{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * frames}});
+
+        std::vector<std::shared_ptr<VulkanBuffer>> lightGlobals, clusterGlobals;
+
+        for(uint32_t i = 0; i < frames; i++){
+            auto lightBuffer = device->getMemoryManager()->createBuffer<VulkanStorageBuffer>(sizeof(header) + maxLights * sizeof(Light));
+            auto clusterBuffer = device->getMemoryManager()->createBuffer<VulkanStorageBuffer>(getClusterCount() * (maxLightsPerCluster + 1) * sizeof(uint32_t), false);
+
+            auto set = descriptorPool->getDescriptorSet(computePipeline->getUniformData(), nullptr, 0);
+            set->setBuffer("_lights", *lightBuffer);
+            set->setBuffer("_clusterLights", *clusterBuffer);
+            set->writeDescriptorSet(computePipeline->getUniformData());
+
+            lightBuffers.push_back(lightBuffer);
+            clusterBuffers.push_back(clusterBuffer);
+            descriptorSets.push_back(set);
+
+            lightGlobals.push_back(lightBuffer);
+            clusterGlobals.push_back(clusterBuffer);
+        }
+
+        renderGraph->setGlobalBuffer("_lights", lightGlobals);
+        renderGraph->setGlobalBuffer("_clusterLights", clusterGlobals);
+    }
+
+    ~ClusteredLighting(){}
+
+    // Recorded before the passes reading the clusters, projection has to be the one used to render them
+    void cull(VulkanCommandBuffer& commandBuffer, std::vector<Light> lights, glm::mat4 view, glm::mat4 proj, float near, float far){
+        uint64_t frame = renderGraph->getRecordedFrame();
+        VkExtent2D extent = renderGraph->getRecordedRenderExtent();
+
+        droppedLights = lights.size() > maxLights ? lights.size() - maxLights : 0;
+        lightCount = std::min<uint32_t>(lights.size(), maxLights);
+
+        float sliceScale = gridSize.z / std::log(far / near);
+
+        header head = {
+            .grid = {gridSize.x, gridSize.y, gridSize.z, lightCount},
+            .depth = {near, far, sliceScale, -std::log(near) * sliceScale},
+            .tile = {std::ceil(extent.width / (float) gridSize.x), std::ceil(extent.height / (float) gridSize.y), extent.width, extent.height},
+            .view = view,
+            .invProj = glm::inverse(proj)
+        };
+
+        lightBuffers[frame]->uploadData(0, &head, sizeof(header));
+        if(lightCount > 0){
+            lightBuffers[frame]->uploadData(sizeof(header), lights.data(), lightCount * sizeof(Light));
+        }
+
+        commandBuffer
+        .bind(*computePipeline, *descriptorSets[frame])
+        .dispatch((getClusterCount() + workGroupSize - 1) / workGroupSize);
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = *clusterBuffers[frame];
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+
+        commandBuffer.setBarrier(barrier, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+
+    uint32_t getClusterCount(){
+        return gridSize.x * gridSize.y * gridSize.z;
+    }
+
+    uint32_t getLightCount(){
+        return lightCount;
+    }
+
+    void guiMenu(){
+        ImGui::SeparatorText("Clustered lighting");
+        ImGui::Text("Lights: %u", lightCount);
+        if(droppedLights > 0){
+            ImGui::Text("Dropped lights: %u (limit %u)", droppedLights, maxLights);
+        }
+        ImGui::Text("Clusters: %ux%ux%u", gridSize.x, gridSize.y, gridSize.z);
+    }
+
+};
+
+
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "../component_decl.h"
+#include "../clusteredLighting.h"
+#include "transformComponent.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <type_traits>
+
+namespace MSIVulkanDemo{
+
+
+class LightSourceComponent : public Component{
+public:
+    using Type = ClusteredLighting::LightType;
+
+private:
+    Type type = Type::Point;
+    glm::vec3 color = {1.0f, 1.0f, 1.0f};
+    float intensity = 1.0f;
+    float range = 10.0f; // point and spot lights have no influence past it
+    glm::vec3 direction = {0.0f, -1.0f, 0.0f}; // spot and directional lights
+    float innerAngle = 20.0f; // degrees
+    float outerAngle = 30.0f;
+    bool castShadows = true; // directional and point lights only
+
+    inline static const std::array<std::string, 3> typeNames = {"point", "spot", "directional"};
+
+public:
+    LightSourceComponent(ComponentParams& params): Component(params){
+
+    }
+
+    LightSourceComponent(ComponentParams& params, Type type): Component(params), type(type){
+
+    }
+
+    ClusteredLighting::Light getLightData(){
+        glm::vec3 position = getComponent<TransformComponent>().getPosition();
+
+        return {
+            .positionRange = glm::vec4(position, range),
+            .colorIntensity = glm::vec4(color, intensity),
+            .directionType = glm::vec4(glm::normalize(direction), static_cast<float>(type)),
+            .spotCone = glm::vec4(std::cos(glm::radians(innerAngle)), std::cos(glm::radians(outerAngle)), -1.0f, 0.0f) // z - shadow slot, assigned by ShadowMapping
+        };
+    }
+
+    Type getType(){
+        return type;
+    }
+
+    void setType(Type newType){
+        type = newType;
+    }
+
+    glm::vec3 getColor(){
+        return color;
+    }
+
+    void setColor(glm::vec3 col){
+        color = col;
+    }
+
+    float getIntensity(){
+        return intensity;
+    }
+
+    void setIntensity(float value){
+        intensity = value;
+    }
+
+    float getRange(){
+        return range;
+    }
+
+    void setRange(float value){
+        range = std::max(value, 0.01f);
+    }
+
+    glm::vec3 getDirection(){
+        return direction;
+    }
+
+    void setDirection(glm::vec3 dir){
+        direction = dir;
+    }
+
+    bool getCastShadows(){
+        return castShadows;
+    }
+
+    void setCastShadows(bool value){
+        castShadows = value;
+    }
+
+    void guiDisplayInspector(){
+        if(ImGui::CollapsingHeader("Light source")){
+            int currentType = static_cast<int>(type);
+            if(ImGui::Combo("type", &currentType, "point\0spot\0directional\0")){
+                type = static_cast<Type>(currentType);
+            }
+
+            ImGui::ColorEdit3("color", glm::value_ptr(color));
+            ImGui::DragFloat("intensity", &intensity, 0.1f, 0.0f, 1000.0f);
+
+            if(type != Type::Directional){
+                ImGui::DragFloat("range", &range, 0.1f, 0.01f, 1000.0f);
+            }
+
+            if(type != Type::Point){
+                ImGui::DragFloat3("direction", glm::value_ptr(direction), 0.01f);
+            }
+
+            if(type == Type::Spot){
+                ImGui::DragFloat("inner angle", &innerAngle, 0.5f, 0.0f, outerAngle);
+                ImGui::DragFloat("outer angle", &outerAngle, 0.5f, innerAngle, 90.0f);
+            }
+
+            if(type != Type::Spot){
+                ImGui::Checkbox("cast shadows", &castShadows);
+            }
+        }
+    }
+
+    json saveToJson(){
+        json component;
+
+        component["type"] = typeNames[type];
+        component["color"] = {color.x, color.y, color.z};
+        component["intensity"] = intensity;
+        component["range"] = range;
+        component["direction"] = {direction.x, direction.y, direction.z};
+        component["innerAngle"] = innerAngle;
+        component["outerAngle"] = outerAngle;
+        component["castShadows"] = castShadows;
+
+        return component;
+    }
+
+    void loadFromJson(json component){
+
+        if(auto it = std::find(typeNames.begin(), typeNames.end(), component.value("type", typeNames[0])); it != typeNames.end()){
+            type = static_cast<Type>(it - typeNames.begin());
+        }
+
+        auto col = component.value("color", std::vector<float>{color.x, color.y, color.z});
+        color = {col[0], col[1], col[2]};
+
+        intensity = component.value("intensity", intensity);
+        range = component.value("range", range);
+
+        auto dir = component.value("direction", std::vector<float>{direction.x, direction.y, direction.z});
+        direction = {dir[0], dir[1], dir[2]};
+
+        innerAngle = component.value("innerAngle", innerAngle);
+        outerAngle = component.value("outerAngle", outerAngle);
+        castShadows = component.value("castShadows", castShadows);
+
+        return;
+    }
+
+};
+
+
+
+}
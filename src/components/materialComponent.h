@@ -8,18 +8,47 @@
 #include <iostream>
 #include <vector>
 #include <type_traits>
+#include <span>
+#include <cstring>
+#include <limits>
+#include <cmath>
+#include <algorithm>
 
 namespace MSIVulkanDemo{
 
 
 class MaterialComponent : public Component, public VulkanDescriptorSetOwner{
+public:
+    typedef uint32_t uniform_handle;
+    static constexpr uniform_handle invalidUniform = std::numeric_limits<uniform_handle>::max();
+
 private:
+    // Resolved once from the reflected layout, offset into uniformBlock or pushConstantBlock
+    struct uniformSlot{
+        std::string name;
+        uint32_t offset;
+        uint32_t size;
+        uint32_t componentCount;
+        uint32_t range = 0; // of uniformRanges, unused for push constants
+        bool pushConstant = false;
+        bool bindlessTexture = false;
+    };
+
     std::string shaderToCompile;
     std::shared_ptr<ShaderProgram> shaderProgram; 
     std::vector<std::shared_ptr<VulkanDescriptorSet>> descriptorSet;
 
-    std::map<std::string, std::vector<float>> floatUniforms;
+    std::vector<uniformSlot> uniformSlots;
+    std::map<std::string, uniform_handle> uniformHandles;
+    std::vector<std::byte> uniformBlock; // std140 data of the material set, uploaded as a whole
+    std::vector<std::byte> pushConstantBlock;
+    std::vector<VulkanUniformRange> uniformRanges; // one per uniform block, written again to a frame's set only after a change
+    uint64_t uniformVersion = 0;
+    bool uniformsResolved = false;
+
     std::map<std::string, std::shared_ptr<Texture>> textures;
+    std::map<std::string, uint64_t> textureVersions; // of the views written to the descriptor sets
+    std::map<std::string, int> anisotropyEdits; // slider values being dragged, applied once released
 
 public:
     MaterialComponent(ComponentParams& params): Component(params), shaderProgram(resourceManager->getResource<ShaderProgram>("./shaders/default.glsl")){
@@ -42,44 +71,75 @@ public:
         return shaderProgram->getGraphicsPipeline();
     }
 
+    // Lays out the blocks once per shader, values already written are kept
     void updateUniforms(){
-        for(auto attrib : shaderProgram->getGraphicsPipeline()->getUniformData().getAttributes()){
-            if(attrib.size > 0){
-                std::vector<float> val;
-                for(uint32_t i = 0; i < attrib.componentCount; i++){
-                    val.push_back(0.0f);
-                }
-                floatUniforms.insert({attrib.name, val});
+        if(uniformsResolved){
+            return;
+        }
+
+        VulkanUniformData uniformData = shaderProgram->getGraphicsPipeline()->getUniformData();
+        const VulkanPushConstantData& pushConstantData = shaderProgram->getGraphicsPipeline()->getPushConstantData();
+
+        uniformBlock.assign(uniformData.getSize(), std::byte{0});
+        pushConstantBlock.assign(pushConstantData.getSize(), std::byte{0});
+
+        std::map<VulkanUniformData::binding_id, uint32_t> bindingRanges;
+
+        for(const auto& binding : uniformData.getBindings(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)){
+            bindingRanges.insert({binding.binding, static_cast<uint32_t>(uniformRanges.size())});
+            uniformRanges.push_back({static_cast<uint32_t>(uniformData.getOffset(binding.binding)), static_cast<uint32_t>(uniformData.getSize(binding.binding)), ++uniformVersion});
+        }
+
+        for(auto attrib : uniformData.getAttributes()){
+            if(attrib.bindlessTexture){
+                addUniformSlot({attrib.name, static_cast<uint32_t>(uniformData.getOffset(attrib.name)), static_cast<uint32_t>(attrib.size), 1, bindingRanges.at(attrib.binding), false, true});
+                textures.insert({attrib.name, getDefaultTexture(attrib.componentCount == 6)});
+            }else if(attrib.size > 0){
+                addUniformSlot({attrib.name, static_cast<uint32_t>(uniformData.getOffset(attrib.name)), static_cast<uint32_t>(attrib.size), attrib.componentCount, bindingRanges.at(attrib.binding)});
+            }else if(attrib.name.starts_with("_")){
+                continue; // engine samplers (shadow maps) are bound by the render graph
             }else{
-                if(attrib.componentCount == 6){
-                    textures.insert({attrib.name, resourceManager->getResource<Texture>({"./textures/NoTexture.jpg", "./textures/NoTexture.jpg", "./textures/NoTexture.jpg", "./textures/NoTexture.jpg", "./textures/NoTexture.jpg", "./textures/NoTexture.jpg"})});
-                }else{
-                    textures.insert({attrib.name, resourceManager->getResource<Texture>("./textures/NoTexture.jpg")});
-                }
+                textures.insert({attrib.name, getDefaultTexture(attrib.componentCount == 6)});
             }
         }
+
+        for(auto attrib : pushConstantData.getAttributes()){
+            addUniformSlot({attrib.name, attrib.offset, attrib.size, attrib.componentCount, 0, true});
+        }
+
+        for(const auto& [name, texture] : textures){
+            writeTextureIndex(name);
+        }
+
+        uniformsResolved = true;
     }
 
     bool hasUniform(std::string name){
-        return shaderProgram->getGraphicsPipeline()->getUniformData().contains(name);
+        return uniformHandles.contains(name);
     }
 
-    template<typename t>
-    typename std::enable_if<(sizeof(t)%sizeof(float) == 0)>::type
-    setUniform(std::string name, t val){
-        std::vector<float> arr(sizeof(t)/sizeof(float));
-        
-        for(int i = 0; i < sizeof(t)/sizeof(float); i++){
-            arr[i] = reinterpret_cast<float*>(&val)[i];
+    // Handles stay valid until the shader changes, unknown names give invalidUniform which is ignored by setUniform
+    uniform_handle getUniformHandle(const std::string& name) const{
+        if(auto handle = uniformHandles.find(name); handle != uniformHandles.end()){
+            return handle->second;
         }
+        return invalidUniform;
+    }
 
-        if(floatUniforms.find(name) != floatUniforms.end()){
-            floatUniforms[name] = arr;
+    template<typename t>
+    typename std::enable_if<(sizeof(t)%sizeof(float) == 0)>::type
+    setUniform(uniform_handle handle, const t& val){
+        if(handle >= uniformSlots.size()){
             return;
         }
-        
-        //std::cout << "Uniform non existant " << name << std::endl;
-        //floatUniforms.insert({name, arr});
+
+        writeUniform(uniformSlots[handle], &val, sizeof(t));
+    }
+
+    template<typename t>
+    typename std::enable_if<(sizeof(t)%sizeof(float) == 0)>::type
+    setUniform(std::string name, t val){
+        setUniform(getUniformHandle(name), val);
     }
 
     void setTexture(std::string name, std::shared_ptr<Texture> texture){
@@ -89,19 +149,78 @@ public:
             textures.insert({name, texture});
         }
 
-        updateDescriptorSet();
+        // Bindless textures are uploaded as indices with the other uniforms
+        if(isBindlessTexture(name)){
+            writeTextureIndex(name);
+        }else{
+            updateDescriptorSet();
+        }
     }
 
-    std::vector<std::pair<size_t, std::vector<float>>> getUniforms(){
-        std::vector<std::pair<size_t, std::vector<float>>> uni;
+    const std::map<std::string, std::shared_ptr<Texture>>& getTextures(){
+        return textures;
+    }
+
+    // Texture streaming replaces views, sets sampling them directly are written again.
+    // A new sampler can move a packed texture to another array, its index is only marked changed when it differs
+    void refreshTextures(){
+        bool setsChanged = false;
 
-        for(auto const& [key, val] : floatUniforms){
-            if(shaderProgram->getGraphicsPipeline()->getUniformData().contains(key)){
-                uni.push_back(std::pair<size_t, std::vector<float>>(shaderProgram->getGraphicsPipeline()->getUniformData().getOffset(key), val));
+        for(const auto& [name, texture] : textures){
+            if(isBindlessTexture(name)){
+                writeTextureIndex(name);
+            }else if(textureVersions[name] != texture->getVersion()){
+                setsChanged = true;
             }
         }
 
-        return uni;
+        if(setsChanged){
+            updateDescriptorSet();
+        }
+    }
+
+    // Equal only for materials that bind the same shader, textures and values
+    std::vector<std::byte> getStateKey(){
+        std::vector<std::byte> key;
+
+        auto append = [&](const void* data, size_t size){
+            const std::byte* bytes = static_cast<const std::byte*>(data);
+            key.insert(key.end(), bytes, bytes + size);
+        };
+
+        // Sized, so different splits of the same bytes differ
+        auto appendBlock = [&](std::span<const std::byte> block){
+            size_t size = block.size();
+            append(&size, sizeof(size));
+            append(block.data(), size);
+        };
+
+        const void* shader = shaderProgram.get();
+        append(&shader, sizeof(shader));
+        appendBlock(uniformBlock);
+        appendBlock(pushConstantBlock);
+
+        for(const auto& [name, texture] : textures){
+            appendBlock(std::as_bytes(std::span(name)));
+            const void* handle = texture.get();
+            append(&handle, sizeof(handle));
+        }
+
+        return key;
+    }
+
+    // Laid out as the material set's uniform blocks, bindless texture indices included
+    std::span<const std::byte> getUniforms() const{
+        return uniformBlock;
+    }
+
+    std::span<const VulkanUniformRange> getUniformRanges() const{
+        return uniformRanges;
+    }
+
+    // Values of the shader's push constant block, pushed with each draw instead of written to the uniform buffer
+    std::span<const std::byte> getPushConstants() const{
+        return pushConstantBlock;
     }
 
     void setDescriptorSet(std::vector<std::shared_ptr<VulkanDescriptorSet>> sets){
@@ -114,6 +233,10 @@ public:
 
     void updateDescriptorSet(){
         for(const auto& [name, texture] : textures){
+            if(isBindlessTexture(name)){
+                continue;
+            }
+            textureVersions[name] = texture->getVersion();
             for(auto& set : descriptorSet){
                 set->setTexture(name, texture->getTextureView(), texture->getTextureSampler());
             }
@@ -125,7 +248,12 @@ public:
 
     void clearUniformsAndDescriptorSet(){
         descriptorSet.clear();
-        floatUniforms.clear();
+        uniformSlots.clear();
+        uniformHandles.clear();
+        uniformBlock.clear();
+        pushConstantBlock.clear();
+        uniformRanges.clear();
+        uniformsResolved = false;
         textures.clear();
     }
 
@@ -160,29 +288,37 @@ public:
             const float step = 0.01f;
             ImGui::SeparatorText("Uniforms: ");
 
-            for(auto& [name, uniform] : floatUniforms){
+            for(const auto& slot : uniformSlots){
+                if(slot.bindlessTexture){
+                    continue;
+                }
+
+                const std::string& name = slot.name;
+                float* values = getUniformValues(slot);
+                bool changed = false;
+
                 ImGui::Separator();          
-                switch(uniform.size()){
+                switch(slot.componentCount){
 
                 case 16:
-                    ImGui::DragFloat4(name.c_str(), floatUniforms.at(name).data(), step);
-                    ImGui::DragFloat4(("##" + name+"1").c_str(), floatUniforms.at(name).data()+4, step);
-                    ImGui::DragFloat4(("##" + name+"2").c_str(), floatUniforms.at(name).data()+8, step);
-                    ImGui::DragFloat4(("##" + name+"3").c_str(), floatUniforms.at(name).data()+12, step);
+                    changed |= ImGui::DragFloat4(name.c_str(), values, step);
+                    changed |= ImGui::DragFloat4(("##" + name+"1").c_str(), values+4, step);
+                    changed |= ImGui::DragFloat4(("##" + name+"2").c_str(), values+8, step);
+                    changed |= ImGui::DragFloat4(("##" + name+"3").c_str(), values+12, step);
                     break;
 
-                case 9:
-                    ImGui::DragFloat3(name.c_str(), floatUniforms.at(name).data(), step);
-                    ImGui::DragFloat3(("##" + name+"1").c_str(), floatUniforms.at(name).data()+3, step);
-                    ImGui::DragFloat3(("##" + name+"2").c_str(), floatUniforms.at(name).data()+6, step);
+                case 9: // std140 mat3 columns are padded to vec4
+                    changed |= ImGui::DragFloat3(name.c_str(), values, step);
+                    changed |= ImGui::DragFloat3(("##" + name+"1").c_str(), values+4, step);
+                    changed |= ImGui::DragFloat3(("##" + name+"2").c_str(), values+8, step);
                     break;
 
                 case 4:
-                    ImGui::DragFloat4(name.c_str(), floatUniforms.at(name).data(), step);
+                    changed |= ImGui::DragFloat4(name.c_str(), values, step);
                     break;
 
                 case 3:
-                    ImGui::DragFloat3(name.c_str(), floatUniforms.at(name).data(), step);
+                    changed |= ImGui::DragFloat3(name.c_str(), values, step);
                     ImGui::SameLine();
                     if(ImGui::SmallButton(("C##" + name).c_str())){
                         ImGui::OpenPopup(("ColorPicker##Popup" + name).c_str());
@@ -197,9 +333,10 @@ public:
                         ImGui::ColorPicker3("Color", glm::value_ptr(color));
 
                         if(ImGui::Button("Apply")){
-                            floatUniforms.at(name)[0] = color.x;
-                            floatUniforms.at(name)[1] = color.y;
-                            floatUniforms.at(name)[2] = color.z;
+                            values[0] = color.x;
+                            values[1] = color.y;
+                            values[2] = color.z;
+                            changed = true;
                             ImGui::CloseCurrentPopup();
                         }
                         ImGui::SameLine();
@@ -212,16 +349,20 @@ public:
                     break;
 
                 case 2:
-                    ImGui::DragFloat2(name.c_str(), floatUniforms.at(name).data(), step);
+                    changed |= ImGui::DragFloat2(name.c_str(), values, step);
                     break;
 
                 case 1:
-                    ImGui::DragFloat(name.c_str(), floatUniforms.at(name).data(), step);
+                    changed |= ImGui::DragFloat(name.c_str(), values, step);
                     break;
                 
                 default:
                     break;
                 }
+
+                if(changed){
+                    markChanged(slot);
+                }
             }
 
             
@@ -274,6 +415,36 @@ public:
 
                     }
 
+                    // Sampler of the texture resource, shared by every material using it
+                    VulkanSamplerDescription sampler = tex->getSamplerDescription();
+                    bool nearest = sampler.magFilter == VK_FILTER_NEAREST;
+                    bool clamp = sampler.addressMode == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+                    bool changed = false;
+
+                    ImGui::Indent(10.0f);
+                    changed |= ImGui::Checkbox(("Nearest##" + name).c_str(), &nearest);
+                    ImGui::SameLine();
+                    changed |= ImGui::Checkbox(("Clamp##" + name).c_str(), &clamp);
+
+                    // Every new value is another sampler and moves packed textures to another array, so only the released one is applied
+                    int anisotropy = anisotropyEdits.contains(name) ? anisotropyEdits.at(name) : static_cast<int>(std::round(sampler.maxAnisotropy));
+                    if(ImGui::SliderInt(("Anisotropy##" + name).c_str(), &anisotropy, 1, 16)){
+                        anisotropyEdits.insert_or_assign(name, anisotropy);
+                    }
+                    if(ImGui::IsItemDeactivatedAfterEdit()){
+                        sampler.maxAnisotropy = static_cast<float>(anisotropy);
+                        anisotropyEdits.erase(name);
+                        changed = true;
+                    }
+                    ImGui::Unindent(10.0f);
+
+                    if(changed){
+                        sampler.magFilter = sampler.minFilter = nearest ? VK_FILTER_NEAREST : VK_FILTER_LINEAR;
+                        sampler.mipmapMode = nearest ? VK_SAMPLER_MIPMAP_MODE_NEAREST : VK_SAMPLER_MIPMAP_MODE_LINEAR;
+                        sampler.addressMode = clamp ? VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE : VK_SAMPLER_ADDRESS_MODE_REPEAT;
+                        tex->setSamplerDescription(sampler);
+                    }
+
                 }
 
             }
@@ -282,11 +453,87 @@ public:
     }
 
 
+private:
+    void addUniformSlot(uniformSlot slot){
+        uniformHandles.insert_or_assign(slot.name, static_cast<uniform_handle>(uniformSlots.size()));
+        uniformSlots.push_back(slot);
+    }
+
+    float* getUniformValues(const uniformSlot& slot){
+        return reinterpret_cast<float*>((slot.pushConstant ? pushConstantBlock : uniformBlock).data() + slot.offset);
+    }
+
+    // Offsets in floats of the columns of a slot and their length, std140 pads mat3 columns and array elements to vec4 as the inspector expects
+    std::pair<std::vector<uint32_t>, uint32_t> getUniformColumns(const uniformSlot& slot){
+        uint32_t columns = slot.componentCount == 16 ? 4 : slot.componentCount == 9 ? 3 : 1;
+        uint32_t count = slot.pushConstant ? columns : std::max(columns, slot.size / 16);
+
+        std::vector<uint32_t> offsets;
+        for(uint32_t i = 0; i < count; i++){
+            offsets.push_back(i * 4);
+        }
+        return {offsets, slot.componentCount / columns};
+    }
+
+    void writeUniform(const uniformSlot& slot, const void* data, size_t size){
+        if(size > slot.size){
+            throw std::runtime_error(std::format("Uniform {} has {} bytes, {} given", slot.name, slot.size, size));
+        }
+
+        // Scripts set the same values every frame, unchanged data is not uploaded again
+        if(std::memcmp(getUniformValues(slot), data, size) == 0){
+            return;
+        }
+
+        std::memcpy(getUniformValues(slot), data, size);
+        markChanged(slot);
+    }
+
+    void markChanged(const uniformSlot& slot){
+        if(!slot.pushConstant){
+            uniformRanges[slot.range].version = ++uniformVersion;
+        }
+    }
+
+    bool isBindlessTexture(const std::string& name){
+        uniform_handle handle = getUniformHandle(name);
+        return handle != invalidUniform && uniformSlots[handle].bindlessTexture;
+    }
+
+    void writeTextureIndex(const std::string& name){
+        if(isBindlessTexture(name)){
+            uint32_t index = textures.at(name)->getBindlessIndex();
+            writeUniform(uniformSlots[getUniformHandle(name)], &index, sizeof(index));
+        }
+    }
+
+    std::shared_ptr<Texture> getDefaultTexture(bool cubemap){
+        if(cubemap){
+            return resourceManager->getResource<Texture>({"./textures/NoTexture.jpg", "./textures/NoTexture.jpg", "./textures/NoTexture.jpg", "./textures/NoTexture.jpg", "./textures/NoTexture.jpg", "./textures/NoTexture.jpg"});
+        }
+
+        return resourceManager->getResource<Texture>("./textures/NoTexture.jpg");
+    }
+
+public:
     json saveToJson(){
         json component;
         
         component["shader"] = shaderProgram->getPath();
-        component["uniforms"] = floatUniforms;
+        component["uniforms"] = std::map<std::string, std::vector<float>>();
+
+        for(const auto& slot : uniformSlots){
+            if(!slot.bindlessTexture){
+                float* values = getUniformValues(slot);
+                auto [columns, rows] = getUniformColumns(slot);
+
+                std::vector<float> saved;
+                for(uint32_t column : columns){
+                    saved.insert(saved.end(), values + column, values + column + rows);
+                }
+                component["uniforms"][slot.name] = saved;
+            }
+        }
         component["textures"] = std::map<std::string, std::string>();
 
         for(auto& [name, tex] : textures){
@@ -300,9 +547,21 @@ public:
 
         shaderProgram = resourceManager->getResource<ShaderProgram>(component["shader"].get<std::string>());
         clearUniformsAndDescriptorSet();
+        updateUniforms();
 
         for(auto& [name, val] : component["uniforms"].items()){
-            floatUniforms.insert({name, val.get<std::vector<float>>()});
+            if(uniform_handle handle = getUniformHandle(name); handle != invalidUniform){
+                const uniformSlot& slot = uniformSlots[handle];
+                std::vector<float> values = val.get<std::vector<float>>();
+                auto [columns, rows] = getUniformColumns(slot);
+
+                // Saved without padding, placed back column by column
+                std::vector<float> padded(getUniformValues(slot), getUniformValues(slot) + slot.size / sizeof(float));
+                for(uint32_t i = 0; i < columns.size() && i * rows < values.size(); i++){
+                    std::copy_n(values.begin() + i * rows, std::min<size_t>(rows, values.size() - i * rows), padded.begin() + columns[i]);
+                }
+                writeUniform(slot, padded.data(), padded.size() * sizeof(float));
+            }
         }
 
         for(auto& [name, tex] : component["textures"].items()){
@@ -33,6 +33,15 @@ public:
         return {mesh->getVertexBuffer()->getVertexCount(), mesh->getIndexBuffer()->getIndexCount()};
     }
 
+    // Local space axis aligned bounding box, min and max
+    std::pair<glm::vec3, glm::vec3> getBounds(){
+        return mesh->getBounds();
+    }
+
+    float getUvDensity(){
+        return mesh->getUvDensity();
+    }
+
     void guiDisplayInspector(){
         if(ImGui::CollapsingHeader("Model")){
             
@@ -7,6 +7,7 @@
 #include "components/cameraComponent.h"
 #include "components/skyboxRendererComponent.h"
 #include "components/scriptComponent.h"
+#include "components/lightSourceComponent.h"
 
 namespace MSIVulkanDemo{
 
@@ -20,6 +21,6 @@ template<typename ... components> struct componentlist{
         "All components must be constructible with components params"
     );
 };
-using AllComponents = componentlist<RenderComponent, ModelComponent, TransformComponent, MaterialComponent, CameraComponent, SkyboxRendererComponent, ScriptComponent>;
+using AllComponents = componentlist<RenderComponent, ModelComponent, TransformComponent, MaterialComponent, CameraComponent, SkyboxRendererComponent, ScriptComponent, LightSourceComponent>;
 
 }
\ No newline at end of file
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "vulkan/vulkanCore.h"
+#include "resources/shaderProgram.h"
+
+#include "imgui.h"
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace MSIVulkanDemo{
+
+
+// Scales the resolution of the scene nodes to hold a GPU frame time budget and upscales the result to the swapchain
+class DynamicResolution : public VulkanDescriptorSetOwner{
+public:
+    enum class Policy{
+        Fixed,
+        Dynamic
+    };
+
+private:
+    std::shared_ptr<VulkanRenderGraph> renderGraph;
+    std::shared_ptr<ShaderProgram> shaderProgram;
+    std::shared_ptr<VulkanTextureSampler> sampler;
+    std::string inputResource;
+
+    std::vector<std::shared_ptr<VulkanDescriptorSet>> descriptorSet;
+    VkImageView writtenInputView = nullptr;
+
+    Policy policy = Policy::Dynamic;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float fixedScale = 1.0f;
+    float targetFrameTime = 1000.0f / 60.0f; // ms
+    float sharpness = 0.25f;
+
+    float scale = 1.0f;
+
+public:
+    DynamicResolution(std::shared_ptr<VulkanRenderGraph> renderGraph, std::shared_ptr<ShaderProgram> shaderProgram, std::shared_ptr<VulkanTextureSampler> sampler, std::string inputResource): renderGraph(renderGraph), shaderProgram(shaderProgram), sampler(sampler), inputResource(inputResource){
+
+    }
+
+    ~DynamicResolution(){}
+
+    void update(){
+
+        if(policy == Policy::Fixed){
+            scale = fixedScale;
+        }else if(float frameTime = renderGraph->getGpuFrameTime(); frameTime > 0.0f){
+            float ratio = targetFrameTime / frameTime;
+
+            // Dead zone and slow approach, so the scale does not oscillate around the budget
+            if(std::abs(1.0f - ratio) > 0.05f){
+                // Cost follows the pixel count, which grows with the square of the scale
+                float desired = scale * std::sqrt(ratio);
+                scale += (desired - scale) * 0.1f;
+            }
+        }
+
+        scale = std::clamp(scale, minScale, maxScale);
+
+        renderGraph->setRenderScale(scale);
+    }
+
+    void render(VulkanCommandBuffer& commandBuffer){
+
+        if(descriptorSet.empty()){
+            renderGraph->registerDescriptorSet(this);
+        }
+
+        // Input view is recreated with the swapchain
+        if(writtenInputView != *renderGraph->getResourceView(inputResource)){
+            updateDescriptorSet();
+        }
+
+        VkExtent2D inputExtent = renderGraph->getRecordedRenderExtent();
+        VulkanUniformData uniformData = getGraphicsPipeline()->getUniformData();
+
+        commandBuffer
+        .bind(getGraphicsPipeline())
+        .bind(descriptorSet)
+        .setUniform(std::vector<std::pair<size_t, std::vector<float>>>({
+            {uniformData.getOffset("_inputScale"), {inputExtent.width / (float) commandBuffer.getWidth(), inputExtent.height / (float) commandBuffer.getHeight()}},
+            {uniformData.getOffset("_inputSize"), {(float) commandBuffer.getWidth(), (float) commandBuffer.getHeight()}},
+            {uniformData.getOffset("_sharpness"), {sharpness}}
+        }));
+
+        commandBuffer.draw(3);
+    }
+
+    void guiMenuBar(){
+        VkExtent2D extent = renderGraph->getRenderExtent();
+
+        ImGui::Text("%s %.0f%% (%.0f-%.0f%%) %ux%u", policy == Policy::Dynamic ? "Dynamic" : "Fixed", scale * 100.0f, minScale * 100.0f, maxScale * 100.0f, extent.width, extent.height);
+
+        if(ImGui::BeginMenu("Resolution")){
+            if(ImGui::MenuItem("Dynamic", nullptr, policy == Policy::Dynamic)){
+                policy = Policy::Dynamic;
+            }
+            if(ImGui::MenuItem("Fixed", nullptr, policy == Policy::Fixed)){
+                policy = Policy::Fixed;
+            }
+
+            ImGui::Separator();
+
+            if(policy == Policy::Dynamic){
+                ImGui::SliderFloat("Min scale", &minScale, 0.25f, 1.0f);
+                ImGui::SliderFloat("Max scale", &maxScale, 0.25f, 1.0f);
+                ImGui::SliderFloat("GPU budget (ms)", &targetFrameTime, 2.0f, 50.0f);
+                ImGui::Text("GPU frame time: %.2f ms", renderGraph->getGpuFrameTime());
+            }else{
+                ImGui::SliderFloat("Scale", &fixedScale, 0.25f, 1.0f);
+            }
+
+            ImGui::SliderFloat("Sharpness", &sharpness, 0.0f, 1.0f);
+
+            minScale = std::min(minScale, maxScale);
+            fixedScale = std::clamp(fixedScale, 0.25f, 1.0f);
+
+            ImGui::EndMenu();
+        }
+    }
+
+    float getScale(){
+        return scale;
+    }
+
+    std::shared_ptr<VulkanGraphicsPipeline> getGraphicsPipeline(){
+        return shaderProgram->getGraphicsPipeline();
+    }
+
+    void setDescriptorSet(std::vector<std::shared_ptr<VulkanDescriptorSet>> sets){
+        descriptorSet = sets;
+
+        updateDescriptorSet();
+    }
+
+    std::vector<std::shared_ptr<VulkanDescriptorSet>> getDescriptorSet(){
+        return descriptorSet;
+    }
+
+private:
+
+    void updateDescriptorSet(){
+        writtenInputView = *renderGraph->getResourceView(inputResource);
+
+        for(auto& set : descriptorSet){
+            set->setTexture("_input", writtenInputView, *sampler);
+            set->writeDescriptorSet(getGraphicsPipeline()->getUniformData());
+        }
+    }
+
+};
+
+
+}
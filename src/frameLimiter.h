@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+namespace MSIVulkanDemo{
+
+
+class FrameLimiter{
+    using clock = std::chrono::steady_clock;
+
+    bool enabled = false;
+    float targetFps = 60.0f;
+
+    clock::time_point nextFrame = clock::now();
+
+    // sleep() overshoots by up to a scheduler tick, the rest is spun
+    const clock::duration spinThreshold = std::chrono::milliseconds(2);
+
+public:
+    FrameLimiter(){
+
+    }
+
+    bool isEnabled(){
+        return enabled;
+    }
+
+    void setEnabled(bool enable){
+        enabled = enable;
+        nextFrame = clock::now();
+    }
+
+    float getTargetFps(){
+        return targetFps;
+    }
+
+    void setTargetFps(float fps){
+        targetFps = std::clamp(fps, 1.0f, 1000.0f);
+    }
+
+    clock::duration getFrameDuration(){
+        return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+    }
+
+    // Blocks until the start of the next frame slot
+    void wait(){
+        if(!enabled){
+            return;
+        }
+
+        nextFrame += getFrameDuration();
+
+        auto now = clock::now();
+
+        // Fell behind (hitch, breakpoint), do not try to catch up with a burst of frames
+        if(nextFrame < now){
+            nextFrame = now;
+            return;
+        }
+
+        if(nextFrame - now > spinThreshold){
+            std::this_thread::sleep_for(nextFrame - now - spinThreshold);
+        }
+
+        while(clock::now() < nextFrame){
+            std::this_thread::yield();
+        }
+    }
+
+};
+
+
+
+}
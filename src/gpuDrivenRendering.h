@@ -0,0 +1,513 @@
+#pragma once
+
+#include "vulkan/vulkanCore.h"
+#include "vulkan/vulkanComputePipeline.h"
+#include "vulkan/vulkanTextureSampler.h"
+#include "resources/shaderProgram.h"
+
+#include "imgui.h"
+
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace MSIVulkanDemo{
+
+
+// Keeps transforms, bounds and draw parameters of the scene objects in a storage buffer (shaders/include/objects.glsl).
+// Objects sharing pipeline, material state and mesh form a bucket, a compute pass culls them against the view frustum
+// and compacts the visible ones into the indirect commands of their bucket, so one bucket costs one indirect draw.
+// With occlusion culling the objects visible last frame are drawn first (early phase), a depth pyramid (Hi-Z) is built
+// from their depth and the remaining objects are re-tested against it (late phase), see shaders/drawCulling.glsl
+class GpuDrivenRendering{
+public:
+    using BucketKey = std::tuple<const void*, std::vector<std::byte>, const void*>; // pipeline, material state (MaterialComponent::getStateKey), mesh
+
+    enum Phase{
+        Early,
+        Late
+    };
+
+    struct Bucket{
+        uint32_t owner; // entity whose pipeline, material and mesh are bound for the bucket
+        uint32_t firstCommand;
+        uint32_t capacity;
+    };
+
+    static constexpr uint32_t maxObjects = 16384;
+
+private:
+    // std430 layout of Object in objects.glsl
+    struct Object{
+        glm::mat4 model;
+        glm::vec4 boundsMin;
+        glm::vec4 boundsMax;
+        glm::uvec4 draw;
+    };
+
+    struct header{
+        glm::mat4 view;
+        glm::mat4 proj;
+        glm::vec4 frustum[6];
+        glm::uvec4 count;
+        glm::vec4 hiZ;
+    };
+
+    // CullingStatsBuffer in drawCulling.glsl
+    struct cullingStats{
+        uint32_t frustumCulled = 0;
+        uint32_t occluded = 0;
+        uint32_t earlyDraws = 0;
+        uint32_t lateDraws = 0;
+    };
+
+    // Farthest depth mip chain of the early phase depth, half of the depth buffer resolution at level 0
+    struct HiZPyramid{
+        std::shared_ptr<VulkanImage> image;
+        std::shared_ptr<VulkanImageView> sampledView;
+        std::vector<std::shared_ptr<VulkanImageView>> levelViews;
+        std::shared_ptr<VulkanStorageBuffer> levelParams; // uniform block of every level's descriptor set
+        std::vector<std::shared_ptr<VulkanDescriptorSet>> levelSets;
+        VkImageView depthView = VK_NULL_HANDLE; // the sets were written with, changes when the graph reallocates its resources
+    };
+
+    const uint32_t workGroupSize = 64;
+    const uint32_t hiZGroupSize = 8;
+    static constexpr uint32_t maxHiZLevels = 16;
+
+    std::shared_ptr<VulkanRenderGraph> renderGraph;
+    std::shared_ptr<VulkanDeviceI> device;
+    std::string depthResource;
+    std::shared_ptr<VulkanComputePipeline> computePipeline;
+    std::shared_ptr<VulkanComputePipeline> hiZPipeline;
+    std::shared_ptr<VulkanDescriptorPool> descriptorPool;
+    std::shared_ptr<VulkanTextureSampler> hiZSampler;
+
+    std::vector<std::shared_ptr<VulkanStorageBuffer>> objectBuffers;
+    std::vector<std::shared_ptr<VulkanStorageBuffer>> commandBuffers; // early commands followed by the late ones
+    std::vector<std::shared_ptr<VulkanStorageBuffer>> countBuffers;
+    std::vector<std::shared_ptr<VulkanStorageBuffer>> statsBuffers;
+    std::vector<std::shared_ptr<VulkanDescriptorSet>> descriptorSets;
+    std::vector<HiZPyramid> pyramids;
+
+    std::shared_ptr<VulkanStorageBuffer> visibilityBuffer; // device local, read by the early phase of the next frame
+    bool visibilityCleared = false;
+
+    std::vector<Object> objects;
+    std::vector<Bucket> buckets;
+    std::map<BucketKey, uint32_t> bucketIndices;
+
+    bool enabled = true;
+    bool frustumCulling = true;
+    bool occlusionCulling = true;
+    bool occlusionActive = false; // occlusion culling state of the recorded frame
+    uint32_t droppedObjects = 0;
+    uint32_t recordedDraws = 0;
+    cullingStats stats; // of the last finished frame
+
+public:
+    // Depth resource is the graph resource the early phase draws into, read by the node running cullOccluded (AddComputeInput)
+    GpuDrivenRendering(std::shared_ptr<VulkanRenderGraph> renderGraph, std::shared_ptr<VulkanDeviceI> device, std::string computeShaderPath, std::string hiZShaderPath, std::string depthResource): renderGraph(renderGraph), device(device), depthResource(depthResource){
+
+        hiZSampler = device->getTextureSampler(); // only texelFetch is used, immutable in the layouts
+        computePipeline = std::make_shared<VulkanComputePipeline>(device, std::make_shared<GlslShader>(device, computeShaderPath, ShaderType::Compute), std::map<std::string, std::shared_ptr<VulkanTextureSampler>>{{"_hiZ", hiZSampler}});
+        hiZPipeline = std::make_shared<VulkanComputePipeline>(device, std::make_shared<GlslShader>(device, hiZShaderPath, ShaderType::Compute), std::map<std::string, std::shared_ptr<VulkanTextureSampler>>{{"_hiZDepth", hiZSampler}});
+
+        uint32_t frames = renderGraph->getFramesInFlight();
+        descriptorPool = device->createDescriptorPool({
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * frames},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, (maxHiZLevels + 1) * frames},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxHiZLevels * frames},
+            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2 * maxHiZLevels * frames}
+        });
+
+        visibilityBuffer = device->getMemoryManager()->createBuffer<VulkanStorageBuffer>(maxObjects * sizeof(uint32_t), false);
+
+        std::vector<std::shared_ptr<VulkanBuffer>> objectGlobals;
+
+        for(uint32_t i = 0; i < frames; i++){
+            auto objectBuffer = device->getMemoryManager()->createBuffer<VulkanStorageBuffer>(sizeof(header) + maxObjects * sizeof(Object));
+            auto commandBuffer = device->getMemoryManager()->createBuffer<VulkanStorageBuffer>(2 * maxObjects * sizeof(VkDrawIndexedIndirectCommand), false, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+            auto countBuffer = device->getMemoryManager()->createBuffer<VulkanStorageBuffer>(2 * maxObjects * sizeof(uint32_t), false, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+            auto statsBuffer = device->getMemoryManager()->createBuffer<VulkanStorageBuffer>(sizeof(cullingStats));
+
+            auto set = descriptorPool->getDescriptorSet(computePipeline->getUniformData(), nullptr, 0);
+            set->setBuffer("_objects", *objectBuffer);
+            set->setBuffer("_drawCommands", *commandBuffer);
+            set->setBuffer("_drawCounts", *countBuffer);
+            set->setBuffer("_visibility", *visibilityBuffer);
+            set->setBuffer("_cullingStats", *statsBuffer);
+
+            HiZPyramid pyramid;
+            pyramid.levelParams = device->getMemoryManager()->createBuffer<VulkanStorageBuffer>(maxHiZLevels * hiZPipeline->getUniformData().getSize(), true, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+            for(uint32_t level = 0; level < maxHiZLevels; level++){
+                pyramid.levelSets.push_back(descriptorPool->getDescriptorSet(hiZPipeline->getUniformData(), pyramid.levelParams, level * hiZPipeline->getUniformData().getSize()));
+            }
+
+            objectBuffers.push_back(objectBuffer);
+            commandBuffers.push_back(commandBuffer);
+            countBuffers.push_back(countBuffer);
+            statsBuffers.push_back(statsBuffer);
+            descriptorSets.push_back(set);
+            pyramids.push_back(pyramid);
+
+            objectGlobals.push_back(objectBuffer);
+        }
+
+        renderGraph->setGlobalBuffer("_objects", objectGlobals);
+    }
+
+    ~GpuDrivenRendering(){}
+
+    void clear(){
+        objects.clear();
+        buckets.clear();
+        bucketIndices.clear();
+        droppedObjects = 0;
+        recordedDraws = 0;
+    }
+
+    // Returns the object index passed as first instance of its draws, maxObjects when the object was dropped
+    uint32_t addObject(BucketKey key, uint32_t owner, glm::mat4 model, std::pair<glm::vec3, glm::vec3> bounds, uint32_t indexCount){
+        if(objects.size() >= maxObjects){
+            droppedObjects++;
+            return maxObjects;
+        }
+
+        auto [it, inserted] = bucketIndices.try_emplace(key, buckets.size());
+        if(inserted){
+            buckets.push_back({owner, 0, 0});
+        }
+        buckets[it->second].capacity++;
+
+        objects.push_back({
+            .model = model,
+            .boundsMin = glm::vec4(bounds.first, 1.0f),
+            .boundsMax = glm::vec4(bounds.second, 1.0f),
+            .draw = {indexCount, 0, it->second, 0}
+        });
+
+        return objects.size() - 1;
+    }
+
+    // Uploads the objects of the frame and, when the GPU path is active, culls them into the indirect commands of the early phase
+    // Recorded outside of render passes before the passes drawing the objects, occlusion culling needs the depth of the pre-pass
+    void update(VulkanCommandBuffer& commandBuffer, glm::mat4 view, glm::mat4 proj, bool prepassDepth){
+        uint64_t frame = renderGraph->getRecordedFrame();
+        VkExtent2D extent = renderGraph->getRecordedRenderExtent();
+
+        uint32_t firstCommand = 0;
+        for(auto& bucket : buckets){
+            bucket.firstCommand = firstCommand;
+            firstCommand += bucket.capacity;
+        }
+
+        for(auto& object : objects){
+            object.draw.w = buckets[object.draw.z].firstCommand;
+        }
+
+        occlusionActive = isActive() && occlusionCulling && prepassDepth && !objects.empty();
+
+        if(isActive()){
+            preparePyramid(frame);
+        }
+
+        header head = {
+            .view = view,
+            .proj = proj,
+            .count = {objects.size(), frustumCulling ? 1 : 0, buckets.size(), Early},
+            .hiZ = {extent.width, extent.height, getHiZLevels(extent), occlusionActive ? 1.0f : 0.0f}
+        };
+
+        glm::mat4 rows = glm::transpose(proj * view);
+        glm::vec4 planes[6] = {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2]};
+        for(uint32_t i = 0; i < 6; i++){
+            head.frustum[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+        }
+
+        objectBuffers[frame]->uploadData(0, &head, sizeof(header));
+        if(!objects.empty()){
+            objectBuffers[frame]->uploadData(sizeof(header), objects.data(), objects.size() * sizeof(Object));
+        }
+
+        if(!isActive() || objects.empty()){
+            stats = cullingStats();
+            return;
+        }
+
+        // Written by the last frame recorded into this slot, its fence was waited for
+        statsBuffers[frame]->downloadData(0, &stats, sizeof(cullingStats));
+        cullingStats zero;
+        statsBuffers[frame]->uploadData(0, &zero, sizeof(cullingStats));
+
+        if(!visibilityCleared){
+            commandBuffer.fillBuffer(*visibilityBuffer, 0);
+            visibilityCleared = true;
+        }
+
+        // Without a count buffer all commands of a bucket are executed, culled ones have to stay zeroed
+        commandBuffer
+        .fillBuffer(*countBuffers[frame], 0, 0, 2 * buckets.size() * sizeof(uint32_t))
+        .fillBuffer(*commandBuffers[frame], 0, 0, 2 * objects.size() * sizeof(VkDrawIndexedIndirectCommand));
+
+        std::vector<VkBufferMemoryBarrier> barriers = {
+            bufferBarrier(*countBuffers[frame], VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+            bufferBarrier(*commandBuffers[frame], VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT),
+            bufferBarrier(*visibilityBuffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT)
+        };
+        commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+        commandBuffer
+        .bind(*computePipeline, *descriptorSets[frame])
+        .dispatch((objects.size() + workGroupSize - 1) / workGroupSize);
+
+        barriers = {
+            bufferBarrier(*countBuffers[frame], VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+            bufferBarrier(*commandBuffers[frame], VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT)
+        };
+        commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+
+        if(!occlusionActive){
+            barriers = {bufferBarrier(*statsBuffers[frame], VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT)};
+            commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+        }
+    }
+
+    // Builds the depth pyramid from the depth written by the early phase draws and culls the late phase
+    // Recorded outside of render passes after the depth pre-pass and before the pass drawing the late phase
+    void cullOccluded(VulkanCommandBuffer& commandBuffer){
+        if(!occlusionActive){
+            return;
+        }
+
+        uint64_t frame = renderGraph->getRecordedFrame();
+
+        buildHiZ(commandBuffer, frame);
+
+        // Early phase read the culling phase from the header and the visibility the late phase overwrites
+        std::vector<VkBufferMemoryBarrier> barriers = {
+            bufferBarrier(*objectBuffers[frame], VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT)
+        };
+        commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        commandBuffer.fillBuffer(*objectBuffers[frame], Late, offsetof(header, count) + 3 * sizeof(uint32_t), sizeof(uint32_t));
+
+        barriers = {
+            bufferBarrier(*objectBuffers[frame], VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT)
+        };
+        commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+        barriers = {
+            bufferBarrier(*visibilityBuffer, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT)
+        };
+        commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+        commandBuffer
+        .bind(*computePipeline, *descriptorSets[frame])
+        .dispatch((objects.size() + workGroupSize - 1) / workGroupSize);
+
+        barriers = {
+            bufferBarrier(*countBuffers[frame], VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+            bufferBarrier(*commandBuffers[frame], VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT)
+        };
+        commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+
+        // Visibility is read by the early phase of the next frame
+        barriers = {
+            bufferBarrier(*visibilityBuffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)
+        };
+        commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+        barriers = {bufferBarrier(*statsBuffers[frame], VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT)};
+        commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+    }
+
+    // Pipeline, mesh and material of the bucket owner have to be bound
+    void draw(VulkanCommandBuffer& commandBuffer, const Bucket& bucket, Phase phase = Early){
+        uint64_t frame = renderGraph->getRecordedFrame();
+        uint32_t bucketIndex = &bucket - buckets.data();
+
+        // Late commands and counts follow the early ones of the frame
+        uint32_t commandOffset = phase == Late ? objects.size() : 0;
+        uint32_t countOffset = phase == Late ? buckets.size() : 0;
+
+        commandBuffer.drawIndirect(*commandBuffers[frame], (commandOffset + bucket.firstCommand) * sizeof(VkDrawIndexedIndirectCommand), bucket.capacity, countBuffers[frame].get(), (countOffset + bucketIndex) * sizeof(uint32_t));
+        recordedDraws++;
+    }
+
+    const std::vector<Bucket>& getBuckets(){
+        return buckets;
+    }
+
+    // Indirect draws need multiDrawIndirect and drawIndirectFirstInstance (object index in the vertex shader)
+    bool isSupported(){
+        return device->getEnabledFeatures().multiDrawIndirect && device->getEnabledFeatures().drawIndirectFirstInstance;
+    }
+
+    bool isActive(){
+        return enabled && isSupported();
+    }
+
+    // The late phase has to be drawn by the frame being recorded
+    bool isOcclusionCullingActive(){
+        return occlusionActive;
+    }
+
+    void guiMenu(){
+        ImGui::SeparatorText("GPU-driven rendering");
+
+        if(!isSupported()){
+            ImGui::Text("Unsupported: needs multiDrawIndirect and drawIndirectFirstInstance");
+        }else{
+            ImGui::Checkbox("Indirect draws", &enabled);
+            ImGui::Checkbox("GPU frustum culling", &frustumCulling);
+            ImGui::Checkbox("GPU occlusion culling (Hi-Z)", &occlusionCulling);
+            ImGui::Text("Draw count from GPU: %s", device->getDrawIndexedIndirectCount() ? "yes" : "no (VK_KHR_draw_indirect_count missing)");
+        }
+
+        ImGui::Text("Objects: %u, buckets: %u", static_cast<uint32_t>(objects.size()), static_cast<uint32_t>(buckets.size()));
+        if(isActive()){
+            ImGui::Text("Recorded indirect draws: %u", recordedDraws);
+            ImGui::Text("Frustum culled: %u, occluded: %u", stats.frustumCulled, stats.occluded);
+            ImGui::Text("Drawn objects: %u early, %u late", stats.earlyDraws, stats.lateDraws);
+        }
+        if(droppedObjects > 0){
+            ImGui::Text("Dropped objects: %u (limit %u)", droppedObjects, maxObjects);
+        }
+    }
+
+private:
+
+    uint32_t getHiZLevels(VkExtent2D extent){
+        uint32_t size = std::max((extent.width + 1) / 2, (extent.height + 1) / 2);
+        return std::min(static_cast<uint32_t>(std::floor(std::log2(size))) + 1, maxHiZLevels);
+    }
+
+    // (Re)creates the pyramid of the frame slot when the depth buffer was reallocated, the slot's previous frame has finished
+    void preparePyramid(uint64_t frame){
+        HiZPyramid& pyramid = pyramids[frame];
+        std::shared_ptr<VulkanImageView> depthView = renderGraph->getResourceView(depthResource);
+
+        if(pyramid.image && pyramid.depthView == *depthView){
+            return;
+        }
+
+        auto [width, height] = depthView->getImage()->getResolution();
+        std::pair<uint32_t, uint32_t> resolution = {std::max(1u, (width + 1) / 2), std::max(1u, (height + 1) / 2)};
+        uint32_t levels = std::min(static_cast<uint32_t>(std::floor(std::log2(std::max(resolution.first, resolution.second)))) + 1, maxHiZLevels);
+
+        pyramid.image = device->getMemoryManager()->createImage<VulkanImage>(resolution, VulkanImage::constructParameters{
+            .format = VK_FORMAT_R32_SFLOAT,
+            .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            .mipLevels = levels
+        });
+        pyramid.image->transitionImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        pyramid.sampledView = pyramid.image->createImageView(VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D, 1, 0, 0, levels);
+        pyramid.levelViews.clear();
+        for(uint32_t level = 0; level < levels; level++){
+            pyramid.levelViews.push_back(pyramid.image->createImageView(VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D, 1, 0, level, 1));
+        }
+
+        for(uint32_t level = 0; level < levels; level++){
+            auto& set = pyramid.levelSets[level];
+            set->setTexture("_hiZDepth", *depthView, *hiZSampler);
+            set->setTexture("_hiZSource", *pyramid.levelViews[level > 0 ? level - 1 : 0], VK_NULL_HANDLE);
+            set->setTexture("_hiZDestination", *pyramid.levelViews[level], VK_NULL_HANDLE);
+            set->writeDescriptorSet(hiZPipeline->getUniformData());
+        }
+
+        descriptorSets[frame]->setTexture("_hiZ", *pyramid.sampledView, *hiZSampler);
+        descriptorSets[frame]->writeDescriptorSet(computePipeline->getUniformData());
+
+        pyramid.depthView = *depthView;
+    }
+
+    // Depth pyramid of the rendered area, the depth buffer is returned to the layout of the depth pre-pass
+    void buildHiZ(VulkanCommandBuffer& commandBuffer, uint64_t frame){
+        HiZPyramid& pyramid = pyramids[frame];
+        VkExtent2D extent = renderGraph->getRecordedRenderExtent();
+        std::shared_ptr<VulkanImage> depthImage = renderGraph->getResourceView(depthResource)->getImage();
+
+        uint32_t levels = std::min(getHiZLevels(extent), pyramid.image->getMipLevels());
+        size_t paramsSize = hiZPipeline->getUniformData().getSize();
+
+        glm::uvec2 sourceSize = {extent.width, extent.height};
+        for(uint32_t level = 0; level < levels; level++){
+            glm::uvec4 params = {sourceSize.x, sourceSize.y, level == 0 ? 1 : 0, 0};
+            pyramid.levelParams->uploadData(level * paramsSize, &params, sizeof(params));
+            sourceSize = (sourceSize + 1u) / 2u;
+        }
+
+        std::vector<VkImageMemoryBarrier> barriers = {
+            imageBarrier(*depthImage, 0, 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+            imageBarrier(*pyramid.image, 0, pyramid.image->getMipLevels(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, 0, VK_ACCESS_SHADER_WRITE_BIT)
+        };
+        commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+        sourceSize = {extent.width, extent.height};
+        for(uint32_t level = 0; level < levels; level++){
+            sourceSize = (sourceSize + 1u) / 2u;
+
+            commandBuffer
+            .bind(*hiZPipeline, *pyramid.levelSets[level])
+            .dispatch((sourceSize.x + hiZGroupSize - 1) / hiZGroupSize, (sourceSize.y + hiZGroupSize - 1) / hiZGroupSize);
+
+            barriers = {imageBarrier(*pyramid.image, level, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT)};
+            commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+
+        barriers = {
+            imageBarrier(*pyramid.image, 0, pyramid.image->getMipLevels(), VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT)
+        };
+        commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+        barriers = {
+            imageBarrier(*depthImage, 0, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 0, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT)
+        };
+        commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT);
+    }
+
+    VkImageMemoryBarrier imageBarrier(VulkanImage& image, uint32_t baseLevel, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess){
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = image.getAspectMask();
+        barrier.subresourceRange.baseMipLevel = baseLevel;
+        barrier.subresourceRange.levelCount = levelCount;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = image.getArrayLayers();
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+
+        return barrier;
+    }
+
+    VkBufferMemoryBarrier bufferBarrier(VulkanBufferI& buffer, VkAccessFlags srcAccess, VkAccessFlags dstAccess){
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+
+        return barrier;
+    }
+
+};
+
+
+}
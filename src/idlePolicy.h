@@ -0,0 +1,83 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "json.h"
+
+#include <chrono>
+#include <algorithm>
+
+namespace MSIVulkanDemo{
+
+
+// Decides how the main loop behaves while the window is minimized or in the background
+class IdlePolicy : public JsonI{
+    using clock = std::chrono::steady_clock;
+
+public:
+    enum class State{
+        Foreground,
+        Background, // visible, not focused
+        Hidden // minimized or zero sized
+    };
+
+    float backgroundFps = 15.0f; // 0 - not throttled
+    float hiddenFps = 4.0f; // rate of script updates while hidden, unused when scripts are suspended
+    bool suspendScriptsWhenHidden = true;
+    bool throttleInBackground = true;
+
+private:
+    clock::time_point lastFrame = clock::now();
+
+public:
+    IdlePolicy(){
+
+    }
+
+    // Blocks in glfwWaitEventsTimeout until the next frame of the given state is due, events are still processed
+    // Returns false when the frame should be skipped entirely (suspended until an event arrives)
+    bool wait(GLFWwindow* window, State state){
+        if(state == State::Foreground || (state == State::Background && (!throttleInBackground || backgroundFps <= 0.0f))){
+            lastFrame = clock::now();
+            return true;
+        }
+
+        if(state == State::Hidden && suspendScriptsWhenHidden){
+            glfwWaitEvents();
+            lastFrame = clock::now();
+            return false;
+        }
+
+        float fps = state == State::Hidden ? hiddenFps : backgroundFps;
+        auto deadline = lastFrame + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / std::max(fps, 0.1f)));
+
+        for(auto now = clock::now(); now < deadline && !glfwWindowShouldClose(window); now = clock::now()){
+            glfwWaitEventsTimeout(std::chrono::duration<double>(deadline - now).count());
+        }
+
+        lastFrame = clock::now();
+        return true;
+    }
+
+    json saveToJson(){
+        return {
+            {"backgroundFps", backgroundFps},
+            {"hiddenFps", hiddenFps},
+            {"suspendScriptsWhenHidden", suspendScriptsWhenHidden},
+            {"throttleInBackground", throttleInBackground}
+        };
+    }
+
+    void loadFromJson(json policy){
+        backgroundFps = policy.value("backgroundFps", backgroundFps);
+        hiddenFps = policy.value("hiddenFps", hiddenFps);
+        suspendScriptsWhenHidden = policy.value("suspendScriptsWhenHidden", suspendScriptsWhenHidden);
+        throttleInBackground = policy.value("throttleInBackground", throttleInBackground);
+    }
+
+};
+
+
+
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "vulkan/vulkanCore.h"
+#include "fileDialog.h"
+
+#include "imgui.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+namespace MSIVulkanDemo{
+
+
+// GPU memory telemetry of the memory manager: heap budgets, categories and owners, warns when a heap gets close to its budget
+class MemoryDashboard{
+private:
+    std::shared_ptr<VulkanMemoryManager> memoryManager;
+
+    float warningLevel = 0.8f; // of the heap budget
+    std::vector<bool> heapWarned; // warned once per crossing of the warning level
+
+public:
+    MemoryDashboard(std::shared_ptr<VulkanMemoryManager> memoryManager): memoryManager(memoryManager){
+
+    }
+
+    ~MemoryDashboard(){}
+
+    void update(){
+        auto budgets = memoryManager->getHeapBudgets();
+        heapWarned.resize(budgets.size(), false);
+
+        for(uint32_t i = 0; i < budgets.size(); i++){
+            bool overWarningLevel = isOverWarningLevel(budgets[i]);
+
+            if(overWarningLevel && !heapWarned[i]){
+                std::cout << std::format("GPU memory heap {} at {} of {} MiB budget", i, budgets[i].usage / (1024 * 1024), budgets[i].budget / (1024 * 1024)) << std::endl;
+            }
+
+            heapWarned[i] = overWarningLevel;
+        }
+    }
+
+    void guiWindow(bool* open){
+        if(!ImGui::Begin("GPU memory", open)){
+            ImGui::End();
+            return;
+        }
+
+        ImGui::SeparatorText("Heaps");
+
+        auto budgets = memoryManager->getHeapBudgets();
+        const VkPhysicalDeviceMemoryProperties& properties = memoryManager->getMemoryProperties();
+
+        for(uint32_t i = 0; i < budgets.size(); i++){
+            const VmaBudget& budget = budgets[i];
+            float fraction = budget.budget > 0 ? budget.usage / (float) budget.budget : 0.0f;
+
+            std::string label = std::format("{:.1f} / {:.1f} MiB", budget.usage / (1024.0f * 1024.0f), budget.budget / (1024.0f * 1024.0f));
+
+            ImGui::Text("Heap %u%s", i, properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? " (device local)" : "");
+            if(isOverWarningLevel(budget)){
+                ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(0.9f, 0.2f, 0.2f, 1.0f));
+                ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f), label.c_str());
+                ImGui::PopStyleColor();
+            }else{
+                ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f), label.c_str());
+            }
+            ImGui::Text("%u blocks %.1f MiB, %u allocations %.1f MiB", budget.statistics.blockCount, budget.statistics.blockBytes / (1024.0f * 1024.0f), budget.statistics.allocationCount, budget.statistics.allocationBytes / (1024.0f * 1024.0f));
+        }
+
+        float budgetLimit = memoryManager->getBudgetLimit();
+        if(ImGui::SliderFloat("Budget limit", &budgetLimit, 0.1f, 1.0f)){
+            memoryManager->setBudgetLimit(budgetLimit);
+        }
+        ImGui::SliderFloat("Warning level", &warningLevel, 0.1f, 1.0f);
+
+        ImGui::SeparatorText("Categories");
+
+        auto allocationStats = memoryManager->getAllocationStatistics();
+
+        if(ImGui::BeginTable("Categories", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)){
+            ImGui::TableSetupColumn("Category");
+            ImGui::TableSetupColumn("Allocations");
+            ImGui::TableSetupColumn("Used MiB");
+            ImGui::TableSetupColumn("Pool blocks MiB");
+            ImGui::TableHeadersRow();
+
+            for(size_t i = 0; i < VulkanMemoryManager::categoryCount; i++){
+                auto category = static_cast<VulkanMemoryManager::Category>(i);
+                VmaStatistics poolStats = memoryManager->getCategoryStatistics(category);
+
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", VulkanMemoryManager::categoryNames[i]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%u", allocationStats[i].allocationCount);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", allocationStats[i].allocationBytes / (1024.0f * 1024.0f));
+                ImGui::TableNextColumn();
+                if(category == VulkanMemoryManager::Category::Other){
+                    ImGui::Text("-");
+                }else{
+                    ImGui::Text("%.2f", poolStats.blockBytes / (1024.0f * 1024.0f));
+                }
+            }
+
+            ImGui::EndTable();
+        }
+
+        ImGui::SeparatorText("Owners");
+
+        if(ImGui::BeginTable("Owners", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_SizingStretchProp, ImVec2(0.0f, 250.0f))){
+            ImGui::TableSetupColumn("Owner");
+            ImGui::TableSetupColumn("Category");
+            ImGui::TableSetupColumn("Allocations");
+            ImGui::TableSetupColumn("MiB");
+            ImGui::TableHeadersRow();
+
+            for(const auto& owner : memoryManager->getOwnerStatistics()){
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", owner.owner.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", VulkanMemoryManager::categoryNames[static_cast<size_t>(owner.category)]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%u", owner.allocationCount);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", owner.bytes / (1024.0f * 1024.0f));
+            }
+
+            ImGui::EndTable();
+        }
+
+        if(ImGui::Button("Dump VMA JSON")){
+            std::string filePath = FileDialog::fileDialog().savePath("vma_stats.json");
+            if(!filePath.empty()){
+                std::ofstream outputFile(filePath);
+                outputFile << memoryManager->getStatsJson();
+            }
+        }
+
+        ImGui::End();
+    }
+
+private:
+    bool isOverWarningLevel(const VmaBudget& budget){
+        return budget.budget > 0 && budget.usage > budget.budget * warningLevel;
+    }
+
+};
+
+
+}
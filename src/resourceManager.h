@@ -2,11 +2,18 @@
 
 #include <iostream>
 #include <filesystem>
+#include <fstream>
 #include <vector>
 #include <memory>
 #include <numeric>
 #include <type_traits>
 #include <any>
+#include <map>
+#include <optional>
+#include <algorithm>
+#include <functional>
+
+#include "imgui.h"
 
 namespace MSIVulkanDemo{
 
@@ -15,9 +22,19 @@ class ResourceManager;
 class Resource : public std::enable_shared_from_this<Resource>{
     friend ResourceManager;
 
+public:
+    // What stays in RAM after the GPU copy is uploaded, a released copy is loaded again when an evicted GPU copy is needed
+    enum class Retention{
+        Drop,
+        Keep, // decoded data for CPU queries
+        Compressed // file contents as read from disk, decoded again on upload
+    };
+
 private:
     std::vector<std::string> paths; // TODO change to id (path + classname/hash)
     std::chrono::system_clock::duration dateModified; // TODO support for multiple files
+    bool used = false; // since the last residency update
+    Retention retention = Retention::Keep;
 
 public:
     Resource(){}
@@ -36,6 +53,32 @@ public:
         
     }
 
+protected:
+    // Keeps the GPU copy from being evicted as least recently used
+    void markUsed(){
+        used = true;
+    }
+
+    Retention getRetention(){
+        return retention;
+    }
+
+    static std::vector<unsigned char> readBinaryFile(const std::string& path){
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open file: " + path);
+        }
+
+        size_t fileSize = (size_t) file.tellg();
+        std::vector<unsigned char> buffer(fileSize);
+
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(buffer.data()), fileSize);
+
+        return buffer;
+    }
+
     std::string getCombinedPath(){
         return combinePaths(paths);
     }
@@ -55,6 +98,34 @@ private:
         return;
     }
 
+    // Residency of the GPU copy, resources without one are only kept alive on the CPU side
+    virtual size_t getGpuSize(){
+        return 0;
+    }
+
+    // Bytes retained in RAM for the GPU copy
+    virtual size_t getCpuSize(){
+        return 0;
+    }
+
+    virtual bool isResident(){
+        return true;
+    }
+
+    // Only if the GPU copy is fetched again for every use, e.g. not written into descriptor sets
+    virtual bool isEvictableWhileReferenced(){
+        return false;
+    }
+
+    virtual void evict(){
+        return;
+    }
+
+    // Uploads the GPU copy again after an eviction
+    virtual void makeResident(){
+        return;
+    }
+
     void setPath(std::vector<std::string> paths){
         this->paths = paths;
         /* TODO
@@ -70,59 +141,81 @@ private:
 };
 
 
+// Resources stay loaded for a while after the last user drops them, so e.g. switching a material's shader back and forth
+// does not reload it from disk. GPU copies of unreferenced resources (and of meshes not drawn recently) are evicted
+// least recently used first once the resident ones exceed the GPU budget, and uploaded again from the CPU copy on the next use
 class ResourceManager{
+public:
+    struct residencySettings{
+        float keepAliveTime = 30.0f; // seconds an unreferenced resource stays loaded
+        uint32_t keepAliveCount = 64; // unreferenced resources kept at most, the longest unreferenced are dropped first
+        size_t gpuBudget = 512ull * 1024 * 1024; // bytes of resident GPU copies
+        uint32_t minIdleFrames = 3; // frames since the last use before a GPU copy can be evicted
+        uint32_t thrashFrames = 120; // upload again within this many frames of the eviction counts as thrashing
+    };
+
+    struct residencyStats{
+        uint32_t tracked = 0;
+        uint32_t unreferenced = 0;
+        uint32_t evicted = 0;
+        size_t gpuBytes = 0;
+        size_t cpuBytes = 0;
+        uint64_t cacheHits = 0; // unreferenced resources requested again instead of loaded from disk
+        uint64_t evictions = 0;
+        uint64_t reuploads = 0;
+        uint64_t thrashes = 0;
+        float thrashRate = 0.0f; // per second
+    };
+
 private:
+    struct residencyEntry{
+        std::shared_ptr<Resource> resource; // keep-alive, unreferenced when it is the only owner
+        uint64_t lastUsedFrame = 0;
+        float unreferencedTime = 0.0f;
+        std::optional<uint64_t> evictedFrame;
+    };
+
     std::map<std::string, std::weak_ptr<Resource>> resources;
     std::map<size_t, std::vector<std::any>> dependencies;
+    std::map<size_t, Resource::Retention> retentions;
+
+    std::map<std::string, residencyEntry> residency;
+    residencySettings settings;
+    residencyStats stats;
+    uint64_t frame = 0;
+
+    float thrashTime = 0.0f;
+    uint64_t thrashesCounted = 0;
 
 public:
     template<typename T>
     typename std::enable_if<std::is_base_of<Resource, T>::value, std::shared_ptr<T>>::type
     getResource(std::string path){
-
-        if(resources.find(path) == resources.end()){
-            std::shared_ptr<T> resPtr = createResource<T>(path);
-            resources.insert({path, resPtr});
-            return resPtr;
-        }
-
-        if(!resources[path].expired()){
-            return std::dynamic_pointer_cast<T>(resources[path].lock());
-        }else{
-            std::shared_ptr<T> resPtr = createResource<T>(path);
-            resources[path] = resPtr;
-            return resPtr;
-        }
-
+        return findOrCreateResource<T>(path, [&](){
+            return createResource<T>(path);
+        });
     }
 
     template<typename T>
     typename std::enable_if<std::is_base_of<Resource, T>::value, std::shared_ptr<T>>::type
     getResource(std::vector<std::string> paths){
-
-        std::string path = Resource::combinePaths(paths);
-
-        if(resources.find(path) == resources.end()){
-            std::shared_ptr<T> resPtr = createResource<T>(paths);
-            resources.insert({path, resPtr});
-            return resPtr;
-        }
-
-        if(!resources[path].expired()){
-            return std::dynamic_pointer_cast<T>(resources[path].lock());
-        }else{
-            std::shared_ptr<T> resPtr = createResource<T>(paths);
-            resources[path] = resPtr;
-            return resPtr;
-        }
-
+        return findOrCreateResource<T>(Resource::combinePaths(paths), [&](){
+            return createResource<T>(paths);
+        });
     }
 
     template<typename T, typename D>
     typename std::enable_if<std::is_base_of<Resource, T>::value>::type
-    addDependency(const D& dependency){ // TODO add multiple dependency
+    addDependency(const D& dependency){ // resources look their dependencies up by type
         size_t id = typeid(T).hash_code();
-        dependencies.insert({id, std::vector({std::make_any<D>(dependency)})});
+        dependencies[id].push_back(std::make_any<D>(dependency));
+    }
+
+    // Applies to resources of the type created afterwards
+    template<typename T>
+    typename std::enable_if<std::is_base_of<Resource, T>::value>::type
+    setRetention(Resource::Retention retention){
+        retentions[typeid(T).hash_code()] = retention;
     }
 
     void updateResources(){
@@ -160,7 +253,197 @@ public:
 
     }
 
+    // Once per frame, before the frame's resources are fetched, frames are finished so GPU copies can be released right away
+    void updateResidency(float deltaTime){
+        frame++;
+
+        for(auto& [path, entry] : residency){
+            Resource& resource = *entry.resource;
+            bool referenced = entry.resource.use_count() > 1;
+
+            if(entry.evictedFrame && resource.isResident()){
+                stats.reuploads++;
+                if(frame - *entry.evictedFrame <= settings.thrashFrames){
+                    stats.thrashes++;
+                }
+                entry.evictedFrame.reset();
+            }
+
+            if(resource.used || (referenced && !resource.isEvictableWhileReferenced())){
+                entry.lastUsedFrame = frame;
+            }
+            resource.used = false;
+
+            entry.unreferencedTime = referenced ? 0.0f : entry.unreferencedTime + deltaTime;
+        }
+
+        releaseUnreferenced();
+        evictToBudget();
+
+        thrashTime += deltaTime;
+        if(thrashTime >= 1.0f){
+            stats.thrashRate = (stats.thrashes - thrashesCounted) / thrashTime;
+            thrashesCounted = stats.thrashes;
+            thrashTime = 0.0f;
+        }
+    }
+
+    // For allocations the GPU memory budget refuses: evicts idle GPU copies least recently used first until bytes are freed,
+    // at least one. Returns false once there is nothing left to evict
+    bool evictForAllocation(size_t bytes){
+        std::vector<std::pair<uint64_t, residencyEntry*>> candidates = getEvictionCandidates();
+        size_t freed = 0;
+
+        for(auto& [lastUsed, entry] : candidates){
+            if(freed > 0 && freed >= bytes){
+                break;
+            }
+
+            freed += entry->resource->getGpuSize();
+            evictEntry(*entry);
+        }
+
+        return freed > 0;
+    }
+
+    residencySettings& getResidencySettings(){
+        return settings;
+    }
+
+    const residencyStats& getResidencyStats(){
+        return stats;
+    }
+
+    void guiMenu(){
+        ImGui::SeparatorText("Resource residency");
+
+        ImGui::SliderFloat("Keep alive (s)", &settings.keepAliveTime, 0.0f, 300.0f, "%.0f");
+
+        int keepAliveCount = static_cast<int>(settings.keepAliveCount);
+        if(ImGui::SliderInt("Keep alive count", &keepAliveCount, 0, 1024)){
+            settings.keepAliveCount = static_cast<uint32_t>(keepAliveCount);
+        }
+
+        int gpuBudget = static_cast<int>(settings.gpuBudget / (1024 * 1024));
+        if(ImGui::SliderInt("GPU budget (MiB)", &gpuBudget, 16, 8192)){
+            settings.gpuBudget = static_cast<size_t>(gpuBudget) * 1024 * 1024;
+        }
+
+        ImGui::Text("Resources: %u, unreferenced: %u, evicted: %u", stats.tracked, stats.unreferenced, stats.evicted);
+        ImGui::Text("Resident GPU copies: %.1f MiB", stats.gpuBytes / (1024.0f * 1024.0f));
+        ImGui::Text("Retained CPU copies: %.1f MiB", stats.cpuBytes / (1024.0f * 1024.0f));
+        ImGui::Text("Cache hits: %llu", static_cast<unsigned long long>(stats.cacheHits));
+        ImGui::Text("Evictions: %llu, uploads again: %llu", static_cast<unsigned long long>(stats.evictions), static_cast<unsigned long long>(stats.reuploads));
+        ImGui::Text("Thrashing: %llu (%.2f/s)", static_cast<unsigned long long>(stats.thrashes), stats.thrashRate);
+    }
+
 private:
+    template<typename T, typename F>
+    std::shared_ptr<T> findOrCreateResource(const std::string& path, F create){
+
+        if(resources.contains(path) && !resources[path].expired()){
+            residencyEntry& entry = residency[path];
+            if(!entry.resource){
+                entry.resource = resources[path].lock();
+            }else if(entry.resource.use_count() == 1){
+                stats.cacheHits++;
+            }
+
+            entry.resource->makeResident();
+            entry.resource->used = true;
+
+            return std::dynamic_pointer_cast<T>(entry.resource);
+        }
+
+        std::shared_ptr<T> resPtr = create();
+        resources[path] = resPtr;
+        residency[path] = {.resource = resPtr, .lastUsedFrame = frame};
+
+        return resPtr;
+    }
+
+    // Drops the keep-alive of resources unreferenced for too long, and of the longest unreferenced above the count limit
+    void releaseUnreferenced(){
+        std::vector<std::pair<float, std::string>> unreferenced;
+
+        for(const auto& [path, entry] : residency){
+            if(entry.resource.use_count() == 1){
+                unreferenced.push_back({entry.unreferencedTime, path});
+            }
+        }
+
+        std::sort(unreferenced.begin(), unreferenced.end(), std::greater<>());
+
+        for(size_t i = 0; i < unreferenced.size(); i++){
+            const auto& [time, path] = unreferenced[i];
+
+            if(time > settings.keepAliveTime || unreferenced.size() - i > settings.keepAliveCount){
+                residency.erase(path);
+            }
+        }
+    }
+
+    void evictToBudget(){
+        stats.tracked = 0;
+        stats.unreferenced = 0;
+        stats.evicted = 0;
+        stats.gpuBytes = 0;
+        stats.cpuBytes = 0;
+
+        for(auto& [path, entry] : residency){
+            Resource& resource = *entry.resource;
+            bool referenced = entry.resource.use_count() > 1;
+
+            stats.tracked++;
+            stats.unreferenced += referenced ? 0 : 1;
+            stats.cpuBytes += resource.getCpuSize();
+
+            if(!resource.isResident()){
+                stats.evicted++;
+                continue;
+            }
+
+            stats.gpuBytes += resource.getGpuSize();
+        }
+
+        for(auto& [lastUsed, entry] : getEvictionCandidates()){
+            if(stats.gpuBytes <= settings.gpuBudget){
+                break;
+            }
+
+            stats.gpuBytes -= entry->resource->getGpuSize();
+            evictEntry(*entry);
+        }
+    }
+
+    // Least recently used first, resources used in the current frame stay since the recorded commands may reference them
+    std::vector<std::pair<uint64_t, residencyEntry*>> getEvictionCandidates(){
+        std::vector<std::pair<uint64_t, residencyEntry*>> candidates;
+
+        for(auto& [path, entry] : residency){
+            Resource& resource = *entry.resource;
+            bool referenced = entry.resource.use_count() > 1;
+
+            if(resource.isResident() && resource.getGpuSize() > 0 && !resource.used && (!referenced || resource.isEvictableWhileReferenced()) && frame - entry.lastUsedFrame >= settings.minIdleFrames){
+                candidates.push_back({entry.lastUsedFrame, &entry});
+            }
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b){
+            return a.first < b.first;
+        });
+
+        return candidates;
+    }
+
+    void evictEntry(residencyEntry& entry){
+        entry.resource->evict();
+        entry.evictedFrame = frame;
+
+        stats.evictions++;
+        stats.evicted++;
+    }
+
     template<typename T>
     typename std::enable_if<std::is_base_of<Resource, T>::value, std::shared_ptr<T>>::type
     createResource(std::string path){
@@ -170,6 +453,10 @@ private:
 
         size_t id = typeid(T).hash_code();
 
+        if(retentions.contains(id)){
+            std::static_pointer_cast<Resource>(resPtr)->retention = retentions[id];
+        }
+
         if(dependencies.find(id) != dependencies.end()){
             std::static_pointer_cast<Resource>(resPtr)->loadDependency(dependencies[id]);
         }
@@ -186,6 +473,10 @@ private:
 
         size_t id = typeid(T).hash_code();
 
+        if(retentions.contains(id)){
+            std::static_pointer_cast<Resource>(resPtr)->retention = retentions[id];
+        }
+
         if(dependencies.find(id) != dependencies.end()){
             std::static_pointer_cast<Resource>(resPtr)->loadDependency(dependencies[id]);
         }
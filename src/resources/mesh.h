@@ -3,9 +3,13 @@
 #include "../vulkan/vulkanCore.h"
 #include "../resourceManager.h"
 
+#include <glm/glm.hpp>
+
 #include <iostream>
 #include <vector>
 #include <type_traits>
+#include <array>
+#include <cmath>
 
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -28,18 +32,125 @@ private:
     std::shared_ptr<VulkanIndexBuffer> indexBuffer;
     std::shared_ptr<VulkanMemoryManager> memoryManager;
 
-    std::unique_ptr<VulkanVertexData> vertexData;
+    std::unique_ptr<VulkanVertexData> vertexData; // released after the upload unless retained
+    std::vector<unsigned char> fileData; // .glb contents, kept with Retention::Compressed
+
+    std::pair<glm::vec3, glm::vec3> bounds = {glm::vec3(0.0f), glm::vec3(0.0f)}; // local space min and max
+    float uvDensity = 1.0f; // UV units per local space unit
 
 public:
     Mesh(std::string path){
+        fileData = readBinaryFile(path);
+        vertexData = parse(path, fileData);
+    }
+
+    ~Mesh(){}
+
+    // Buffers are uploaded again if they were evicted, so they are fetched for every draw and never kept
+    std::vector<std::shared_ptr<VulkanBufferI>> getBuffers(){
+        makeResident();
+        markUsed();
+        return buffers;
+    }
+
+    std::shared_ptr<VulkanVertexBuffer> getVertexBuffer(){
+        makeResident();
+        markUsed();
+        return vertexBuffer;
+    }
+
+    std::shared_ptr<VulkanIndexBuffer> getIndexBuffer(){
+        makeResident();
+        markUsed();
+        return indexBuffer;
+    }
+
+    std::pair<glm::vec3, glm::vec3> getBounds(){
+        return bounds;
+    }
+
+    float getUvDensity(){
+        return uvDensity;
+    }
+
+private:
+
+    void loadDependency(std::vector<std::any> dependencies){
+        memoryManager = std::any_cast<std::shared_ptr<VulkanMemoryManager>>(dependencies[0]);
+
+        upload();
+    }
+
+    size_t getGpuSize() override{
+        return isResident() ? vertexBuffer->getSize() + indexBuffer->getSize() : 0;
+    }
+
+    bool isResident() override{
+        return vertexBuffer != nullptr;
+    }
+
+    bool isEvictableWhileReferenced() override{
+        return true;
+    }
+
+    void evict() override{
+        buffers.clear();
+        vertexBuffer.reset();
+        indexBuffer.reset();
+    }
+
+    void makeResident() override{
+        if(!isResident() && memoryManager){
+            upload();
+        }
+    }
+
+    size_t getCpuSize() override{
+        return (vertexData ? vertexData->size() + vertexData->getIndicesSize() : 0) + fileData.size();
+    }
+
+    // The CPU copy is parsed again if it was released, from the retained file or from disk
+    void upload(){
+        if(!vertexData){
+            if(fileData.empty()){
+                fileData = readBinaryFile(getPath());
+            }
+            vertexData = parse(getPath(), fileData);
+        }
+
+        vertexBuffer = std::shared_ptr<VulkanVertexBuffer>(new VulkanVertexBuffer(memoryManager, *vertexData));
+
+        indexBuffer = std::shared_ptr<VulkanIndexBuffer>(new VulkanIndexBuffer(memoryManager, *vertexData));
+
+        vertexBuffer->setOwner(getPath());
+        indexBuffer->setOwner(getPath());
+
+        buffers.push_back(vertexBuffer);
+        buffers.push_back(indexBuffer);
+
+        releaseCpuCopy();
+    }
+
+    void releaseCpuCopy(){
+        if(getRetention() != Retention::Keep){
+            vertexData.reset();
+        }
+
+        if(getRetention() != Retention::Compressed){
+            fileData = {};
+        }
+    }
+
+    // Bounds and UV density are computed here and kept whatever the retention
+    std::unique_ptr<VulkanVertexData> parse(const std::string& path, const std::vector<unsigned char>& contents){
 
         tinygltf::Model model;
         tinygltf::TinyGLTF loader;
         std::string err;
         std::string warn;
 
-        //bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, argv[1]);
-        bool ret = loader.LoadBinaryFromFile(&model, &err, &warn, path); // for binary glTF(.glb)
+        std::string baseDir = std::filesystem::path(path).parent_path().string();
+        bool ret = loader.LoadBinaryFromMemory(&model, &err, &warn, contents.data(), static_cast<unsigned int>(contents.size()), baseDir); // for binary glTF(.glb)
 
         if (!warn.empty()) {
             std::cout << "glTF warn: " << warn << std::endl;
@@ -102,7 +213,19 @@ public:
             attributes.insert({supportedAttributes[key], {format, tinygltf::GetNumComponentsInType(accessor.type) * sizeof(float)}});
         }
 
-        vertexData = std::unique_ptr<VulkanVertexData>(new VulkanVertexData(attributes));
+        std::unique_ptr<VulkanVertexData> parsedData = std::unique_ptr<VulkanVertexData>(new VulkanVertexData(attributes));
+
+        if(attributesData.contains(supportedAttributes["POSITION"]) && vertexCount > 0){
+            auto& positions = attributesData[supportedAttributes["POSITION"]].second;
+
+            bounds = {glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest())};
+
+            for(uint32_t i = 0; i < vertexCount; i++){
+                glm::vec3 position(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+                bounds.first = glm::min(bounds.first, position);
+                bounds.second = glm::max(bounds.second, position);
+            }
+        }
 
         for(uint32_t i = 0; i < vertexCount; i++){
             std::vector<float> data;
@@ -113,7 +236,7 @@ public:
                 }
             }
 
-            vertexData->append(data);
+            parsedData->append(data);
         }
 
         
@@ -131,34 +254,39 @@ public:
             indicesData.push_back(val);
         }
 
-        vertexData->addIndices(indicesData);
-    }
+        parsedData->addIndices(indicesData);
 
-    ~Mesh(){}
+        // From the total area of the triangles in both spaces, texture streaming picks mips with it
+        if(attributesData.contains(supportedAttributes["POSITION"]) && attributesData.contains(supportedAttributes["TEXCOORD_0"])){
+            auto& positions = attributesData[supportedAttributes["POSITION"]].second;
+            auto& uvs = attributesData[supportedAttributes["TEXCOORD_0"]].second;
 
-    std::vector<std::shared_ptr<VulkanBufferI>> getBuffers(){
-        return buffers;
-    }
+            double positionArea = 0.0;
+            double uvArea = 0.0;
 
-    std::shared_ptr<VulkanVertexBuffer> getVertexBuffer(){
-        return vertexBuffer;
-    }
+            for(size_t i = 0; i + 2 < indicesData.size(); i += 3){
+                std::array<uint32_t, 3> triangle = {indicesData[i], indicesData[i + 1], indicesData[i + 2]};
 
-    std::shared_ptr<VulkanIndexBuffer> getIndexBuffer(){
-        return indexBuffer;
-    }
+                if(std::max({triangle[0], triangle[1], triangle[2]}) >= vertexCount){
+                    continue;
+                }
 
-private:
+                auto position = [&](uint32_t v){ return glm::vec3(positions[3 * v], positions[3 * v + 1], positions[3 * v + 2]); };
+                auto uv = [&](uint32_t v){ return glm::vec2(uvs[2 * v], uvs[2 * v + 1]); };
 
-    void loadDependency(std::vector<std::any> dependencies){
-        memoryManager = std::any_cast<std::shared_ptr<VulkanMemoryManager>>(dependencies[0]);
+                positionArea += glm::length(glm::cross(position(triangle[1]) - position(triangle[0]), position(triangle[2]) - position(triangle[0])));
 
-        vertexBuffer = std::shared_ptr<VulkanVertexBuffer>(new VulkanVertexBuffer(memoryManager, *vertexData));
+                glm::vec2 e1 = uv(triangle[1]) - uv(triangle[0]);
+                glm::vec2 e2 = uv(triangle[2]) - uv(triangle[0]);
+                uvArea += std::abs(e1.x * e2.y - e1.y * e2.x);
+            }
 
-        indexBuffer = std::shared_ptr<VulkanIndexBuffer>(new VulkanIndexBuffer(memoryManager, *vertexData));
+            if(positionArea > 0.0 && uvArea > 0.0){
+                uvDensity = static_cast<float>(std::sqrt(uvArea / positionArea));
+            }
+        }
 
-        buffers.push_back(vertexBuffer);
-        buffers.push_back(indexBuffer);
+        return parsedData;
     }
 
 };
@@ -4,6 +4,7 @@
 #include "../gameobject_decl.h"
 #include "../components/transformComponent.h"
 #include "../components/materialComponent.h"
+#include "../components/lightSourceComponent.h"
 #include "../gameobjectManagerI.h"
 
 #include <pybind11/embed.h>
@@ -63,6 +64,10 @@ public:
         if(T.equal(py::type::of<MSIVulkanDemo::MaterialComponent>())){
             return py::cast(gameObject->getComponent<MSIVulkanDemo::MaterialComponent>(), py::return_value_policy::reference);
         }
+
+        if(T.equal(py::type::of<MSIVulkanDemo::LightSourceComponent>())){
+            return py::cast(gameObject->getComponent<MSIVulkanDemo::LightSourceComponent>(), py::return_value_policy::reference);
+        }
         
         return py::none();
     }
@@ -221,11 +226,25 @@ PYBIND11_EMBEDDED_MODULE(MSIVulkanDemo, m) {
         .def("hasUniform", [](MSIVulkanDemo::MaterialComponent& mat, const PyString& a){
             return mat.hasUniform(a.str().c_str());
         })
-        .def("setUniform", &MSIVulkanDemo::MaterialComponent::setUniform<glm::vec3>)
+        .def("setUniform", [](MSIVulkanDemo::MaterialComponent& mat, std::string name, const glm::vec3& val){
+            return mat.setUniform(name, val);
+        })
         .def("setUniform", [](MSIVulkanDemo::MaterialComponent& mat, const PyString& a, const glm::vec3& b){
             return mat.setUniform(a.str().c_str(), b);
         });
 
+    py::class_<MSIVulkanDemo::LightSourceComponent>(m, "LightSourceComponent")
+        .def("setColor", &MSIVulkanDemo::LightSourceComponent::setColor)
+        .def("getColor", &MSIVulkanDemo::LightSourceComponent::getColor)
+        .def("setIntensity", &MSIVulkanDemo::LightSourceComponent::setIntensity)
+        .def("getIntensity", &MSIVulkanDemo::LightSourceComponent::getIntensity)
+        .def("setRange", &MSIVulkanDemo::LightSourceComponent::setRange)
+        .def("getRange", &MSIVulkanDemo::LightSourceComponent::getRange)
+        .def("setDirection", &MSIVulkanDemo::LightSourceComponent::setDirection)
+        .def("getDirection", &MSIVulkanDemo::LightSourceComponent::getDirection)
+        .def("setCastShadows", &MSIVulkanDemo::LightSourceComponent::setCastShadows)
+        .def("getCastShadows", &MSIVulkanDemo::LightSourceComponent::getCastShadows);
+
     py::class_<ObjectRef>(m, "ObjectRef")
         .def(py::init<>())
         .def(py::init<py::none>())
@@ -6,10 +6,44 @@
 #include <iostream>
 #include <vector>
 #include <type_traits>
+#include <filesystem>
 
 namespace MSIVulkanDemo{
 
 
+// Resolves #include "file" relative to the including shader
+class GlslIncluder : public shaderc::CompileOptions::IncluderInterface{
+    struct includeData{
+        std::string name;
+        std::string content;
+        shaderc_include_result result;
+    };
+
+public:
+    shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t includeDepth) override{
+        std::filesystem::path path = std::filesystem::path(requestingSource).parent_path() / requestedSource;
+
+        includeData* data = new includeData();
+        data->name = path.string();
+
+        std::ifstream file(path, std::ios::binary);
+        if(file.is_open()){
+            data->content = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }else{
+            data->name = ""; // empty name reports failure
+            data->content = "failed to open include file: " + path.string();
+        }
+
+        data->result = {data->name.c_str(), data->name.size(), data->content.c_str(), data->content.size(), data};
+        return &data->result;
+    }
+
+    void ReleaseInclude(shaderc_include_result* result) override{
+        delete static_cast<includeData*>(result->user_data);
+    }
+};
+
+
 class GlslShader: public VulkanShader{
 private:
     inline static shaderc::Compiler* compiler = nullptr;
@@ -61,6 +95,9 @@ public:
         //std::vector<std::tuple<std::string, VkFormat, size_t>> attributes;
 
         for(uint32_t i = 0; i < num; i++){
+            if(attribs[i]->decoration_flags & SPV_REFLECT_DECORATION_BUILT_IN){
+                continue; // gl_VertexIndex and similar are not vertex attributes
+            }
             //attributes.push_back({std::string(input_vars[i]->name), static_cast<VkFormat>(input_vars[i]->format), input_vars[i]->numeric.scalar.width/8 * input_vars[i]->numeric.vector.component_count /* TODO calculate size also for mats and arrays */});
             attributes.insert({attribs[i]->location, {static_cast<VkFormat>(attribs[i]->format), attribs[i]->numeric.scalar.width/8 * attribs[i]->numeric.vector.component_count}});
         }
@@ -83,8 +120,15 @@ public:
 
         std::vector<VulkanUniformData::bindingBlock> blocks; 
 
+        // Frame data and bindless textures are shared engine sets with fixed layouts
+        uint32_t ownSet = getType() == Compute ? 0 : VulkanFrameData::materialSet;
+
         for(uint32_t i = 0; i < varCount; i++){
 
+            if(inputVars[i]->set != ownSet){
+                continue;
+            }
+
             for(uint32_t j = 0; j < inputVars[i]->binding_count; j++){
                 auto binding = inputVars[i]->bindings[j];
 
@@ -93,6 +137,18 @@ public:
                 block.binding = binding->binding;
                 block.type = static_cast<VkDescriptorType>(binding->descriptor_type);
 
+                // Storage buffers and images are provided by the engine as a whole, members are not material uniforms
+                if(block.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER || block.type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE){
+                    block.attribs.push_back({
+                        .binding = block.binding, 
+                        .name = binding->name, 
+                        .size = 0, 
+                        .componentCount = 0
+                    });
+                    blocks.push_back(block);
+                    continue;
+                }
+
                 if(block.type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER){
                     block.attribs.push_back({
                         .binding = block.binding, 
@@ -117,6 +173,15 @@ public:
                     }else{
                         attrib.componentCount = 1;
                     }
+
+                    // Texture2D/TextureCube from include/bindless.glsl, the material uploads the texture's table index
+                    if(member.type_description && member.type_description->type_name){
+                        std::string typeName = member.type_description->type_name;
+                        if(typeName == "Texture2D" || typeName == "TextureCube"){
+                            attrib.bindlessTexture = true;
+                            attrib.componentCount = typeName == "TextureCube" ? 6 : 1;
+                        }
+                    }
                     
                     block.attribs.push_back(attrib);
                 }
@@ -129,6 +194,62 @@ public:
         return blocks;
     }
 
+    VulkanPushConstantData getPushConstantData(){
+
+        uint32_t blockCount = 0;
+        if(spvReflectEnumeratePushConstantBlocks(&module, &blockCount, NULL) != SPV_REFLECT_RESULT_SUCCESS){
+            throw std::runtime_error("Cannot fetch push constant block number");
+        }
+
+        std::vector<SpvReflectBlockVariable*> pushBlocks(blockCount);
+
+        if(spvReflectEnumeratePushConstantBlocks(&module, &blockCount, pushBlocks.data()) != SPV_REFLECT_RESULT_SUCCESS){
+            throw std::runtime_error("Cannot fetch push constant blocks");
+        }
+
+        std::vector<VulkanPushConstantData::attribute> attribs;
+
+        for(auto block : pushBlocks){
+            for(uint32_t k = 0; k < block->member_count; k++){
+                auto member = block->members[k];
+
+                VulkanPushConstantData::attribute attrib;
+                attrib.name = member.name;
+                attrib.offset = member.absolute_offset;
+                attrib.size = member.size;
+
+                if(member.numeric.matrix.column_count > 0){
+                    attrib.componentCount = member.numeric.matrix.column_count * member.numeric.matrix.row_count;
+                }else if(member.numeric.vector.component_count > 0){
+                    attrib.componentCount = member.numeric.vector.component_count;
+                }else{
+                    attrib.componentCount = 1;
+                }
+
+                attribs.push_back(attrib);
+            }
+        }
+
+        return VulkanPushConstantData(attribs, getStage());
+    }
+
+    bool usesBindlessTextures(){
+        uint32_t setCount = 0;
+        if(spvReflectEnumerateDescriptorSets(&module, &setCount, NULL) != SPV_REFLECT_RESULT_SUCCESS){
+            throw std::runtime_error("Cannot fetch descriptor set number");
+        }
+
+        std::vector<SpvReflectDescriptorSet*> sets(setCount);
+
+        if(spvReflectEnumerateDescriptorSets(&module, &setCount, sets.data()) != SPV_REFLECT_RESULT_SUCCESS){
+            throw std::runtime_error("Cannot fetch descriptor sets");
+        }
+
+        return std::any_of(sets.begin(), sets.end(), [](SpvReflectDescriptorSet* set){
+            return set->set == VulkanBindlessTextures::set;
+        });
+    }
+
 private:
 
     static std::string readShaderFile(const std::string& filename){
@@ -151,6 +272,7 @@ private:
 
     std::string preprocessGLSL(const std::string& source_name, ShaderType kind, const std::string& source) {
         shaderc::CompileOptions options;
+        options.SetIncluder(std::make_unique<GlslIncluder>());
 
         switch (kind){
         case Vertex:
@@ -161,6 +283,10 @@ private:
             options.AddMacroDefinition("FRAGMENT", "1");
             break;
 
+        case Compute:
+            options.AddMacroDefinition("COMPUTE", "1");
+            break;
+
         default:
             break;
         }
@@ -181,6 +307,7 @@ private:
 
     std::vector<uint32_t> compileGLSL(const std::string& source_name, ShaderType kind, const std::string& source, bool optimize = false){
         shaderc::CompileOptions options;
+        options.SetIncluder(std::make_unique<GlslIncluder>());
 
         //options.AddMacroDefinition("MY_DEFINE", "1");
         if (optimize) options.SetOptimizationLevel(shaderc_optimization_level_size);
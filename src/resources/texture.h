@@ -1,91 +1,372 @@
 #pragma once
 
-#include <stb_image.h>
-
 #include "../vulkan/vulkanCore.h"
 #include "../resourceManager.h"
+#include "textureLoader.h"
 
 #include <iostream>
 #include <vector>
 #include <type_traits>
+#include <future>
+#include <thread>
 
 namespace MSIVulkanDemo{
 
 
 class Texture : public Resource{
 public:
-    
+    static constexpr uint32_t streamingMinSize = 64; // streamed textures start with the mips up to this size
 
 private:
     std::shared_ptr<VulkanTexture> tex;
-    std::shared_ptr<VulkanTextureView> texView;
-    std::shared_ptr<VulkanTextureSampler> texSampler;
+    std::shared_ptr<VulkanImageView> texView; // of the own image or of the layer in a texture array
+    std::shared_ptr<VulkanTextureSampler> texSampler; // shared by the textures of the same description
+    VulkanSamplerDescription samplerDescription;
     std::shared_ptr<VulkanMemoryManager> memoryManager;
-
-    std::unique_ptr<VulkanImageData> imageData;
-    VulkanTexture::textureType type;
+    std::shared_ptr<VulkanBindlessTextures> bindlessTextures;
+    std::shared_ptr<VulkanTextureArrays> textureArrays; // optional
+    bool packed = false; // resident as a layer of a texture array, never streamed
+    uint64_t arrayGeneration = 0; // of the array's image the layer view was created from
+
+    std::shared_ptr<VulkanImageData> imageData; // full mip chain, released after the upload unless retained
+    std::vector<std::vector<unsigned char>> fileData; // encoded file of every layer, kept with Retention::Compressed
+    VulkanTexture::textureType type = VulkanTexture::Normal;
+    uint32_t bindlessIndex = 0;
+    TextureLoader::formatSupport formatSupport;
+
+    std::pair<uint32_t, uint32_t> resolution = {0, 0}; // of the first level
+    uint32_t mipLevels = 1;
+    std::vector<VkDeviceSize> levelBytes; // of all layers of every level
+    uint32_t residentMip = 0; // first level on the GPU, finer ones are streamed in on demand
+    uint64_t version = 0; // of the view, changes whenever the GPU copy is replaced
 
 public:
+    // Decoded once loaded, the device decides the transcode target of compressed containers
     Texture(std::string path){
-        int texWidth, texHeight, texChannels;
-        stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+        fileData.push_back(readBinaryFile(path));
+    }
 
-        imageData = std::unique_ptr<VulkanImageData>(new VulkanImageData({texWidth, texHeight}, 4, 1));  // WARN only 4 channels supported
+    Texture(std::vector<std::string> paths, VulkanTexture::textureType type = VulkanTexture::Cubemap): type(type){
+        for(std::string path : paths){
+            fileData.push_back(readBinaryFile(path));
+        }
+    }
 
-        std::vector<std::vector<uint8_t>> data;
+    ~Texture(){
+        if(bindlessTextures && isResident()){
+            removeFromTable();
+        }
+    }
 
-        data.push_back(std::vector<uint8_t>(pixels, pixels + texWidth * texHeight * 4));  // WARN only 4 channels supported
+    VulkanImageView& getTextureView(){
+        makeResident();
+        refreshLayerView();
+        markUsed();
+        return *texView;
+    }
 
-        imageData->append(data);
+    VulkanTextureSampler& getTextureSampler(){
+        return *texSampler;
+    }
 
-        stbi_image_free(pixels);
+    const VulkanSamplerDescription& getSamplerDescription(){
+        return samplerDescription;
     }
 
-    Texture(std::vector<std::string> paths, VulkanTexture::textureType type = VulkanTexture::Cubemap): type(type){
+    // Packed textures move to an array of the new sampler, their bindless index changes
+    void setSamplerDescription(const VulkanSamplerDescription& description){
+        if(description == samplerDescription){
+            return;
+        }
 
-        int texWidth, texHeight, texChannels;
-        stbi_image_free(stbi_load(paths[0].c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha));
+        samplerDescription = description;
 
-        imageData = std::unique_ptr<VulkanImageData>(new VulkanImageData({texWidth, texHeight}, 4, 6));  // WARN only 4 channels supported
+        if(!memoryManager){
+            return;
+        }
 
-        std::vector<std::vector<uint8_t>> data;
+        texSampler = memoryManager->getDevice()->getTextureSampler(samplerDescription);
 
-        for(std::string path : paths){
-            stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+        if(packed){
+            evict();
+            upload();
+        }else if(isResident()){
+            bindlessTextures->update(bindlessIndex, *texView, *texSampler, getBinding());
+            version++;
+        }
+    }
 
-            data.push_back(std::vector<uint8_t>(pixels, pixels + texWidth * texHeight * 4));  // WARN only 4 channels supported
+    // Index in the bindless table, valid once the texture is loaded, streaming keeps it.
+    // Packed textures get the array's index and their layer, see VulkanTextureArrays
+    uint32_t getBindlessIndex(){
+        return bindlessIndex;
+    }
+
+    bool isCubemap(){
+        return type == VulkanTexture::Cubemap;
+    }
 
-            //std::cout << path << ": " << texWidth << ", " << texHeight << std::endl;
+    uint64_t getVersion(){
+        refreshLayerView();
+        return version;
+    }
+
+    std::pair<uint32_t, uint32_t> getResolution(){
+        return resolution;
+    }
 
-            stbi_image_free(pixels);
+    uint32_t getMipLevels(){
+        return mipLevels;
+    }
+
+    bool isStreamable(){
+        return type == VulkanTexture::Normal && mipLevels > 1 && !packed;
+    }
+
+    uint32_t getResidentMip(){
+        return residentMip;
+    }
+
+    // Coarsest first level streaming goes down to
+    uint32_t getStreamingMinMip(){
+        uint32_t mip = 0;
+        while(mip + 1 < mipLevels && (std::max(resolution.first, resolution.second) >> mip) > streamingMinSize){
+            mip++;
         }
+        return mip;
+    }
 
-        imageData->append(data);
+    // GPU bytes with baseMip as the first level
+    VkDeviceSize getMipBytes(uint32_t baseMip){
+        VkDeviceSize bytes = 0;
+        for(uint32_t level = baseMip; level < levelBytes.size(); level++){
+            bytes += levelBytes[level];
+        }
+        return bytes;
     }
 
-    ~Texture(){}
+    // Finer levels than the resident ones are decoded on another thread from the retained CPU copy or the files, levels from baseMip on.
+    // The thread is detached and works on copies, dropping the future does not wait for the decode.
+    // It does not touch the device, the format was checked when the texture was first decoded on the main thread
+    std::future<std::shared_ptr<VulkanImageData>> loadMips(uint32_t baseMip){
+        if(imageData){
+            return runDetached([data = imageData, baseMip](){
+                return std::make_shared<VulkanImageData>(data->mipTail(baseMip));
+            });
+        }
 
-    VulkanTextureView& getTextureView(){
-        return *texView;
+        TextureLoader::formatSupport support = formatSupport;
+        support.physicalDevice = VK_NULL_HANDLE;
+
+        return runDetached([files = fileData, paths = getPaths(), name = getCombinedPath(), support, baseMip]() mutable{
+            if(files.empty()){
+                for(std::string path : paths){
+                    files.push_back(readBinaryFile(path));
+                }
+            }
+            return std::make_shared<VulkanImageData>(TextureLoader::decode(files, name, support)->mipTail(baseMip));
+        });
     }
 
-    VulkanTextureSampler& getTextureSampler(){
-        return *texSampler;
+    // Replaces the GPU copy by the levels from baseMip on, the bindless index stays the same
+    void setResidentMips(std::shared_ptr<VulkanImageData> mips, uint32_t baseMip){
+        if(!isResident()){
+            return;
+        }
+
+        markUsed(); // not evicted for the new image's allocation
+        createTexture(*mips);
+        residentMip = baseMip;
+
+        bindlessTextures->update(bindlessIndex, *texView, *texSampler, getBinding());
+    }
+
+    // Coarser levels are already on the GPU, the new image is copied from them instead of decoded again
+    void dropMips(uint32_t baseMip){
+        if(!isResident() || packed || baseMip <= residentMip || baseMip >= mipLevels){
+            return;
+        }
+
+        markUsed();
+        setTexture(std::shared_ptr<VulkanTexture>(new VulkanTexture(memoryManager, *tex, baseMip - residentMip)));
+        residentMip = baseMip;
+
+        bindlessTextures->update(bindlessIndex, *texView, *texSampler, getBinding());
     }
 
 private:
 
+    // Unlike std::async, the future's destructor does not block until the work is done
+    template<typename F>
+    static std::future<std::shared_ptr<VulkanImageData>> runDetached(F work){
+        std::promise<std::shared_ptr<VulkanImageData>> promise;
+        std::future<std::shared_ptr<VulkanImageData>> future = promise.get_future();
+
+        std::thread([promise = std::move(promise), work = std::move(work)]() mutable{
+            try{
+                promise.set_value(work());
+            }catch(...){
+                promise.set_exception(std::current_exception());
+            }
+        }).detach();
+
+        return future;
+    }
+
     void loadDependency(std::vector<std::any> dependencies){
-        memoryManager = std::any_cast<std::shared_ptr<VulkanMemoryManager>>(dependencies[0]);
+        for(auto& dep : dependencies){
+            if(dep.type() == typeid(std::shared_ptr<VulkanMemoryManager>)){
+                memoryManager = std::any_cast<std::shared_ptr<VulkanMemoryManager>>(dep);
+            }else if(dep.type() == typeid(std::shared_ptr<VulkanTextureArrays>)){
+                textureArrays = std::any_cast<std::shared_ptr<VulkanTextureArrays>>(dep);
+            }
+        }
 
-        tex = std::shared_ptr<VulkanTexture>(new VulkanTexture(memoryManager, *imageData, type));
-        texView = std::shared_ptr<VulkanTextureView>(new VulkanTextureView(tex));
-        texSampler = memoryManager->getDevice()->createTextureSampler();
+        texSampler = memoryManager->getDevice()->getTextureSampler(samplerDescription);
+        bindlessTextures = memoryManager->getDevice()->getBindlessTextures();
+
+        const VkPhysicalDeviceFeatures& features = memoryManager->getDevice()->getEnabledFeatures();
+        formatSupport = {.bc = features.textureCompressionBC == VK_TRUE, .etc2 = features.textureCompressionETC2 == VK_TRUE, .physicalDevice = memoryManager->getDevice()->getPhysicalDevice()};
+
+        upload();
 
         return;
     }
 
+    size_t getGpuSize() override{
+        if(!isResident()){
+            return 0;
+        }
+        return packed ? textureArrays->getTextureBytes(bindlessIndex) : tex->getSize();
+    }
+
+    bool isResident() override{
+        return texView != nullptr;
+    }
+
+    // Only once unreferenced, materials keep the view in their descriptor sets and the index in their uniforms
+    void evict() override{
+        removeFromTable();
+        texView.reset();
+        tex.reset();
+        packed = false;
+        residentMip = isStreamable() ? getStreamingMinMip() : 0;
+    }
+
+    void makeResident() override{
+        if(!isResident() && memoryManager){
+            upload();
+        }
+    }
+
+    size_t getCpuSize() override{
+        size_t size = imageData ? imageData->size() : 0;
+        for(const auto& file : fileData){
+            size += file.size();
+        }
+        return size;
+    }
+
+    // The CPU copy is decoded again if it was released, from the retained files or from disk.
+    // Streamable textures start with their smallest mips
+    void upload(){
+        if(!imageData){
+            if(fileData.empty()){
+                for(std::string path : getPaths()){
+                    fileData.push_back(readBinaryFile(path));
+                }
+            }
+            setImageData(TextureLoader::decode(fileData, getCombinedPath(), formatSupport));
+        }
+
+        packed = type == VulkanTexture::Normal && textureArrays && textureArrays->canPack(*imageData);
+        if(packed){
+            bindlessIndex = textureArrays->add(*imageData, samplerDescription);
+            texView = textureArrays->createLayerView(bindlessIndex);
+            arrayGeneration = textureArrays->getGeneration(bindlessIndex);
+            residentMip = 0;
+            version++;
+
+            releaseCpuCopy();
+            return;
+        }
+
+        residentMip = isStreamable() ? getStreamingMinMip() : 0;
+        if(residentMip > 0){
+            VulkanImageData mips = imageData->mipTail(residentMip);
+            createTexture(mips);
+        }else{
+            createTexture(*imageData);
+        }
+
+        bindlessIndex = bindlessTextures->add(*texView, *texSampler, getBinding());
+
+        releaseCpuCopy();
+    }
+
+    void createTexture(VulkanImageData& data){
+        setTexture(std::shared_ptr<VulkanTexture>(new VulkanTexture(memoryManager, data, type, data.getFormat())));
+    }
+
+    void setTexture(std::shared_ptr<VulkanTexture> texture){
+        tex = texture;
+        tex->setOwner(getCombinedPath());
+        texView = std::shared_ptr<VulkanTextureView>(new VulkanTextureView(tex));
+        version++;
+    }
+
+    // A grown array copied the layers to a new image, the bindless index stays but the layer view is of the old one
+    void refreshLayerView(){
+        if(packed && isResident() && textureArrays->getGeneration(bindlessIndex) != arrayGeneration){
+            texView = textureArrays->createLayerView(bindlessIndex);
+            arrayGeneration = textureArrays->getGeneration(bindlessIndex);
+            version++;
+        }
+    }
+
+    VulkanBindlessTextures::Binding getBinding(){
+        return isCubemap() ? VulkanBindlessTextures::TextureCube : VulkanBindlessTextures::Texture2D;
+    }
+
+    void removeFromTable(){
+        if(packed){
+            textureArrays->remove(bindlessIndex);
+        }else{
+            bindlessTextures->remove(bindlessIndex);
+        }
+    }
+
+    void setImageData(std::shared_ptr<VulkanImageData> data){
+        imageData = data;
+        resolution = imageData->getResolution();
+        mipLevels = imageData->getMipLevelsNum();
+
+        if(imageData->isCubemap()){
+            type = VulkanTexture::Cubemap;
+        }
+
+        // Views are single 2D images or cubemaps, further layers would never be sampled
+        if(imageData->getLayersNum() != (isCubemap() ? 6u : 1u)){
+            throw std::runtime_error(std::format("failed to load texture {}: {} layers, texture arrays unsupported", getCombinedPath(), imageData->getLayersNum()));
+        }
+
+        levelBytes.clear();
+        for(uint32_t level = 0; level < mipLevels; level++){
+            levelBytes.push_back(imageData->getMipOffset(level + 1) - imageData->getMipOffset(level));
+        }
+    }
+
+    void releaseCpuCopy(){
+        if(getRetention() != Retention::Keep){
+            imageData.reset();
+        }
+
+        if(getRetention() != Retention::Compressed){
+            fileData = {};
+        }
+    }
+
 };
 
 
-}
\ No newline at end of file
+}
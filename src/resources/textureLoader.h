@@ -0,0 +1,373 @@
+#pragma once
+
+#include <stb_image.h>
+#include <ktx.h>
+
+#include "../vulkan/vulkanImageData.h"
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <future>
+#include <algorithm>
+
+namespace MSIVulkanDemo{
+
+
+// Decodes texture files: KTX2 and DDS containers are uploaded as stored with their precomputed mips,
+// Basis Universal payloads are transcoded to a block format the device samples, other images go through stb
+class TextureLoader{
+public:
+    // Block compression the device has enabled, picks the transcode target of Basis Universal textures.
+    // Formats stored in containers are also checked on the physical device when one is given
+    struct formatSupport{
+        bool bc = false;
+        bool etc2 = false;
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    };
+
+private:
+    struct ddsPixelFormat{
+        uint32_t size, flags, fourCC, rgbBitCount, rBitMask, gBitMask, bBitMask, aBitMask;
+    };
+
+    struct ddsHeader{
+        uint32_t size, flags, height, width, pitchOrLinearSize, depth, mipMapCount, reserved1[11];
+        ddsPixelFormat pixelFormat;
+        uint32_t caps, caps2, caps3, caps4, reserved2;
+    };
+
+    struct ddsHeaderDx10{
+        uint32_t dxgiFormat, resourceDimension, miscFlag, arraySize, miscFlags2;
+    };
+
+    static constexpr uint32_t ddsPixelFormatFourCC = 0x4;
+    static constexpr uint32_t ddsPixelFormatRGB = 0x40;
+    static constexpr uint32_t ddsCaps2Cubemap = 0x200;
+    static constexpr uint32_t ddsDx10MiscTextureCube = 0x4;
+
+public:
+    // Every file holds one layer or, for containers, one 2D image or cubemap, the layers of all files are put together.
+    // Images without mips in the file get the full chain generated
+    static std::shared_ptr<VulkanImageData> decode(const std::vector<std::vector<unsigned char>>& files, const std::string& name, formatSupport support){
+        if(std::none_of(files.begin(), files.end(), [](const auto& file){ return isKtx2(file) || isDds(file); })){
+            return loadImages(files, name);
+        }
+
+        std::vector<VulkanImageData> parts;
+
+        for(const auto& file : files){
+            if(isKtx2(file)){
+                parts.push_back(loadKtx2(file, name, support));
+                checkFormat(parts.back().getFormat(), name, support);
+            }else if(isDds(file)){
+                parts.push_back(loadDds(file, name));
+                checkFormat(parts.back().getFormat(), name, support);
+            }else{
+                parts.push_back(*loadImages({file}, name));
+            }
+        }
+
+        std::shared_ptr<VulkanImageData> decoded;
+        if(parts.size() == 1){
+            decoded = std::make_shared<VulkanImageData>(std::move(parts.front()));
+        }else{
+            decoded = std::make_shared<VulkanImageData>(VulkanImageData::combineLayers(parts));
+        }
+        decoded->generateMipmaps();
+
+        return decoded;
+    }
+
+    // Bytes of one layer of a level
+    static size_t getLevelSize(VkFormat format, std::pair<uint32_t, uint32_t> resolution){
+        auto [blockBytes, blockSize] = getBlockInfo(format);
+        return static_cast<size_t>((resolution.first + blockSize - 1) / blockSize) * ((resolution.second + blockSize - 1) / blockSize) * blockBytes;
+    }
+
+private:
+    static bool isKtx2(const std::vector<unsigned char>& file){
+        static const unsigned char identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+        return file.size() >= sizeof(identifier) && std::memcmp(file.data(), identifier, sizeof(identifier)) == 0;
+    }
+
+    static bool isDds(const std::vector<unsigned char>& file){
+        return file.size() >= 4 + sizeof(ddsHeader) && std::memcmp(file.data(), "DDS ", 4) == 0;
+    }
+
+    // The headers give the size of all layers up front, the storage of the whole mip chain is allocated once
+    // and every layer is decoded on its own thread right into its place
+    static std::shared_ptr<VulkanImageData> loadImages(const std::vector<std::vector<unsigned char>>& files, const std::string& name){
+        int texWidth = 0, texHeight = 0;
+
+        for(const auto& file : files){
+            int width, height, channels;
+            if(!stbi_info_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &channels)){
+                throw std::runtime_error(std::format("failed to decode texture {}: {}", name, stbi_failure_reason()));
+            }
+
+            if(texWidth == 0){
+                texWidth = width;
+                texHeight = height;
+            }else if(width != texWidth || height != texHeight){
+                throw std::runtime_error(std::format("failed to decode texture {}: layers differ in resolution", name));
+            }
+        }
+
+        std::pair<uint32_t, uint32_t> resolution(texWidth, texHeight);
+        std::shared_ptr<VulkanImageData> image = std::make_shared<VulkanImageData>(resolution, 4, static_cast<uint32_t>(files.size()));  // WARN only 4 channels supported
+        image->allocate(VulkanImageData::getFullMipLevels(resolution));
+
+        std::vector<std::future<void>> layers;
+        for(uint32_t layer = 0; layer < files.size(); layer++){
+            layers.push_back(std::async(std::launch::async, [&files, &name, image, layer](){
+                int width, height, channels;
+                stbi_uc* pixels = stbi_load_from_memory(files[layer].data(), static_cast<int>(files[layer].size()), &width, &height, &channels, STBI_rgb_alpha);
+
+                if(!pixels){
+                    throw std::runtime_error(std::format("failed to decode texture {}: {}", name, stbi_failure_reason()));
+                }
+
+                std::memcpy(image->getLayerData(0, layer), pixels, static_cast<size_t>(width) * height * 4);
+                stbi_image_free(pixels);
+            }));
+        }
+
+        for(auto& layer : layers){
+            layer.get();
+        }
+
+        image->generateMipmaps();
+
+        return image;
+    }
+
+    static VulkanImageData loadKtx2(const std::vector<unsigned char>& file, const std::string& name, formatSupport support){
+        ktxTexture2* texture = nullptr;
+
+        if(KTX_error_code errCode = ktxTexture2_CreateFromMemory(file.data(), file.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &texture); errCode != KTX_SUCCESS){
+            throw std::runtime_error(std::format("failed to load KTX2 texture {}: {}", name, ktxErrorString(errCode)));
+        }
+
+        if(ktxTexture2_NeedsTranscoding(texture)){
+            ktx_transcode_fmt_e target = support.bc ? KTX_TTF_BC7_RGBA : support.etc2 ? KTX_TTF_ETC2_RGBA : KTX_TTF_RGBA32;
+
+            if(KTX_error_code errCode = ktxTexture2_TranscodeBasis(texture, target, 0); errCode != KTX_SUCCESS){
+                ktxTexture2_Destroy(texture);
+                throw std::runtime_error(std::format("failed to transcode KTX2 texture {}: {}", name, ktxErrorString(errCode)));
+            }
+        }
+
+        if(texture->numDimensions != 2){
+            ktxTexture2_Destroy(texture);
+            throw std::runtime_error(std::format("failed to load KTX2 texture {}: only 2D textures supported", name));
+        }
+
+        if(texture->numLayers > 1){
+            ktxTexture2_Destroy(texture);
+            throw std::runtime_error(std::format("failed to load KTX2 texture {}: texture arrays unsupported", name));
+        }
+
+        uint32_t layers = texture->numLayers * texture->numFaces;
+        std::vector<uint8_t> data;
+        std::vector<size_t> levelOffsets;
+
+        // libktx keeps the levels smallest first, the image data is level after level from the first one
+        for(uint32_t level = 0; level < texture->numLevels; level++){
+            levelOffsets.push_back(data.size());
+            size_t imageSize = ktxTexture_GetImageSize(ktxTexture(texture), level);
+
+            for(uint32_t layer = 0; layer < texture->numLayers; layer++){
+                for(uint32_t face = 0; face < texture->numFaces; face++){
+                    ktx_size_t offset;
+                    ktxTexture_GetImageOffset(ktxTexture(texture), level, layer, face, &offset);
+                    data.insert(data.end(), texture->pData + offset, texture->pData + offset + imageSize);
+                }
+            }
+        }
+
+        VulkanImageData image({texture->baseWidth, texture->baseHeight}, static_cast<VkFormat>(texture->vkFormat), layers, std::move(levelOffsets), std::move(data), texture->isCubemap);
+        ktxTexture2_Destroy(texture);
+
+        return image;
+    }
+
+    static VulkanImageData loadDds(const std::vector<unsigned char>& file, const std::string& name){
+        ddsHeader header;
+        std::memcpy(&header, file.data() + 4, sizeof(ddsHeader));
+        size_t dataOffset = 4 + sizeof(ddsHeader);
+
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t layers = 1;
+        bool cubemap = (header.caps2 & ddsCaps2Cubemap) != 0;
+
+        if((header.pixelFormat.flags & ddsPixelFormatFourCC) && header.pixelFormat.fourCC == fourCC("DX10")){
+            if(file.size() < dataOffset + sizeof(ddsHeaderDx10)){
+                throw std::runtime_error(std::format("failed to load DDS texture {}: truncated header", name));
+            }
+
+            ddsHeaderDx10 headerDx10;
+            std::memcpy(&headerDx10, file.data() + dataOffset, sizeof(ddsHeaderDx10));
+            dataOffset += sizeof(ddsHeaderDx10);
+
+            if(headerDx10.arraySize > 1){
+                throw std::runtime_error(std::format("failed to load DDS texture {}: texture arrays unsupported", name));
+            }
+
+            format = getDxgiFormat(headerDx10.dxgiFormat);
+            cubemap = (headerDx10.miscFlag & ddsDx10MiscTextureCube) != 0;
+        }else if(header.pixelFormat.flags & ddsPixelFormatFourCC){
+            format = getFourCCFormat(header.pixelFormat.fourCC);
+        }else if((header.pixelFormat.flags & ddsPixelFormatRGB) && header.pixelFormat.rgbBitCount == 32){
+            format = header.pixelFormat.rBitMask == 0x000000ff ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_B8G8R8A8_SRGB;
+        }
+
+        if(format == VK_FORMAT_UNDEFINED){
+            throw std::runtime_error(std::format("failed to load DDS texture {}: unsupported format", name));
+        }
+
+        if(cubemap){
+            layers *= 6;
+        }
+
+        std::pair<uint32_t, uint32_t> resolution = {header.width, header.height};
+        uint32_t mipLevels = std::max(header.mipMapCount, 1u);
+
+        size_t layerSize = 0;
+        std::vector<size_t> levelSizes;
+        for(uint32_t level = 0; level < mipLevels; level++){
+            levelSizes.push_back(getLevelSize(format, {std::max(resolution.first >> level, 1u), std::max(resolution.second >> level, 1u)}));
+            layerSize += levelSizes.back();
+        }
+
+        if(file.size() < dataOffset + layerSize * layers){
+            throw std::runtime_error(std::format("failed to load DDS texture {}: truncated data", name));
+        }
+
+        // DDS stores every layer with all its levels, reordered to level after level
+        std::vector<uint8_t> data;
+        data.reserve(layerSize * layers);
+        std::vector<size_t> levelOffsets;
+
+        size_t levelStart = 0;
+        for(uint32_t level = 0; level < mipLevels; level++){
+            levelOffsets.push_back(data.size());
+
+            for(uint32_t layer = 0; layer < layers; layer++){
+                const unsigned char* src = file.data() + dataOffset + layerSize * layer + levelStart;
+                data.insert(data.end(), src, src + levelSizes[level]);
+            }
+
+            levelStart += levelSizes[level];
+        }
+
+        return VulkanImageData(resolution, format, layers, std::move(levelOffsets), std::move(data), cubemap);
+    }
+
+    // Containers are uploaded as stored, block compressed formats need their feature enabled and every format has to be sampleable
+    static void checkFormat(VkFormat format, const std::string& name, formatSupport support){
+        bool bc = format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+        bool etc2 = format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK;
+
+        bool sampled = true;
+        if(support.physicalDevice){
+            VkFormatProperties properties{};
+            vkGetPhysicalDeviceFormatProperties(support.physicalDevice, format, &properties);
+            sampled = properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+        }
+
+        if((bc && !support.bc) || (etc2 && !support.etc2) || !sampled){
+            throw std::runtime_error(std::format("failed to load texture {}: format {} not supported by the device", name, static_cast<int>(format)));
+        }
+    }
+
+    static constexpr uint32_t fourCC(const char (&code)[5]){
+        return static_cast<uint32_t>(code[0]) | (static_cast<uint32_t>(code[1]) << 8) | (static_cast<uint32_t>(code[2]) << 16) | (static_cast<uint32_t>(code[3]) << 24);
+    }
+
+    // Legacy DDS carries no color space, color textures are assumed like the decoded ones
+    static VkFormat getFourCCFormat(uint32_t code){
+        switch(code){
+            case fourCC("DXT1"): return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+            case fourCC("DXT3"): return VK_FORMAT_BC2_SRGB_BLOCK;
+            case fourCC("DXT5"): return VK_FORMAT_BC3_SRGB_BLOCK;
+            case fourCC("ATI1"):
+            case fourCC("BC4U"): return VK_FORMAT_BC4_UNORM_BLOCK;
+            case fourCC("ATI2"):
+            case fourCC("BC5U"): return VK_FORMAT_BC5_UNORM_BLOCK;
+            default: return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    static VkFormat getDxgiFormat(uint32_t dxgiFormat){
+        switch(dxgiFormat){
+            case 2: return VK_FORMAT_R32G32B32A32_SFLOAT;
+            case 10: return VK_FORMAT_R16G16B16A16_SFLOAT;
+            case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+            case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+            case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+            case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+            case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+            case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+            case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+            case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+            case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+            case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+            case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+            case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+            case 87: return VK_FORMAT_B8G8R8A8_UNORM;
+            case 91: return VK_FORMAT_B8G8R8A8_SRGB;
+            case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+            case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+            case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+            case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+            default: return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    // Bytes of a block and its width in texels, uncompressed formats have 1x1 blocks
+    static std::pair<uint32_t, uint32_t> getBlockInfo(VkFormat format){
+        switch(format){
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            case VK_FORMAT_BC4_UNORM_BLOCK:
+            case VK_FORMAT_BC4_SNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+            case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+            case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+                return {8, 4};
+            case VK_FORMAT_BC2_UNORM_BLOCK:
+            case VK_FORMAT_BC2_SRGB_BLOCK:
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+            case VK_FORMAT_BC5_SNORM_BLOCK:
+            case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+            case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+            case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+            case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+                return {16, 4};
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+                return {8, 1};
+            case VK_FORMAT_R32G32B32A32_SFLOAT:
+                return {16, 1};
+            default:
+                return {4, 1};
+        }
+    }
+
+};
+
+
+}
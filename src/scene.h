@@ -12,6 +12,11 @@
 #include "gameobjectManagerI.h"
 #include "gameobject.h"
 #include "scriptManager.h"
+#include "dynamicResolution.h"
+#include "clusteredLighting.h"
+#include "shadowMapping.h"
+#include "gpuDrivenRendering.h"
+#include "textureStreaming.h"
 
 #include <iostream>
 #include <vector>
@@ -33,6 +38,24 @@ private:
 
     std::shared_ptr<ScriptManager> scriptManager;
 
+    bool depthPrepass = true;
+
+    std::shared_ptr<DynamicResolution> dynamicResolution;
+    std::shared_ptr<ClusteredLighting> clusteredLighting;
+    std::shared_ptr<ShadowMapping> shadowMapping;
+    std::shared_ptr<GpuDrivenRendering> gpuDrivenRendering;
+    std::shared_ptr<TextureStreaming> textureStreaming;
+    std::shared_ptr<VulkanTextureArrays> textureArrays;
+
+    std::vector<std::pair<entt::entity, uint32_t>> objectDraws; // entity, object index of the frame
+
+    const float fieldOfView = 45.0f;
+    const float nearPlane = 0.1f;
+    const float farPlane = 1000.0f;
+
+    float elapsedTime = 0.0f;
+    float frameTime = 0.0f;
+
 protected:
     std::shared_ptr<ResourceManager> resourceManager;
 
@@ -57,6 +80,13 @@ public:
 
     void updateScene(float deltaTime, Input& input){
 
+        elapsedTime += deltaTime;
+        frameTime = deltaTime;
+
+        if(dynamicResolution){
+            dynamicResolution->update();
+        }
+
         std::erase_if(gameObjects, [] (auto& kv){
             return kv.second->isRemoved();
         });
@@ -73,6 +103,9 @@ public:
             resourceRefreshTime += deltaTime;
         }
 
+        resourceManager->updateResidency(deltaTime);
+        streamTextures();
+
         ImGui::Begin("Scene objects", NULL, ImGuiWindowFlags_NoCollapse);
 
         static std::string selected = "";
@@ -171,38 +204,66 @@ public:
 
         ImGui::End();
 
+        updateScripts(deltaTime);
+
+        return this->update(deltaTime, input);
+    }
+
+    void updateScripts(float deltaTime){
         auto scriptView = entityRegistry->view<ScriptComponent>();
 
         for(auto script : scriptView){
             scriptView.get<ScriptComponent>(script).execUpdate(deltaTime);
         }
-
-
-        return this->update(deltaTime, input);
     }
 
     virtual void update(float deltaTime, Input& input) = 0;
 
     void buildRenderGraph(std::shared_ptr<VulkanRenderGraph> renderGraph){
-        /*
-        renderGraph->addRenderPass("ShadowMap", 
+        renderGraph->addRenderPass("DepthPrepass",
+            VulkanRenderGraph::DepthOnly(),
+            VulkanRenderGraph::Optional(),
+            VulkanRenderGraph::UseRenderScale(),
             VulkanRenderGraph::AddRenderFunction([&](VulkanCommandBuffer& commandBuffer){
-                this->render(commandBuffer);
+                this->renderDepthPrepass(commandBuffer);
             }),
-            VulkanRenderGraph::AddDepthBuffer(),
-            VulkanRenderGraph::SetRenderTargetOutput() // TODO
+            VulkanRenderGraph::AddComputeFunction([&](VulkanCommandBuffer& commandBuffer){
+                this->prepareObjects(commandBuffer);
+            }),
+            VulkanRenderGraph::AddDepthBuffer("SceneDepth")
         );
-        */
+
         renderGraph->addRenderPass("Main",
-            //VulkanRenderGraph::SetRenderTargetInput("ShadowMap"), 
+            VulkanRenderGraph::SetRenderTargetInput("DepthPrepass"), 
             VulkanRenderGraph::AddRenderFunction([&](VulkanCommandBuffer& commandBuffer){
                 this->render(commandBuffer);
             }),
-            VulkanRenderGraph::AddDepthBuffer()
+            VulkanRenderGraph::AddComputeFunction([&](VulkanCommandBuffer& commandBuffer){
+                this->cullOccludedObjects(commandBuffer); // needs the pre-pass depth, so Main is not merged with the pre-pass
+            }),
+            VulkanRenderGraph::AddComputeFunction([&](VulkanCommandBuffer& commandBuffer){
+                this->renderShadows(commandBuffer); // shadow maps have their own depth passes, recorded before the scene passes
+            }),
+            VulkanRenderGraph::AddComputeFunction([&](VulkanCommandBuffer& commandBuffer){
+                this->cullLights(commandBuffer);
+            }),
+            VulkanRenderGraph::AddDepthBuffer("SceneDepth"),
+            VulkanRenderGraph::AddComputeInput("SceneDepth"),
+            VulkanRenderGraph::AddColorTarget("SceneColor"),
+            VulkanRenderGraph::UseRenderScale()
+        );
+
+        renderGraph->addRenderPass("Upscale",
+            VulkanRenderGraph::SetRenderTargetInput("Main"), 
+            VulkanRenderGraph::AddSampledInput("SceneColor"),
+            VulkanRenderGraph::AddRenderFunction([&](VulkanCommandBuffer& commandBuffer){
+                if(this->dynamicResolution){
+                    this->dynamicResolution->render(commandBuffer);
+                }
+            })
         );
 /*
         renderGraph->addRenderPass("Postprocess",
-            //VulkanRenderGraph::SetRenderTargetInput("ShadowMap"), 
             VulkanRenderGraph::AddRenderFunction([&](VulkanCommandBuffer& commandBuffer){
                 this->render(commandBuffer);
             }),
@@ -212,7 +273,7 @@ public:
         if(this->gui){
 
             renderGraph->addRenderPass("UI", 
-                VulkanRenderGraph::SetRenderTargetInput("Main"), 
+                VulkanRenderGraph::SetRenderTargetInput("Upscale"), 
                 VulkanRenderGraph::SetRenderTargetOutput(),
                 VulkanRenderGraph::AddRenderFunction([&](VulkanCommandBuffer& commandBuffer){
                     this->gui->render(commandBuffer);
@@ -224,47 +285,27 @@ public:
         renderGraph->bake();
 
         this->renderGraph = renderGraph;
+        renderGraph->setNodeEnabled("DepthPrepass", depthPrepass);
         mainRenderpass = renderGraph->getRenderPass("Main");
-        gui->initVulkan(renderGraph->getRenderPass("UI"));
-    }
-
-    void render(VulkanCommandBuffer& commandBuffer){
-
-        auto materialView = entityRegistry->view<MaterialComponent>();
-
-        for(auto material : materialView){
-            if(!materialView.get<MaterialComponent>(material).getDescriptorSet().size()){
-                renderGraph->registerDescriptorSet(&materialView.get<MaterialComponent>(material));
-            }
-        }
+        gui->initVulkan(renderGraph->getActiveRenderPass("UI"), renderGraph->getActiveSubpass("UI"));
 
-        auto camera = *entityRegistry->view<TransformComponent, CameraComponent>().begin();
-
-        glm::mat4 view = entityRegistry->get<CameraComponent>(camera).getView();
-        glm::mat4 proj = glm::perspective(glm::radians(45.0f), commandBuffer.getWidth() / (float) commandBuffer.getHeight(), 0.1f, 1000.0f);
-        proj[1][1] *= -1; // TODO to camera
-
-        auto entityView = entityRegistry->view<RenderComponent, ModelComponent, MaterialComponent, TransformComponent>(entt::exclude<SkyboxRendererComponent>);
-
-        for(auto entity : entityView){
-            
-            auto transform = entityView.get<TransformComponent>(entity);
-
-            glm::mat4 model = transform.getModel();
+        renderGraph->addRenderPassChangeCallback([&](VulkanRenderGraph& renderGraph){
+            this->gui->reinitVulkan(renderGraph.getActiveRenderPass("UI"), renderGraph.getActiveSubpass("UI"));
+        });
+    }
 
-            entityView.get<MaterialComponent>(entity).setUniform("_viewPos", entityRegistry->get<TransformComponent>(camera).getPosition());
-            entityView.get<MaterialComponent>(entity).setUniform("_model", model);
-            entityView.get<MaterialComponent>(entity).setUniform("_view", view);
-            entityView.get<MaterialComponent>(entity).setUniform("_proj", proj);
+    // Opaque geometry only, the skybox is drawn at the far plane and needs no pre-pass
+    void renderDepthPrepass(VulkanCommandBuffer& commandBuffer){
+        renderOpaque(commandBuffer, VulkanGraphicsPipeline::Variant::DepthOnly);
+    }
 
-            commandBuffer
-            .bind(entityView.get<MaterialComponent>(entity).getGraphicsPipeline())
-            .bind(entityView.get<ModelComponent>(entity).getBuffers())
-            .bind(entityView.get<MaterialComponent>(entity).getDescriptorSet())
-            .setUniform(entityView.get<MaterialComponent>(entity).getUniforms());
+    void render(VulkanCommandBuffer& commandBuffer){
 
-            commandBuffer.draw(entityView.get<ModelComponent>(entity).getCount());
+        renderOpaque(commandBuffer, depthPrepass ? VulkanGraphicsPipeline::Variant::DepthEqual : VulkanGraphicsPipeline::Variant::Default);
 
+        // Objects that passed the occlusion test against the pre-pass depth are not in it, they are depth tested and written normally
+        if(gpuDrivenRendering && gpuDrivenRendering->isOcclusionCullingActive()){
+            renderOpaque(commandBuffer, VulkanGraphicsPipeline::Variant::Default, GpuDrivenRendering::Late);
         }
 
 
@@ -276,28 +317,78 @@ public:
                 renderGraph->registerDescriptorSet(&skybox->getComponent<MaterialComponent>());
             }
 
-            glm::mat4 stationaryView = glm::mat4(glm::mat3(view));  
-
-            skybox->getComponent<MaterialComponent>().setUniform("_view", stationaryView);
-            skybox->getComponent<MaterialComponent>().setUniform("_proj", proj);
-
             commandBuffer
             .bind(skybox->getComponent<MaterialComponent>().getGraphicsPipeline())
             .bind(skybox->getComponent<ModelComponent>().getBuffers())
             .bind(skybox->getComponent<MaterialComponent>().getDescriptorSet())
-            .setUniform(skybox->getComponent<MaterialComponent>().getUniforms());
+            .setUniform(skybox->getComponent<MaterialComponent>().getUniforms(), skybox->getComponent<MaterialComponent>().getUniformRanges())
+            .pushConstants(skybox->getComponent<MaterialComponent>().getPushConstants());
 
             commandBuffer.draw(skybox->getComponent<ModelComponent>().getCount());
         }
 
     }
 
+    std::shared_ptr<DynamicResolution> getDynamicResolution(){
+        return dynamicResolution;
+    }
+
+    std::shared_ptr<ClusteredLighting> getClusteredLighting(){
+        return clusteredLighting;
+    }
+
+    std::shared_ptr<ShadowMapping> getShadowMapping(){
+        return shadowMapping;
+    }
+
+    std::shared_ptr<GpuDrivenRendering> getGpuDrivenRendering(){
+        return gpuDrivenRendering;
+    }
+
+    std::shared_ptr<TextureStreaming> getTextureStreaming(){
+        return textureStreaming;
+    }
+
+    std::shared_ptr<VulkanTextureArrays> getTextureArrays(){
+        return textureArrays;
+    }
+
+    std::shared_ptr<ResourceManager> getResourceManager(){
+        return resourceManager;
+    }
+
+    bool isDepthPrepassEnabled(){
+        return depthPrepass;
+    }
+
+    // The disabled pre-pass is not recorded, Main clears the depth buffer instead
+    void setDepthPrepass(bool value){
+        depthPrepass = value;
+        if(renderGraph){
+            renderGraph->setNodeEnabled("DepthPrepass", value);
+        }
+    }
+
     void loadScene(Vulkan& context){
         resourceManager->addDependency<ShaderProgram>(mainRenderpass);
         resourceManager->addDependency<ShaderProgram>(renderGraph);
         resourceManager->addDependency<Mesh>(context.getMemoryManager());
+        textureArrays = std::make_shared<VulkanTextureArrays>(context.getMemoryManager());
         resourceManager->addDependency<Texture>(context.getMemoryManager());
+        resourceManager->addDependency<Texture>(textureArrays); // small textures are packed into shared arrays
+        resourceManager->setRetention<Mesh>(Resource::Retention::Drop); // bounds are kept by the mesh itself
+        resourceManager->setRetention<Texture>(Resource::Retention::Compressed); // finer mips are decoded again when streamed in
         resourceManager->addDependency<Script>(scriptManager);
+        context.getMemoryManager()->setEvictionHandler([resourceManager = std::weak_ptr<ResourceManager>(resourceManager)](VkDeviceSize bytes){
+            auto manager = resourceManager.lock();
+            return manager && manager->evictForAllocation(bytes);
+        });
+
+        dynamicResolution = std::make_shared<DynamicResolution>(renderGraph, resourceManager->getResource<ShaderProgram>("./shaders/upscale.glsl"), context.getDevice()->getTextureSampler(), "SceneColor");
+        clusteredLighting = std::make_shared<ClusteredLighting>(renderGraph, context.getDevice(), "./shaders/clusterLightCulling.glsl"); // before any material registers its descriptor sets
+        gpuDrivenRendering = std::make_shared<GpuDrivenRendering>(renderGraph, context.getDevice(), "./shaders/drawCulling.glsl", "./shaders/hiZDownsample.glsl", "SceneDepth");
+        shadowMapping = std::make_shared<ShadowMapping>(renderGraph, context.getSwapChain(), resourceManager->getResource<ShaderProgram>("./shaders/shadowDepth.glsl"));
+        textureStreaming = std::make_shared<TextureStreaming>();
 
         setup();
     }
@@ -317,6 +408,8 @@ public:
 
             scene["objects"].push_back({name, gameobject->saveToJson()});
         }
+
+        scene["depthPrepass"] = depthPrepass;
         
         return scene;
     }
@@ -330,6 +423,10 @@ public:
             obj->loadFromJson(gameObj);
         }
 
+        if(scene.contains("depthPrepass")){
+            setDepthPrepass(scene["depthPrepass"]);
+        }
+
         return;
     }
 
@@ -375,6 +472,171 @@ public:
 
 private:
 
+    glm::mat4 getProjection(float aspect){
+        glm::mat4 proj = glm::perspective(glm::radians(fieldOfView), aspect, nearPlane, farPlane);
+        proj[1][1] *= -1; // TODO to camera
+        return proj;
+    }
+
+    // Every drawn object requests the texture mips its size on screen needs
+    void streamTextures(){
+        if(!textureStreaming){
+            return;
+        }
+
+        auto camera = *entityRegistry->view<TransformComponent, CameraComponent>().begin();
+        VkExtent2D extent = renderGraph->getRecordedRenderExtent();
+
+        textureStreaming->beginFrame(entityRegistry->get<CameraComponent>(camera).getView(), getProjection(extent.width / (float) extent.height), extent.height, nearPlane);
+
+        auto entityView = entityRegistry->view<RenderComponent, ModelComponent, MaterialComponent, TransformComponent>();
+        for(auto entity : entityView){
+            auto& model = entityView.get<ModelComponent>(entity);
+            textureStreaming->requestObject(entityView.get<MaterialComponent>(entity).getTextures(), entityView.get<TransformComponent>(entity).getModel(), model.getBounds(), model.getUvDensity());
+        }
+
+        textureStreaming->update();
+    }
+
+    void cullLights(VulkanCommandBuffer& commandBuffer){
+        if(!clusteredLighting){
+            return;
+        }
+
+        std::vector<ClusteredLighting::Light> lights;
+
+        auto lightView = entityRegistry->view<LightSourceComponent, TransformComponent>();
+        for(auto light : lightView){
+            ClusteredLighting::Light data = lightView.get<LightSourceComponent>(light).getLightData();
+            if(shadowMapping){
+                data.spotCone.z = shadowMapping->getShadowIndex(static_cast<uint32_t>(light));
+            }
+            lights.push_back(data);
+        }
+
+        auto camera = *entityRegistry->view<TransformComponent, CameraComponent>().begin();
+        VkExtent2D extent = renderGraph->getRecordedRenderExtent();
+
+        clusteredLighting->cull(commandBuffer, lights, entityRegistry->get<CameraComponent>(camera).getView(), getProjection(extent.width / (float) extent.height), nearPlane, farPlane);
+    }
+
+    void renderShadows(VulkanCommandBuffer& commandBuffer){
+        if(!shadowMapping){
+            return;
+        }
+
+        std::vector<ShadowMapping::ShadowLight> lights;
+
+        auto lightView = entityRegistry->view<LightSourceComponent, TransformComponent>();
+        for(auto light : lightView){
+            if(lightView.get<LightSourceComponent>(light).getCastShadows()){
+                lights.push_back({static_cast<uint32_t>(light), lightView.get<LightSourceComponent>(light).getLightData()});
+            }
+        }
+
+        std::vector<ShadowMapping::Caster> casters;
+
+        // Light sources are usually drawn as a mesh around the light itself
+        auto casterView = entityRegistry->view<RenderComponent, ModelComponent, TransformComponent>(entt::exclude<SkyboxRendererComponent, LightSourceComponent>);
+        for(auto entity : casterView){
+            auto& model = casterView.get<ModelComponent>(entity);
+            casters.push_back({static_cast<uint32_t>(entity), casterView.get<TransformComponent>(entity).getModel(), model.getBounds(), model.getBuffers(), model.getCount()});
+        }
+
+        auto camera = *entityRegistry->view<TransformComponent, CameraComponent>().begin();
+        VkExtent2D extent = renderGraph->getRecordedRenderExtent();
+
+        shadowMapping->render(commandBuffer, lights, casters, entityRegistry->get<CameraComponent>(camera).getView(), getProjection(extent.width / (float) extent.height), nearPlane);
+    }
+
+    void cullOccludedObjects(VulkanCommandBuffer& commandBuffer){
+        if(gpuDrivenRendering){
+            gpuDrivenRendering->cullOccluded(commandBuffer);
+        }
+    }
+
+    // Camera of the frame, written once and read by every graphics pipeline through set 0
+    void updateFrameData(){
+        auto camera = *entityRegistry->view<TransformComponent, CameraComponent>().begin();
+        VkExtent2D extent = renderGraph->getRecordedRenderExtent();
+
+        renderGraph->setFrameData({
+            .view = entityRegistry->get<CameraComponent>(camera).getView(),
+            .proj = getProjection(extent.width / (float) extent.height),
+            .viewPos = glm::vec4(entityRegistry->get<TransformComponent>(camera).getPosition(), 1.0f),
+            .time = glm::vec4(elapsedTime, frameTime, 0.0f, 0.0f)
+        });
+    }
+
+    // Collects transforms, bounds and buckets of the drawn objects, the model matrix of every draw comes from them
+    void prepareObjects(VulkanCommandBuffer& commandBuffer){
+        updateFrameData(); // first hook of the frame
+
+        objectDraws.clear();
+
+        if(!gpuDrivenRendering){
+            return;
+        }
+
+        gpuDrivenRendering->clear();
+
+        auto entityView = entityRegistry->view<RenderComponent, ModelComponent, MaterialComponent, TransformComponent>(entt::exclude<SkyboxRendererComponent>);
+
+        for(auto entity : entityView){
+            auto& model = entityView.get<ModelComponent>(entity);
+            auto& material = entityView.get<MaterialComponent>(entity);
+
+            GpuDrivenRendering::BucketKey key = {material.getGraphicsPipeline().get(), material.getStateKey(), model.getBuffers().front().get()};
+
+            uint32_t object = gpuDrivenRendering->addObject(key, static_cast<uint32_t>(entity), entityView.get<TransformComponent>(entity).getModel(), model.getBounds(), model.getCount().second);
+            if(object < GpuDrivenRendering::maxObjects){
+                objectDraws.push_back({entity, object});
+            }
+        }
+
+        auto camera = *entityRegistry->view<TransformComponent, CameraComponent>().begin();
+        VkExtent2D extent = renderGraph->getRecordedRenderExtent();
+
+        gpuDrivenRendering->update(commandBuffer, entityRegistry->get<CameraComponent>(camera).getView(), getProjection(extent.width / (float) extent.height), depthPrepass);
+    }
+
+    void renderOpaque(VulkanCommandBuffer& commandBuffer, VulkanGraphicsPipeline::Variant variant, GpuDrivenRendering::Phase phase = GpuDrivenRendering::Early){
+
+        auto materialView = entityRegistry->view<MaterialComponent>();
+
+        for(auto material : materialView){
+            if(!materialView.get<MaterialComponent>(material).getDescriptorSet().size()){
+                renderGraph->registerDescriptorSet(&materialView.get<MaterialComponent>(material));
+            }else{
+                materialView.get<MaterialComponent>(material).refreshTextures();
+            }
+        }
+
+        auto bindObject = [&](entt::entity entity){
+            auto& material = entityRegistry->get<MaterialComponent>(entity);
+
+            commandBuffer
+            .bind(material.getGraphicsPipeline(), variant)
+            .bind(entityRegistry->get<ModelComponent>(entity).getBuffers())
+            .bind(material.getDescriptorSet())
+            .setUniform(material.getUniforms(), material.getUniformRanges())
+            .pushConstants(material.getPushConstants());
+        };
+
+        if(gpuDrivenRendering && gpuDrivenRendering->isActive()){
+            for(const auto& bucket : gpuDrivenRendering->getBuckets()){
+                bindObject(static_cast<entt::entity>(bucket.owner));
+                gpuDrivenRendering->draw(commandBuffer, bucket, phase);
+            }
+
+            return;
+        }
+
+        for(auto [entity, object] : objectDraws){
+            bindObject(entity);
+            commandBuffer.draw(entityRegistry->get<ModelComponent>(entity).getCount(), object);
+        }
+    }
 
 };
 
@@ -401,6 +663,7 @@ public:
             glm::vec3(0.5f, 0.5f, 0.5f)
         );
         lightSrc->addComponent<ScriptComponent>(resourceManager->getResource<Script>("./scripts/circle.py"));
+        lightSrc->addComponent<LightSourceComponent>().setIntensity(5.0f);
         //script.getScript("Circle")->setProperty<glm::vec3>("offset", {0.0f, 5.0f, 0.0f});
 
         /*
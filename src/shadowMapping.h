@@ -0,0 +1,608 @@
+#pragma once
+
+#include "vulkan/vulkanCore.h"
+#include "resources/shaderProgram.h"
+#include "clusteredLighting.h"
+
+#include "imgui.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <map>
+#include <unordered_map>
+#include <cmath>
+#include <algorithm>
+
+namespace MSIVulkanDemo{
+
+
+// Renders cascaded shadow maps of the first directional light and cube shadow maps (6 layers each) of the point lights nearest to the camera.
+// Every shadow view keeps a static layer with the casters that did not move for a while, it is only re-rendered when one of them or the view changes,
+// moving casters are drawn each frame on top of a copy of it. Shaders sample the result through shaders/include/shadows.glsl
+class ShadowMapping{
+public:
+    struct Caster{
+        uint32_t id;
+        glm::mat4 model;
+        std::pair<glm::vec3, glm::vec3> bounds; // local space
+        std::vector<std::shared_ptr<VulkanBufferI>> buffers;
+        std::pair<uint32_t, uint32_t> count;
+    };
+
+    struct ShadowLight{
+        uint32_t id;
+        ClusteredLighting::Light light;
+    };
+
+    struct stats{
+        uint32_t activeViews = 0;
+        uint32_t cachedViews = 0; // nothing recorded
+        uint32_t compositedViews = 0; // static layer reused, dynamic casters drawn over it
+        uint32_t staticRenders = 0;
+        uint32_t staticCasters = 0;
+        uint32_t dynamicCasters = 0;
+        uint32_t draws = 0;
+    };
+
+    static constexpr uint32_t cascadeCount = 4; // SHADOW_CASCADES in the shader
+    static constexpr uint32_t maxPointShadows = 4; // MAX_POINT_SHADOWS in the shader
+
+private:
+    // std430 layout of ShadowBuffer in shadows.glsl
+    struct header{
+        glm::vec4 cascadeSplits;
+        glm::vec4 params;
+        glm::mat4 cascadeViewProj[cascadeCount];
+        glm::mat4 pointViewProj[maxPointShadows * 6];
+    };
+
+    struct ShadowView{
+        glm::mat4 viewProj = glm::mat4(1.0f);
+        glm::mat4 cachedViewProj = glm::mat4(0.0f); // the static layer was rendered with
+        bool staticValid = false;
+        bool hasDynamic = false; // final layer contains dynamic casters that have to be erased
+        bool active = false;
+    };
+
+    // Final layers are sampled, static layers only hold the cached casters and are copied into them
+    struct ShadowLayers{
+        VkExtent2D extent;
+        std::shared_ptr<VulkanImage> image;
+        std::shared_ptr<VulkanImage> staticImage;
+        std::shared_ptr<VulkanImageView> sampledView;
+        std::vector<std::shared_ptr<VulkanFramebuffer>> framebuffers;
+        std::vector<std::shared_ptr<VulkanFramebuffer>> staticFramebuffers;
+        std::vector<ShadowView> views;
+    };
+
+    struct CasterState{
+        glm::mat4 model;
+        const void* mesh;
+        std::pair<glm::vec3, glm::vec3> bounds; // world space
+        uint32_t unchangedFrames = 0;
+        bool isStatic = false;
+        bool seen = false;
+    };
+
+    struct visibleCaster{
+        const Caster* caster;
+        std::pair<glm::vec3, glm::vec3> bounds;
+        bool isStatic;
+    };
+
+    const uint32_t cascadeSize = 2048;
+    const uint32_t cubeSize = 512;
+    const uint32_t staticAfterFrames = 30; // casters unchanged for this long are moved to the static layer
+    const float casterDistance = 50.0f; // casters this far in front of a cascade along the light still cast into it
+    const float splitLambda = 0.75f; // blend of logarithmic and linear cascade splits
+
+    std::shared_ptr<VulkanRenderGraph> renderGraph;
+    std::shared_ptr<ShaderProgram> shaderProgram;
+    std::shared_ptr<VulkanTextureSampler> sampler;
+
+    std::shared_ptr<VulkanRenderPass> staticPass;
+    std::shared_ptr<VulkanRenderPass> dynamicPass;
+
+    ShadowLayers cascadeLayers;
+    ShadowLayers pointLayers;
+
+    std::vector<std::shared_ptr<VulkanStorageBuffer>> headerBuffers;
+
+    std::unordered_map<uint32_t, CasterState> casterStates;
+    std::map<uint32_t, uint32_t> pointSlots; // light id, slot
+    std::map<uint32_t, int32_t> shadowIndices; // light id, index written to Light.spotCone.z
+
+    bool caching = true;
+    float normalOffset = 0.02f;
+    float shadowDistance = 100.0f;
+
+    stats frameStats;
+    uint64_t totalViews = 0;
+    uint64_t totalHits = 0;
+
+public:
+    ShadowMapping(std::shared_ptr<VulkanRenderGraph> renderGraph, std::shared_ptr<VulkanSwapChainI> swapChain, std::shared_ptr<ShaderProgram> shaderProgram): renderGraph(renderGraph), shaderProgram(shaderProgram){
+
+        auto device = swapChain->getDevice();
+
+        VkFormat depthFormat = device->getPhysicalDevice().findSupportedFormat({VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM}, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+        // Static layers are cleared and left ready to be copied from, final layers continue from the copy and are left ready to be sampled
+        staticPass = createPass(swapChain, depthFormat, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        dynamicPass = createPass(swapChain, depthFormat, VK_ATTACHMENT_LOAD_OP_LOAD, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        cascadeLayers = createLayers(device, depthFormat, cascadeSize, cascadeCount);
+        pointLayers = createLayers(device, depthFormat, cubeSize, maxPointShadows * 6);
+
+        sampler = device->getTextureSampler(VulkanSamplerDescription::comparison(VK_COMPARE_OP_LESS_OR_EQUAL));
+
+        std::vector<std::shared_ptr<VulkanBuffer>> headerGlobals;
+
+        for(uint32_t i = 0; i < renderGraph->getFramesInFlight(); i++){
+            auto headerBuffer = device->getMemoryManager()->createBuffer<VulkanStorageBuffer>(sizeof(header));
+
+            headerBuffers.push_back(headerBuffer);
+            headerGlobals.push_back(headerBuffer);
+        }
+
+        renderGraph->setGlobalBuffer("_shadows", headerGlobals);
+        renderGraph->setGlobalTexture("_shadowCascades", cascadeLayers.sampledView, *sampler);
+        renderGraph->setGlobalTexture("_shadowCubes", pointLayers.sampledView, *sampler);
+    }
+
+    ~ShadowMapping(){}
+
+    // Recorded outside of render passes before the passes sampling the shadow maps, projection has to be the one of the main camera
+    void render(VulkanCommandBuffer& commandBuffer, std::vector<ShadowLight> lights, std::vector<Caster> casters, glm::mat4 cameraView, glm::mat4 cameraProj, float nearPlane){
+
+        uint64_t frame = renderGraph->getRecordedFrame();
+
+        frameStats = {};
+
+        std::vector<std::pair<glm::vec3, glm::vec3>> staticChanges;
+        std::vector<visibleCaster> visible = updateCasters(casters, staticChanges);
+
+        header head = assignViews(lights, cameraView, cameraProj, nearPlane);
+        headerBuffers[frame]->uploadData(0, &head, sizeof(header));
+
+        struct viewWork{
+            ShadowLayers* layers;
+            uint32_t layer;
+            bool renderStatic;
+            std::vector<const Caster*> staticCasters;
+            std::vector<const Caster*> dynamicCasters;
+        };
+
+        std::vector<viewWork> work;
+
+        for(ShadowLayers* layers : {&cascadeLayers, &pointLayers}){
+            for(uint32_t i = 0; i < layers->views.size(); i++){
+                ShadowView& view = layers->views[i];
+
+                if(!view.active){
+                    continue;
+                }
+
+                auto planes = frustumPlanes(view.viewProj);
+
+                bool staticDirty = !caching || !view.staticValid || view.cachedViewProj != view.viewProj || std::any_of(staticChanges.begin(), staticChanges.end(), [&](auto& bounds){
+                    return intersects(planes, bounds);
+                });
+
+                viewWork viewWork = {layers, i, staticDirty};
+
+                for(const auto& caster : visible){
+                    if(!intersects(planes, caster.bounds)){
+                        continue;
+                    }
+
+                    if(!caster.isStatic){
+                        viewWork.dynamicCasters.push_back(caster.caster);
+                    }else if(staticDirty){
+                        viewWork.staticCasters.push_back(caster.caster);
+                    }
+                }
+
+                frameStats.activeViews++;
+                totalViews++;
+
+                if(!staticDirty){
+                    totalHits++;
+                }
+
+                if(!staticDirty && viewWork.dynamicCasters.empty() && !view.hasDynamic){
+                    frameStats.cachedViews++;
+                    continue;
+                }
+
+                if(!staticDirty){
+                    frameStats.compositedViews++;
+                }
+
+                work.push_back(std::move(viewWork));
+            }
+        }
+
+        for(auto& viewWork : work){
+            if(!viewWork.renderStatic){
+                continue;
+            }
+
+            ShadowView& view = viewWork.layers->views[viewWork.layer];
+
+            renderView(commandBuffer, viewWork.layers->staticFramebuffers[viewWork.layer], view.viewProj, viewWork.staticCasters);
+
+            view.cachedViewProj = view.viewProj;
+            view.staticValid = true;
+            frameStats.staticRenders++;
+        }
+
+        std::vector<VkImageMemoryBarrier> barriers;
+
+        for(auto& viewWork : work){
+            barriers.push_back(layerBarrier(*viewWork.layers->staticImage, viewWork.layer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT));
+            barriers.push_back(layerBarrier(*viewWork.layers->image, viewWork.layer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT));
+        }
+
+        commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        for(auto& viewWork : work){
+            VkImageCopy region{};
+            region.srcSubresource = {viewWork.layers->image->getAspectMask(), 0, viewWork.layer, 1};
+            region.dstSubresource = {viewWork.layers->image->getAspectMask(), 0, viewWork.layer, 1};
+            region.extent = {viewWork.layers->extent.width, viewWork.layers->extent.height, 1};
+
+            commandBuffer.copyImage(*viewWork.layers->staticImage, *viewWork.layers->image, region);
+        }
+
+        barriers.clear();
+
+        for(auto& viewWork : work){
+            ShadowView& view = viewWork.layers->views[viewWork.layer];
+
+            renderView(commandBuffer, viewWork.layers->framebuffers[viewWork.layer], view.viewProj, viewWork.dynamicCasters);
+
+            view.hasDynamic = !viewWork.dynamicCasters.empty();
+
+            barriers.push_back(layerBarrier(*viewWork.layers->image, viewWork.layer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+        }
+
+        commandBuffer.setBarrier(barriers, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+
+    // Value for Light.spotCone.z, negative when the light has no shadow map this frame
+    int32_t getShadowIndex(uint32_t lightId){
+        if(auto it = shadowIndices.find(lightId); it != shadowIndices.end()){
+            return it->second;
+        }
+        return -1;
+    }
+
+    stats getStats(){
+        return frameStats;
+    }
+
+    void guiMenu(){
+        ImGui::SeparatorText("Shadows");
+
+        ImGui::Checkbox("Static caster caching", &caching);
+        ImGui::SliderFloat("Normal offset", &normalOffset, 0.0f, 0.1f);
+        ImGui::SliderFloat("Cascade distance", &shadowDistance, 10.0f, 500.0f);
+
+        ImGui::Text("Views: %u (cached %u, composited %u, static re-rendered %u)", frameStats.activeViews, frameStats.cachedViews, frameStats.compositedViews, frameStats.staticRenders);
+        ImGui::Text("Casters: %u static, %u dynamic, %u draws", frameStats.staticCasters, frameStats.dynamicCasters, frameStats.draws);
+
+        ImGui::Text("Static cache hit rate: %.1f%% of %llu views", totalViews > 0 ? 100.0 * totalHits / totalViews : 0.0, totalViews);
+        ImGui::SameLine();
+        if(ImGui::SmallButton("Reset##shadowStats")){
+            totalViews = 0;
+            totalHits = 0;
+        }
+    }
+
+    std::shared_ptr<VulkanGraphicsPipeline> getGraphicsPipeline(){
+        return shaderProgram->getGraphicsPipeline();
+    }
+
+private:
+
+    std::shared_ptr<VulkanRenderPass> createPass(std::shared_ptr<VulkanSwapChainI> swapChain, VkFormat depthFormat, VkAttachmentLoadOp loadOp, VkImageLayout initialLayout, VkImageLayout finalLayout){
+        auto pass = std::shared_ptr<VulkanRenderPass>(new VulkanRenderPass(swapChain));
+
+        pass->removeAttachment("Color");
+        pass->addAttachment("Depth", depthFormat, VK_SAMPLE_COUNT_1_BIT, loadOp, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, initialLayout, finalLayout, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+        pass->addDependencyMask(VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+        pass->setExternalFramebuffers(true);
+        pass->bake();
+
+        return pass;
+    }
+
+    ShadowLayers createLayers(std::shared_ptr<VulkanDeviceI> device, VkFormat depthFormat, uint32_t size, uint32_t count){
+        ShadowLayers layers;
+        layers.extent = {size, size};
+
+        layers.image = device->getMemoryManager()->createImage<VulkanImage>(std::pair<uint32_t, uint32_t>(size, size), VulkanImage::constructParameters{
+            .layers = count,
+            .format = depthFormat,
+            .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
+        });
+
+        layers.staticImage = device->getMemoryManager()->createImage<VulkanImage>(std::pair<uint32_t, uint32_t>(size, size), VulkanImage::constructParameters{
+            .layers = count,
+            .format = depthFormat,
+            .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+        });
+
+        // Bound to every material before any light casts into it
+        layers.image->transitionImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        layers.sampledView = layers.image->createImageView(layers.image->getAspectMask(), VK_IMAGE_VIEW_TYPE_2D_ARRAY, count);
+
+        for(uint32_t i = 0; i < count; i++){
+            layers.framebuffers.push_back(std::shared_ptr<VulkanFramebuffer>(new VulkanFramebuffer(dynamicPass, {layers.image->createImageView(layers.image->getAspectMask(), VK_IMAGE_VIEW_TYPE_2D, 1, i)}, layers.extent)));
+            layers.staticFramebuffers.push_back(std::shared_ptr<VulkanFramebuffer>(new VulkanFramebuffer(staticPass, {layers.staticImage->createImageView(layers.staticImage->getAspectMask(), VK_IMAGE_VIEW_TYPE_2D, 1, i)}, layers.extent)));
+        }
+
+        layers.views.resize(count);
+
+        return layers;
+    }
+
+    // Casters are static once their transform and mesh stayed the same for staticAfterFrames, bounds of static casters that appeared, moved or disappeared are collected in staticChanges
+    std::vector<visibleCaster> updateCasters(const std::vector<Caster>& casters, std::vector<std::pair<glm::vec3, glm::vec3>>& staticChanges){
+        std::vector<visibleCaster> visible;
+
+        for(auto& [id, state] : casterStates){
+            state.seen = false;
+        }
+
+        for(const auto& caster : casters){
+            auto bounds = worldBounds(caster.model, caster.bounds);
+            const void* mesh = caster.buffers.empty() ? nullptr : caster.buffers.front().get();
+
+            auto [it, inserted] = casterStates.try_emplace(caster.id);
+            CasterState& state = it->second;
+
+            if(!inserted && (state.model != caster.model || state.mesh != mesh)){
+                if(state.isStatic){
+                    staticChanges.push_back(state.bounds);
+                }
+                state.isStatic = false;
+                state.unchangedFrames = 0;
+            }else if(!inserted && !state.isStatic && ++state.unchangedFrames >= staticAfterFrames){
+                state.isStatic = true;
+                staticChanges.push_back(bounds);
+            }
+
+            state.model = caster.model;
+            state.mesh = mesh;
+            state.bounds = bounds;
+            state.seen = true;
+
+            visible.push_back({&caster, bounds, state.isStatic});
+
+            if(state.isStatic){
+                frameStats.staticCasters++;
+            }else{
+                frameStats.dynamicCasters++;
+            }
+        }
+
+        std::erase_if(casterStates, [&](const auto& entry){
+            if(!entry.second.seen && entry.second.isStatic){
+                staticChanges.push_back(entry.second.bounds);
+            }
+            return !entry.second.seen;
+        });
+
+        return visible;
+    }
+
+    // Cascades for the first directional light, the nearest point lights keep their slots while they stay selected, so their cached layers stay valid
+    header assignViews(const std::vector<ShadowLight>& lights, glm::mat4 cameraView, glm::mat4 cameraProj, float nearPlane){
+        header head{};
+        head.params = {0.0f, normalOffset, 0.0f, 0.0f};
+
+        shadowIndices.clear();
+
+        for(auto& view : cascadeLayers.views){
+            view.active = false;
+        }
+        for(auto& view : pointLayers.views){
+            view.active = false;
+        }
+
+        for(const auto& light : lights){
+            if(static_cast<ClusteredLighting::LightType>(light.light.directionType.w) != ClusteredLighting::Directional){
+                continue;
+            }
+
+            updateCascades(head, glm::normalize(glm::vec3(light.light.directionType)), cameraView, cameraProj, nearPlane);
+            head.params.x = cascadeCount;
+            shadowIndices[light.id] = 0;
+            break;
+        }
+
+        glm::vec3 cameraPosition = glm::vec3(glm::inverse(cameraView)[3]);
+
+        std::vector<const ShadowLight*> points;
+        for(const auto& light : lights){
+            if(static_cast<ClusteredLighting::LightType>(light.light.directionType.w) == ClusteredLighting::Point){
+                points.push_back(&light);
+            }
+        }
+
+        std::sort(points.begin(), points.end(), [&](auto a, auto b){
+            return glm::distance(glm::vec3(a->light.positionRange), cameraPosition) < glm::distance(glm::vec3(b->light.positionRange), cameraPosition);
+        });
+        points.resize(std::min<size_t>(points.size(), maxPointShadows));
+
+        std::erase_if(pointSlots, [&](const auto& entry){
+            return std::none_of(points.begin(), points.end(), [&](auto light){ return light->id == entry.first; });
+        });
+
+        for(auto light : points){
+            if(!pointSlots.contains(light->id)){
+                for(uint32_t slot = 0; slot < maxPointShadows; slot++){
+                    if(std::none_of(pointSlots.begin(), pointSlots.end(), [&](const auto& entry){ return entry.second == slot; })){
+                        pointSlots[light->id] = slot;
+                        break;
+                    }
+                }
+            }
+
+            uint32_t slot = pointSlots.at(light->id);
+            updateCube(head, slot, glm::vec3(light->light.positionRange), light->light.positionRange.w);
+            shadowIndices[light->id] = slot;
+        }
+
+        return head;
+    }
+
+    // Each cascade covers the bounding sphere of its slice of the camera frustum, snapped to whole texels, so it does not shimmer and stays cached while the camera is still
+    void updateCascades(header& head, glm::vec3 lightDirection, glm::mat4 cameraView, glm::mat4 cameraProj, float nearPlane){
+        float tanHalfFov = 1.0f / std::abs(cameraProj[1][1]);
+        float aspect = std::abs(cameraProj[1][1] / cameraProj[0][0]);
+        glm::mat4 invView = glm::inverse(cameraView);
+
+        glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+        float splitNear = nearPlane;
+
+        for(uint32_t i = 0; i < cascadeCount; i++){
+            float t = (i + 1) / (float) cascadeCount;
+            float splitFar = glm::mix(nearPlane + (shadowDistance - nearPlane) * t, nearPlane * std::pow(shadowDistance / nearPlane, t), splitLambda);
+
+            std::array<glm::vec3, 8> corners;
+            glm::vec3 center(0.0f);
+
+            for(uint32_t k = 0; k < 8; k++){
+                float depth = (k & 4) ? splitFar : splitNear;
+                glm::vec4 corner = glm::vec4(((k & 1) ? 1.0f : -1.0f) * depth * tanHalfFov * aspect, ((k & 2) ? 1.0f : -1.0f) * depth * tanHalfFov, -depth, 1.0f);
+                corners[k] = glm::vec3(invView * corner);
+                center += corners[k] / 8.0f;
+            }
+
+            float radius = 0.0f;
+            for(const auto& corner : corners){
+                radius = std::max(radius, glm::distance(corner, center));
+            }
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+
+            glm::mat4 lightView = glm::lookAt(center - lightDirection * (radius + casterDistance), center, up);
+            glm::mat4 lightProj = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + casterDistance);
+
+            glm::vec4 origin = lightProj * lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) * (cascadeSize / 2.0f);
+            glm::vec4 offset = (glm::round(origin) - origin) * (2.0f / cascadeSize);
+            lightProj[3][0] += offset.x;
+            lightProj[3][1] += offset.y;
+
+            ShadowView& view = cascadeLayers.views[i];
+            view.viewProj = lightProj * lightView;
+            view.active = true;
+
+            head.cascadeViewProj[i] = view.viewProj;
+            head.cascadeSplits[i] = splitFar;
+
+            splitNear = splitFar;
+        }
+    }
+
+    // Faces in +X, -X, +Y, -Y, +Z, -Z order, the shader picks one by the major axis of the direction from the light
+    void updateCube(header& head, uint32_t slot, glm::vec3 position, float range){
+        const std::array<glm::vec3, 6> directions = {glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)};
+        const std::array<glm::vec3, 6> ups = {glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)};
+
+        glm::mat4 proj = glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, std::max(range, 0.1f));
+
+        for(uint32_t face = 0; face < 6; face++){
+            ShadowView& view = pointLayers.views[slot * 6 + face];
+            view.viewProj = proj * glm::lookAt(position, position + directions[face], ups[face]);
+            view.active = true;
+
+            head.pointViewProj[slot * 6 + face] = view.viewProj;
+        }
+    }
+
+    void renderView(VulkanCommandBuffer& commandBuffer, std::shared_ptr<VulkanFramebuffer> framebuffer, glm::mat4 viewProj, const std::vector<const Caster*>& casters){
+        commandBuffer.beginRenderPass(framebuffer);
+
+        if(!casters.empty()){
+            commandBuffer.bind(getGraphicsPipeline(), VulkanGraphicsPipeline::Variant::Shadow);
+
+            size_t matrixOffset = getGraphicsPipeline()->getPushConstantData().getOffset("_viewProjModel");
+
+            for(auto caster : casters){
+                commandBuffer
+                .bind(caster->buffers)
+                .pushConstants(std::pair<size_t, glm::mat4>{matrixOffset, viewProj * caster->model})
+                .draw(caster->count);
+
+                frameStats.draws++;
+            }
+        }
+
+        commandBuffer.endRenderPass();
+    }
+
+    VkImageMemoryBarrier layerBarrier(VulkanImage& image, uint32_t layer, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess){
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {image.getAspectMask(), 0, 1, layer, 1};
+
+        return barrier;
+    }
+
+    static std::pair<glm::vec3, glm::vec3> worldBounds(glm::mat4 model, std::pair<glm::vec3, glm::vec3> bounds){
+        glm::vec3 center = (bounds.first + bounds.second) * 0.5f;
+        glm::vec3 extent = (bounds.second - bounds.first) * 0.5f;
+
+        glm::mat3 absolute = glm::mat3(model);
+        for(uint32_t i = 0; i < 3; i++){
+            absolute[i] = glm::abs(absolute[i]);
+        }
+
+        glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+        glm::vec3 worldExtent = absolute * extent;
+
+        return {worldCenter - worldExtent, worldCenter + worldExtent};
+    }
+
+    // Left, right, bottom, top, near, far planes of a [0, 1] depth projection, pointing inside
+    static std::array<glm::vec4, 6> frustumPlanes(glm::mat4 viewProj){
+        glm::mat4 rows = glm::transpose(viewProj);
+
+        return {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2]};
+    }
+
+    static bool intersects(const std::array<glm::vec4, 6>& planes, const std::pair<glm::vec3, glm::vec3>& bounds){
+        for(const auto& plane : planes){
+            glm::vec3 positive = glm::vec3(
+                plane.x >= 0.0f ? bounds.second.x : bounds.first.x,
+                plane.y >= 0.0f ? bounds.second.y : bounds.first.y,
+                plane.z >= 0.0f ? bounds.second.z : bounds.first.z
+            );
+
+            if(glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f){
+                return false;
+            }
+        }
+        return true;
+    }
+
+};
+
+
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include "resources/texture.h"
+
+#include "imgui.h"
+
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <future>
+#include <cmath>
+#include <algorithm>
+#include <array>
+
+namespace MSIVulkanDemo{
+
+
+// Streams the mip levels of 2D textures by on-screen usage. Textures start with their smallest mips, every frame the drawn objects
+// request the finest level they can show from their screen size and UV density, the levels are decoded on another thread
+// and replace the GPU copy once ready. Finer levels are dropped again when no longer needed or over the budget,
+// the coarser ones are copied on the GPU
+class TextureStreaming{
+public:
+    struct streamingStats{
+        uint32_t textures = 0;
+        uint32_t pending = 0;
+        uint32_t residentLevels = 0;
+        uint32_t wantedLevels = 0;
+        VkDeviceSize residentBytes = 0;
+        uint64_t streamedIn = 0;
+        uint64_t streamedOut = 0;
+    };
+
+private:
+    struct streamState{
+        std::weak_ptr<Texture> texture;
+        uint32_t wantedMip = 0;
+        bool requested = false; // this frame
+        uint32_t framesCoarser = 0;
+        std::future<std::shared_ptr<VulkanImageData>> pending;
+        uint32_t pendingMip = 0;
+    };
+
+    std::map<Texture*, streamState> textures;
+
+    bool enabled = true;
+    VkDeviceSize budget = 256ull * 1024 * 1024;
+    uint32_t maxPending = 2; // decode jobs at once
+    uint32_t streamOutDelay = 120; // frames a coarser level has to be enough before finer ones are dropped
+    float mipBias = 0.0f;
+
+    std::array<glm::vec4, 6> frustum;
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float pixelsAtUnitDistance = 1.0f;
+    float nearPlane = 0.1f;
+
+    streamingStats stats;
+
+public:
+    TextureStreaming(){
+
+    }
+
+    ~TextureStreaming(){}
+
+    void beginFrame(glm::mat4 view, glm::mat4 proj, uint32_t viewportHeight, float nearPlane){
+        glm::mat4 rows = glm::transpose(proj * view);
+        frustum = {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2]};
+        for(auto& plane : frustum){
+            plane /= glm::length(glm::vec3(plane));
+        }
+
+        cameraPosition = glm::vec3(glm::inverse(view)[3]);
+        pixelsAtUnitDistance = 0.5f * viewportHeight * std::abs(proj[1][1]);
+        this->nearPlane = nearPlane;
+    }
+
+    // Textures of a drawn object, objects outside of the view request nothing
+    void requestObject(const std::map<std::string, std::shared_ptr<Texture>>& objectTextures, glm::mat4 model, std::pair<glm::vec3, glm::vec3> bounds, float uvDensity){
+        float scale = std::max({glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))});
+        glm::vec3 center = glm::vec3(model * glm::vec4((bounds.first + bounds.second) * 0.5f, 1.0f));
+        float radius = glm::length(bounds.second - bounds.first) * 0.5f * scale;
+
+        for(const auto& plane : frustum){
+            if(glm::dot(glm::vec3(plane), center) + plane.w < -radius){
+                return;
+            }
+        }
+
+        float distance = std::max(glm::length(center - cameraPosition) - radius, nearPlane);
+        float pixelsPerUnit = pixelsAtUnitDistance * scale / distance; // on-screen size of one local space unit
+
+        for(const auto& [name, texture] : objectTextures){
+            request(texture, pixelsPerUnit, uvDensity);
+        }
+    }
+
+    // After every object requested its textures
+    void update(){
+        std::erase_if(textures, [](auto& kv){
+            return kv.second.texture.expired();
+        });
+
+        uint32_t pending = 0;
+
+        for(auto& [ptr, state] : textures){
+            std::shared_ptr<Texture> texture = state.texture.lock();
+
+            if(!enabled){
+                state.wantedMip = 0;
+            }else if(!state.requested){
+                state.wantedMip = texture->getStreamingMinMip();
+            }
+            state.requested = false;
+
+            if(state.pending.valid() && state.pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready){
+                try{
+                    texture->setResidentMips(state.pending.get(), state.pendingMip);
+                }catch(std::exception& e){
+                    std::cout << "Texture streaming failed: " << e.what() << std::endl;
+                }
+            }
+
+            pending += state.pending.valid() ? 1 : 0;
+        }
+
+        if(enabled){
+            fitBudget();
+        }
+
+        stats = {.streamedIn = stats.streamedIn, .streamedOut = stats.streamedOut};
+
+        for(auto& [ptr, state] : textures){
+            std::shared_ptr<Texture> texture = state.texture.lock();
+            uint32_t residentMip = texture->getResidentMip();
+
+            state.framesCoarser = state.wantedMip > residentMip ? state.framesCoarser + 1 : 0;
+
+            bool streamIn = state.wantedMip < residentMip;
+            bool streamOut = state.wantedMip > residentMip && state.framesCoarser >= streamOutDelay;
+
+            if(!state.pending.valid() && streamIn && pending < maxPending){
+                state.pending = texture->loadMips(state.wantedMip);
+                state.pendingMip = state.wantedMip;
+                pending++;
+
+                stats.streamedIn++;
+            }else if(!state.pending.valid() && streamOut){
+                try{
+                    texture->dropMips(state.wantedMip);
+                    residentMip = texture->getResidentMip();
+                    stats.streamedOut++;
+                }catch(std::exception& e){
+                    std::cout << "Texture streaming failed: " << e.what() << std::endl;
+                }
+            }
+
+            stats.textures++;
+            stats.pending += state.pending.valid() ? 1 : 0;
+            stats.residentLevels += texture->getMipLevels() - residentMip;
+            stats.wantedLevels += texture->getMipLevels() - state.wantedMip;
+            stats.residentBytes += texture->getMipBytes(residentMip);
+        }
+    }
+
+    const streamingStats& getStats(){
+        return stats;
+    }
+
+    void guiMenu(){
+        ImGui::SeparatorText("Texture streaming");
+
+        ImGui::Checkbox("Stream mips", &enabled);
+
+        int budgetMiB = static_cast<int>(budget / (1024 * 1024));
+        if(ImGui::SliderInt("Streaming budget (MiB)", &budgetMiB, 16, 4096)){
+            budget = static_cast<VkDeviceSize>(budgetMiB) * 1024 * 1024;
+        }
+        ImGui::SliderFloat("Mip bias", &mipBias, -2.0f, 4.0f, "%.1f");
+
+        ImGui::Text("Textures: %u, pending: %u", stats.textures, stats.pending);
+        ImGui::Text("Mip levels resident: %u, wanted: %u", stats.residentLevels, stats.wantedLevels);
+        ImGui::Text("Resident: %.1f / %.1f MiB", stats.residentBytes / (1024.0f * 1024.0f), budget / (1024.0f * 1024.0f));
+        ImGui::Text("Streamed in: %llu, out: %llu", static_cast<unsigned long long>(stats.streamedIn), static_cast<unsigned long long>(stats.streamedOut));
+    }
+
+private:
+    void request(std::shared_ptr<Texture> texture, float pixelsPerUnit, float uvDensity){
+        if(!texture->isStreamable()){
+            return;
+        }
+
+        streamState& state = getState(texture);
+
+        auto [width, height] = texture->getResolution();
+        float texelsPerUnit = std::max(width, height) * uvDensity;
+        float mip = std::log2(std::max(texelsPerUnit, 1.0f) / std::max(pixelsPerUnit, 1e-3f)) + mipBias;
+        uint32_t wantedMip = static_cast<uint32_t>(std::clamp(mip, 0.0f, static_cast<float>(texture->getStreamingMinMip())));
+
+        state.wantedMip = state.requested ? std::min(state.wantedMip, wantedMip) : wantedMip;
+        state.requested = true;
+    }
+
+    streamState& getState(std::shared_ptr<Texture> texture){
+        streamState& state = textures[texture.get()];
+
+        if(state.texture.expired()){
+            state = streamState();
+            state.texture = texture;
+        }
+
+        return state;
+    }
+
+    // Drops the finest wanted level of the texture costing the most until the wanted levels fit
+    void fitBudget(){
+        VkDeviceSize total = 0;
+        for(auto& [ptr, state] : textures){
+            total += state.texture.lock()->getMipBytes(state.wantedMip);
+        }
+
+        while(total > budget){
+            streamState* largest = nullptr;
+            VkDeviceSize largestBytes = 0;
+
+            for(auto& [ptr, state] : textures){
+                std::shared_ptr<Texture> texture = state.texture.lock();
+                VkDeviceSize bytes = texture->getMipBytes(state.wantedMip);
+
+                if(state.wantedMip < texture->getStreamingMinMip() && bytes > largestBytes){
+                    largest = &state;
+                    largestBytes = bytes;
+                }
+            }
+
+            if(!largest){
+                break;
+            }
+
+            largest->wantedMip++;
+            total -= largestBytes - largest->texture.lock()->getMipBytes(largest->wantedMip);
+        }
+    }
+
+};
+
+
+}
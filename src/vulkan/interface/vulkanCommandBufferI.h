@@ -13,6 +13,7 @@ public:
     virtual VulkanCommandBufferI& begin(VkCommandBufferUsageFlags) = 0;
     virtual VulkanCommandBufferI& copyBuffer(VulkanBufferI& src, VulkanBufferI& dst, VkDeviceSize size) = 0;
     virtual VulkanCommandBufferI& copyBufferToImage(VulkanBufferI& src, VulkanImageI& dst, VkBufferImageCopy& region) = 0;
+    virtual VulkanCommandBufferI& copyImage(VulkanImageI& src, VulkanImageI& dst, VkImageCopy& region) = 0;
     virtual VulkanCommandBuffer& setBarrier(VkImageMemoryBarrier& barrier, VkPipelineStageFlags srcStage = 0, VkPipelineStageFlags dstStage = 0) = 0;
     virtual VulkanCommandBufferI& end() = 0;
     virtual VulkanCommandBufferI& submit() = 0;
@@ -8,6 +8,9 @@ class VulkanDescriptorPool;
 class VulkanSemaphore;
 class VulkanFence;
 class VulkanTextureSampler;
+struct VulkanSamplerDescription;
+class VulkanQueryPool;
+class VulkanBindlessTextures;
 
 class VulkanDeviceI{
 public:
@@ -22,8 +25,15 @@ public:
     virtual std::shared_ptr<VulkanMemoryManager> getMemoryManager() = 0;
     virtual std::shared_ptr<VulkanSemaphore> createSemaphore() = 0;
     virtual std::shared_ptr<VulkanFence> createFence(bool = false) = 0;
-    virtual std::shared_ptr<VulkanTextureSampler> createTextureSampler() = 0;
+    virtual std::shared_ptr<VulkanTextureSampler> getTextureSampler() = 0;
+    virtual std::shared_ptr<VulkanTextureSampler> getTextureSampler(const VulkanSamplerDescription&) = 0;
+    virtual size_t getTextureSamplerCount() = 0;
     virtual std::shared_ptr<VulkanDescriptorPool> createDescriptorPool(std::vector<std::pair<VkDescriptorType, uint32_t>> = {}) = 0;
+    virtual std::shared_ptr<VulkanQueryPool> createQueryPool(VkQueryType, uint32_t, VkQueryPipelineStatisticFlags = 0) = 0;
+    virtual std::shared_ptr<VulkanBindlessTextures> getBindlessTextures() = 0;
+    virtual const VkPhysicalDeviceFeatures& getEnabledFeatures() = 0;
+    virtual bool isExtensionEnabled(std::string) = 0;
+    virtual PFN_vkCmdDrawIndexedIndirectCountKHR getDrawIndexedIndirectCount() = 0;
 };
 
 };
\ No newline at end of file
@@ -16,6 +16,7 @@ public:
     virtual std::shared_ptr<VulkanDeviceI> getDevice() = 0;
     virtual std::shared_ptr<VulkanSwapChainI> getSwapChain() = 0;
     virtual void recreateFramebuffers(VulkanSwapChainI&) = 0;
+    virtual std::vector<VkClearValue> getClearValues() = 0;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,164 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "interface/vulkanDeviceI.h"
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <deque>
+
+namespace MSIVulkanDemo{
+
+
+// Global update-after-bind table of every loaded texture (shaders/include/bindless.glsl), bound as set 2 after the frame and material sets,
+// shaders pick textures by the index passed in uniform data so changing a material's texture needs no descriptor writes
+class VulkanBindlessTextures{
+public:
+    static constexpr uint32_t set = 2;
+    static constexpr uint32_t maxTextures = 4096; // per binding, all bindings share one index space
+
+    enum Binding : uint32_t{
+        Texture2D = 0,
+        TextureCube = 1,
+        Texture2DArray = 2 // packed small textures, see VulkanTextureArrays
+    };
+
+private:
+    std::shared_ptr<VulkanDeviceI> device;
+
+    VkDescriptorSetLayout layout = nullptr;
+    VkDescriptorPool descriptorPool = nullptr;
+    VkDescriptorSet descriptorSet = nullptr;
+
+    uint32_t nextIndex = 0;
+    std::deque<uint32_t> freeIndices;
+
+public:
+    VulkanBindlessTextures(std::shared_ptr<VulkanDeviceI> device): device(device){
+
+        std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+        std::array<VkDescriptorBindingFlagsEXT, 3> bindingFlags{};
+
+        for(uint32_t i = 0; i < bindings.size(); i++){
+            bindings[i].binding = i; // 0 - sampler2D, 1 - samplerCube, 2 - sampler2DArray
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            bindings[i].descriptorCount = maxTextures;
+            bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+            bindings[i].pImmutableSamplers = nullptr;
+
+            bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT;
+        }
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = {};
+        flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        flagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+        flagsInfo.pBindingFlags = bindingFlags.data();
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = &flagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (VkResult errCode = vkCreateDescriptorSetLayout(*device, &layoutInfo, nullptr, &layout); errCode != VK_SUCCESS) {
+            throw std::runtime_error(std::format("failed to create bindless descriptor set layout: {}", static_cast<int>(errCode)));
+        }
+
+        VkDescriptorPoolSize poolSize = {};
+        poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSize.descriptorCount = maxTextures * static_cast<uint32_t>(bindings.size());
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = 1;
+
+        if (VkResult errCode = vkCreateDescriptorPool(*device, &poolInfo, nullptr, &descriptorPool); errCode != VK_SUCCESS) {
+            throw std::runtime_error(std::format("failed to create bindless descriptor pool: {}", static_cast<int>(errCode)));
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+
+        if (VkResult errCode = vkAllocateDescriptorSets(*device, &allocInfo, &descriptorSet); errCode != VK_SUCCESS) {
+            throw std::runtime_error(std::format("failed to allocate bindless descriptor set: {}", static_cast<int>(errCode)));
+        }
+    }
+
+    ~VulkanBindlessTextures(){
+        if(descriptorPool){
+            vkDestroyDescriptorPool(*device, descriptorPool, nullptr);
+        }
+
+        if(layout){
+            vkDestroyDescriptorSetLayout(*device, layout, nullptr);
+        }
+    }
+
+    operator VkDescriptorSet() const{
+        return descriptorSet;
+    }
+
+    VkDescriptorSetLayout getLayout(){
+        return layout;
+    }
+
+    // Stable index of the texture until it is removed, the view has to stay in SHADER_READ_ONLY_OPTIMAL
+    uint32_t add(VkImageView view, VkSampler sampler, Binding binding){
+        uint32_t index;
+
+        if(nextIndex < maxTextures){
+            index = nextIndex++;
+        }else if(!freeIndices.empty()){
+            index = freeIndices.front();
+            freeIndices.pop_front();
+        }else{
+            throw std::runtime_error(std::format("Bindless texture table is full: {}", maxTextures));
+        }
+
+        update(index, view, sampler, binding);
+
+        return index;
+    }
+
+    // Update-after-bind, safe while command buffers using other indices are pending
+    void update(uint32_t index, VkImageView view, VkSampler sampler, Binding binding){
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = view;
+        imageInfo.sampler = sampler;
+
+        VkWriteDescriptorSet descriptorWrite = {};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = descriptorSet;
+        descriptorWrite.dstBinding = binding;
+        descriptorWrite.dstArrayElement = index;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = &imageInfo;
+
+        vkUpdateDescriptorSets(*device, 1, &descriptorWrite, 0, nullptr);
+    }
+
+    // Freed indices are reused only after the fresh ones run out, frames in flight may still sample the removed texture
+    void remove(uint32_t index){
+        freeIndices.push_back(index);
+    }
+
+    uint32_t getTextureCount(){
+        return nextIndex - static_cast<uint32_t>(freeIndices.size());
+    }
+
+};
+
+
+}
@@ -9,13 +9,16 @@
 #include "vulkanMemory.h"
 #include "vulkanPhysicalDevice.h"
 #include "vulkanGraphicsPipeline.h"
+#include "vulkanComputePipeline.h"
 #include "vulkanFramebuffer.h"
+#include "vulkanQuery.h"
 
 #include <iostream>
 #include <vector>
 #include <cstdint> 
 #include <limits> 
 #include <algorithm> 
+#include <span>
 
 namespace MSIVulkanDemo{
 
@@ -89,8 +92,11 @@ private:
     CommandBufferState state = Initial;
 
     std::shared_ptr<VulkanFramebuffer> bindedFramebuffer = nullptr;
+    uint32_t currentSubpass = 0;
     std::shared_ptr<VulkanGraphicsPipeline> bindedGraphicsPipeline = nullptr;
-    std::shared_ptr<VulkanUniformBuffer> uniformBuffer;
+    std::shared_ptr<VulkanUniformAllocator> uniformAllocator;
+    size_t uniformBytesUploaded = 0; // since the last reset
+    std::shared_ptr<VulkanDescriptorSet> frameDescriptorSet; // set 0 of graphics pipelines, owned by the render graph
 
 public:
     VulkanCommandBuffer(std::shared_ptr<VulkanCommandPool> commandPool): commandPool(commandPool){
@@ -104,7 +110,7 @@ public:
             throw std::runtime_error(std::format("failed to allocate command buffers: {}", static_cast<int>(errCode)));
         }
 
-        uniformBuffer = commandPool->getDevice()->createMemoryManager()->createBuffer<VulkanUniformBuffer>(commandPool->getDevice()->createDescriptorPool(), 1024 * 1024);
+        uniformAllocator = std::make_shared<VulkanUniformAllocator>(commandPool->getDevice()->getMemoryManager());
     }
 
     ~VulkanCommandBuffer(){
@@ -121,6 +127,10 @@ public:
         state = CommandBufferState::Initial;
 
         bindedGraphicsPipeline.reset();
+        uniformBytesUploaded = 0;
+
+        // The previous submission of this command buffer has finished, ranges of released sets can be reused
+        uniformAllocator->collect();
 
         return *this;
     }
@@ -157,6 +167,7 @@ public:
         framebuffer->beginRenderPass(commandBuffer);
 
         bindedFramebuffer = framebuffer;
+        currentSubpass = 0;
 
         state = CommandBufferState::RecordingRenderPass;
 
@@ -179,10 +190,26 @@ public:
         return *this;
     }
 
-    VulkanCommandBuffer& bind(std::shared_ptr<VulkanGraphicsPipeline> graphicsPipeline){
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *graphicsPipeline);
+    VulkanCommandBuffer& nextSubpass(){
+
+        if(state != CommandBufferState::RecordingRenderPass){
+            throw std::runtime_error("Command buffer wrong state: trying to start next subpass outside of renderpass");
+        }
+
+        vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+        currentSubpass++;
+
+        return *this;
+    }
+
+    VulkanCommandBuffer& bind(std::shared_ptr<VulkanGraphicsPipeline> graphicsPipeline, VulkanGraphicsPipeline::Variant variant = VulkanGraphicsPipeline::Variant::Default){
+        if(bindedFramebuffer){
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->getPipeline(bindedFramebuffer->getRenderPass(), currentSubpass, variant));
+        }else{
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *graphicsPipeline);
+        }
 
-        VulkanGraphicsPipeline::ViewportStateInfo viewport(graphicsPipeline->getSwapChain());
+        VulkanGraphicsPipeline::ViewportStateInfo viewport = bindedFramebuffer ? VulkanGraphicsPipeline::ViewportStateInfo(bindedFramebuffer->getRenderArea()) : VulkanGraphicsPipeline::ViewportStateInfo(graphicsPipeline->getSwapChain());
 
         vkCmdSetViewport(commandBuffer, 0, 1, &viewport.viewport);
         vkCmdSetScissor(commandBuffer, 0, 1, &viewport.scissor);
@@ -198,22 +225,30 @@ public:
             throw std::runtime_error("Descriptor set should not be empty");
         }
 
-        uniformBuffer->bindDescriptorSet(*this, bindedGraphicsPipeline, descriptorSet);
+        if(!frameDescriptorSet){
+            throw std::runtime_error("Frame descriptor set is not set");
+        }
+
+        uniformAllocator->bindDescriptorSet(*this, bindedGraphicsPipeline, frameDescriptorSet, descriptorSet);
 
         return *this;
     }
 
     
     uint32_t getWidth(){
-        return bindedFramebuffer->getResolution().first;
+        return bindedFramebuffer->getRenderArea().width;
     }
 
     uint32_t getHeight(){
-        return bindedFramebuffer->getResolution().second;
+        return bindedFramebuffer->getRenderArea().height;
     }
 
     std::shared_ptr<VulkanDescriptorSet> createDescriptorSet(const VulkanUniformData& uniformData){
-        return uniformBuffer->createDescriptorSet(uniformData);
+        return uniformAllocator->createDescriptorSet(uniformData);
+    }
+
+    void setFrameDescriptorSet(std::shared_ptr<VulkanDescriptorSet> set){
+        frameDescriptorSet = set;
     }
 
 
@@ -224,7 +259,8 @@ public:
             throw std::runtime_error("Need to bind graphics pipeline first");
         }
 
-        uniformBuffer->uploadData(val.first, val.second);
+        uniformAllocator->uploadData(val.first, val.second);
+        uniformBytesUploaded += sizeof(t);
 
         return *this;
     }
@@ -238,13 +274,91 @@ public:
         return *this;
     }
 
+    // Uniform data of the bound descriptor set, e.g. MaterialComponent::getUniforms, ranges already held by the set are skipped
+    VulkanCommandBuffer& setUniform(std::span<const std::byte> data, std::span<const VulkanUniformRange> ranges){
+
+        if(!bindedGraphicsPipeline){
+            throw std::runtime_error("Need to bind graphics pipeline first");
+        }
+
+        auto set = uniformAllocator->getBindedDescriptorSet();
+
+        if(!set){
+            throw std::runtime_error("Need to bind descriptor set first");
+        }
+
+        for(size_t i = 0; i < ranges.size(); i++){
+            if(set->isUploaded(i, ranges[i].version)){
+                continue;
+            }
+
+            uniformAllocator->uploadData(ranges[i].offset, data.data() + ranges[i].offset, ranges[i].size);
+            uniformBytesUploaded += ranges[i].size;
+
+            set->setUploaded(i, ranges[i].version);
+        }
+
+        return *this;
+    }
+
     VulkanCommandBuffer& setUniform(std::pair<size_t, std::vector<float>> val){
 
         if(!bindedGraphicsPipeline){
             throw std::runtime_error("Need to bind graphics pipeline first");
         }
 
-        uniformBuffer->uploadData(val.first, val.second);
+        uniformAllocator->uploadData(val.first, val.second);
+        uniformBytesUploaded += val.second.size() * sizeof(float);
+
+        return *this;
+    }
+
+    size_t getUniformBytesUploaded(){
+        return uniformBytesUploaded;
+    }
+
+    VulkanUniformAllocator::memoryStats getUniformMemoryStats(){
+        return uniformAllocator->getStats();
+    }
+
+    // Per draw data of the bound pipeline's push constant range, offsets as in its VulkanPushConstantData
+    VulkanCommandBuffer& pushConstants(size_t offset, const void* data, size_t size){
+
+        if(!bindedGraphicsPipeline){
+            throw std::runtime_error("Need to bind graphics pipeline first");
+        }
+
+        const VulkanPushConstantData& pushConstantData = bindedGraphicsPipeline->getPushConstantData();
+
+        if(offset + size > pushConstantData.getSize()){
+            throw std::runtime_error(std::format("Push constants out of range: {} > {}", offset + size, pushConstantData.getSize()));
+        }
+
+        vkCmdPushConstants(commandBuffer, *bindedGraphicsPipeline, pushConstantData.getStages(), offset, size, data);
+
+        return *this;
+    }
+
+    template<typename t>
+    VulkanCommandBuffer& pushConstants(std::pair<size_t, t> val){
+        return pushConstants(val.first, &val.second, sizeof(t));
+    }
+
+    // Whole push constant range in one call, e.g. MaterialComponent::getPushConstants
+    VulkanCommandBuffer& pushConstants(std::span<const std::byte> data){
+
+        if(data.size() > 0){
+            pushConstants(0, data.data(), data.size());
+        }
+
+        return *this;
+    }
+
+    VulkanCommandBuffer& pushConstants(std::vector<std::pair<size_t, std::vector<float>>> values){
+
+        for(auto& value : values){
+            pushConstants(value.first, value.second.data(), value.second.size() * sizeof(float));
+        }
 
         return *this;
     }
@@ -262,15 +376,79 @@ public:
         return *this;
     }
 
-    VulkanCommandBuffer& draw(std::pair<uint32_t, uint32_t> count){
+    // firstInstance is visible as gl_InstanceIndex, shaders can use it to index per draw data
+    VulkanCommandBuffer& draw(std::pair<uint32_t, uint32_t> count, uint32_t firstInstance = 0){
 
         if(count.second > 0){
-            vkCmdDrawIndexed(commandBuffer, count.second, 1, 0, 0, 0);
+            vkCmdDrawIndexed(commandBuffer, count.second, 1, 0, 0, firstInstance);
+
+            return *this;
+        }
+
+        vkCmdDraw(commandBuffer, count.first, 1, 0, firstInstance);
+
+        return *this;
+    }
+
+    // Indexed draws written by the GPU, with a count buffer the driver reads the draw count from it (VK_KHR_draw_indirect_count),
+    // otherwise all maxDrawCount commands are executed and unused ones have to be zeroed
+    VulkanCommandBuffer& drawIndirect(VulkanBufferI& commands, VkDeviceSize offset, uint32_t maxDrawCount, VulkanBufferI* countBuffer = nullptr, VkDeviceSize countOffset = 0){
 
+        if(maxDrawCount == 0){
             return *this;
         }
 
-        vkCmdDraw(commandBuffer, count.first, 1, 0, 0);
+        if(countBuffer && commandPool->getDevice()->getDrawIndexedIndirectCount()){
+            commandPool->getDevice()->getDrawIndexedIndirectCount()(commandBuffer, commands, offset, *countBuffer, countOffset, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+
+            return *this;
+        }
+
+        vkCmdDrawIndexedIndirect(commandBuffer, commands, offset, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+
+        return *this;
+    }
+
+    VulkanCommandBuffer& bind(VulkanComputePipeline& computePipeline, VulkanDescriptorSet& descriptorSet){
+
+        if(state == CommandBufferState::RecordingRenderPass){
+            throw std::runtime_error("Command buffer wrong state: compute pipeline cannot be bound inside renderpass");
+        }
+
+        if(state == CommandBufferState::Initial){
+            begin();
+        }
+
+        VkDescriptorSet sets[] = {descriptorSet};
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline, 0, 1, sets, 0, nullptr);
+
+        return *this;
+    }
+
+    VulkanCommandBuffer& dispatch(uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1){
+
+        if(state != CommandBufferState::Recording){
+            throw std::runtime_error("Command buffer wrong state: dispatch needs to be recorded outside of renderpass");
+        }
+
+        vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+
+        return *this;
+    }
+
+    VulkanCommandBuffer& fillBuffer(VulkanBufferI& buffer, uint32_t value, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE){
+
+        if(state == CommandBufferState::RecordingRenderPass){
+            throw std::runtime_error("Command buffer wrong state: buffers cannot be filled inside renderpass");
+        }
+
+        if(state == CommandBufferState::Initial){
+            begin();
+        }
+
+        vkCmdFillBuffer(commandBuffer, buffer, offset, size, value);
 
         return *this;
     }
@@ -291,6 +469,17 @@ public:
         return *this;
     }
 
+    VulkanCommandBuffer& copyImage(VulkanImageI& src, VulkanImageI& dst, VkImageCopy& region){
+
+        if(state == CommandBufferState::RecordingRenderPass){
+            throw std::runtime_error("Command buffer wrong state: images cannot be copied inside renderpass");
+        }
+
+        vkCmdCopyImage(commandBuffer, src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        return *this;
+    }
+
     VulkanCommandBuffer& setBarrier(VkImageMemoryBarrier& barrier, VkPipelineStageFlags srcStage = 0, VkPipelineStageFlags dstStage = 0){ //TODO add default values
         
 
@@ -300,6 +489,68 @@ public:
         return *this;
     };
 
+    VulkanCommandBuffer& setBarrier(std::vector<VkImageMemoryBarrier>& barriers, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage){
+
+        if(barriers.empty()){
+            return *this;
+        }
+
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, barriers.size(), barriers.data());
+
+        return *this;
+    };
+
+    VulkanCommandBuffer& setBarrier(VkBufferMemoryBarrier& barrier, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage){
+
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+        return *this;
+    };
+
+    VulkanCommandBuffer& setBarrier(std::vector<VkBufferMemoryBarrier>& barriers, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage){
+
+        if(barriers.empty()){
+            return *this;
+        }
+
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, barriers.size(), barriers.data(), 0, nullptr);
+
+        return *this;
+    };
+
+    VulkanCommandBuffer& resetQueries(VulkanQueryPool& queryPool, uint32_t firstQuery = 0, uint32_t count = std::numeric_limits<uint32_t>::max()){
+
+        if(state == CommandBufferState::RecordingRenderPass){
+            throw std::runtime_error("Command buffer wrong state: queries cannot be reset inside renderpass");
+        }
+
+        if(state == CommandBufferState::Initial){
+            begin();
+        }
+
+        vkCmdResetQueryPool(commandBuffer, queryPool, firstQuery, std::min(count, queryPool.getQueryCount() - firstQuery));
+
+        return *this;
+    }
+
+    VulkanCommandBuffer& beginQuery(VulkanQueryPool& queryPool, uint32_t query){
+        vkCmdBeginQuery(commandBuffer, queryPool, query, 0);
+
+        return *this;
+    }
+
+    VulkanCommandBuffer& endQuery(VulkanQueryPool& queryPool, uint32_t query){
+        vkCmdEndQuery(commandBuffer, queryPool, query);
+
+        return *this;
+    }
+
+    VulkanCommandBuffer& writeTimestamp(VulkanQueryPool& queryPool, uint32_t query, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT){
+        vkCmdWriteTimestamp(commandBuffer, stage, queryPool, query);
+
+        return *this;
+    }
+
     VulkanCommandBuffer& end(){
 
         if(state != CommandBufferState::Recording){
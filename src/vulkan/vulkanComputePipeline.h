@@ -0,0 +1,90 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "interface/vulkanDeviceI.h"
+#include "vulkanShader.h"
+#include "vulkanUniform.h"
+
+#include <iostream>
+#include <vector>
+#include <map>
+
+namespace MSIVulkanDemo{
+
+
+class VulkanComputePipeline : public VulkanComponent<VulkanComputePipeline>{
+private:
+    std::shared_ptr<VulkanDeviceI> device;
+    std::shared_ptr<VulkanShader> shader;
+
+    std::unique_ptr<VulkanUniformData> uniforms;
+    std::shared_ptr<VulkanUniformLayout> uniformLayout;
+
+    VkPipeline computePipeline = nullptr;
+    VkPipelineLayout pipelineLayout = nullptr;
+
+public:
+    // Immutable samplers by sampler name are baked into the set layout
+    VulkanComputePipeline(std::shared_ptr<VulkanDeviceI> device, std::shared_ptr<VulkanShader> shader, std::map<std::string, std::shared_ptr<VulkanTextureSampler>> immutableSamplers = {}): device(device), shader(shader){
+
+        if(shader->getType() != Compute){
+            throw std::runtime_error("Compute pipeline needs a compute shader");
+        }
+
+        uniforms.reset(new VulkanUniformData(shader->getUniformData(), device->getPhysicalDevice().getDeviceLimits().minUniformBufferOffsetAlignment));
+        for(const auto& [name, sampler] : immutableSamplers){
+            uniforms->setImmutableSampler(name, sampler);
+        }
+        uniformLayout = uniforms->getUniformLayout(device);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = uniformLayout->getLayoutPtr();
+
+        if (VkResult errCode = vkCreatePipelineLayout(*device, &pipelineLayoutInfo, nullptr, &pipelineLayout); errCode != VK_SUCCESS) {
+            throw std::runtime_error(std::format("failed to create compute pipeline layout: {}", static_cast<int>(errCode)));
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = *shader;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+
+        if (VkResult errCode = vkCreateComputePipelines(*device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline); errCode != VK_SUCCESS) {
+            throw std::runtime_error(std::format("failed to create compute pipeline: {}", static_cast<int>(errCode)));
+        }
+    }
+
+    ~VulkanComputePipeline(){
+        if(computePipeline){
+            vkDestroyPipeline(*device, computePipeline, nullptr);
+        }
+
+        if(pipelineLayout){
+            vkDestroyPipelineLayout(*device, pipelineLayout, nullptr);
+        }
+    }
+
+    operator VkPipeline() const{
+        return computePipeline;
+    }
+
+    operator VkPipelineLayout() const{
+        return pipelineLayout;
+    }
+
+    const VulkanUniformData& getUniformData(){
+        return *uniforms;
+    }
+
+};
+
+
+
+}
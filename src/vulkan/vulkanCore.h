@@ -11,6 +11,7 @@
 #include "vulkanFramebuffer.h"
 #include "vulkanGraphicsPipeline.h"
 #include "vulkanMemory.h"
+#include "vulkanTextureArrays.h"
 #include "vulkanVertexData.h"
 #include "vulkanRenderGraph.h"
 #include "interface/vulkanRendererI.h"
@@ -47,7 +48,9 @@ private:
 
     const std::vector<const char*> deviceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
+        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+        VK_KHR_MAINTENANCE3_EXTENSION_NAME,
+        VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME
     };
 
     std::shared_ptr<VulkanSurface> surface;
@@ -56,6 +59,7 @@ private:
     std::shared_ptr<VulkanSwapChain> swapChain;
     std::shared_ptr<VulkanMemoryManager> memory;
     std::shared_ptr<VulkanDescriptorPool> descriptorPool;
+    std::shared_ptr<VulkanBindlessTextures> bindlessTextures;
 
 
 
@@ -75,6 +79,7 @@ public:
         device = physicalDevice->createLogicDevice();
         swapChain = device->getSwapChain();
         memory = device->createMemoryManager();
+        bindlessTextures = device->getBindlessTextures();
         renderGraph = std::make_shared<VulkanRenderGraph>(swapChain); // TODO better initialization
 
     }
@@ -102,6 +107,14 @@ public:
         return memory;
     }
 
+    std::shared_ptr<VulkanRenderGraph> getRenderGraph(){
+        return renderGraph;
+    }
+
+    std::shared_ptr<VulkanSwapChain> getSwapChain(){
+        return swapChain;
+    }
+
     void drawFrame(){
         uint64_t frameIndex = currentFrame%MAX_FRAMES_IN_FLIGHT;
 
@@ -12,9 +12,13 @@
 #include "vulkanMemory.h"
 #include "vulkanUniform.h"
 #include "vulkanTextureSampler.h"
+#include "vulkanQuery.h"
+#include "vulkanBindlessTextures.h"
 
 #include <iostream>
 #include <set>
+#include <algorithm>
+#include <unordered_map>
 
 namespace MSIVulkanDemo{
 
@@ -25,6 +29,10 @@ private:
     VkQueue presentQueue = nullptr;
 
     const std::vector<const char*> deviceExtensions;
+    const std::vector<const char*> optionalDeviceExtensions = {
+        VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME
+    };
+    std::vector<const char*> enabledExtensions;
 
     float queuePriority = 1.0f;
 
@@ -33,10 +41,17 @@ private:
     std::weak_ptr<VulkanSwapChain> swapChain;
     std::weak_ptr<VulkanCommandPool> commandPool;
     std::weak_ptr<VulkanMemoryManager> memoryManager;
-    std::vector<std::weak_ptr<VulkanTextureSampler>> samplers;
+    std::unordered_map<VulkanSamplerDescription, std::weak_ptr<VulkanTextureSampler>, VulkanSamplerDescription::hash> samplers; // shared by every user of the same state
     std::vector<std::weak_ptr<VulkanDescriptorPool>> descriptorPools;
     std::vector<std::weak_ptr<VulkanSemaphore>> semaphores;
     std::vector<std::weak_ptr<VulkanFence>> fences;
+    std::vector<std::weak_ptr<VulkanQueryPool>> queryPools;
+    std::weak_ptr<VulkanBindlessTextures> bindlessTextures;
+
+    VkPhysicalDeviceFeatures enabledFeatures{};
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledIndexingFeatures{};
+
+    PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount = nullptr;
 
 public:
     VulkanDevice(std::shared_ptr<VulkanPhysicalDevice> physicalDevice, const std::vector<const char*> deviceExtensions): physicalDevice(physicalDevice), deviceExtensions(deviceExtensions){
@@ -61,12 +76,33 @@ public:
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        enabledExtensions = deviceExtensions;
+        for(auto extension : optionalDeviceExtensions){
+            if(physicalDevice->isExtensionSupported(extension)){
+                enabledExtensions.push_back(extension);
+            }
+        }
+
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
+
+        VkPhysicalDeviceFeatures supportedFeatures = physicalDevice->getFeatures();
 
-        VkPhysicalDeviceFeatures deviceFeatures{};
-        deviceFeatures.samplerAnisotropy = VK_TRUE;
-        createInfo.pEnabledFeatures = &deviceFeatures;
+        enabledFeatures.samplerAnisotropy = VK_TRUE;
+        enabledFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery; // optional, used for debug counters
+        enabledFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect; // optional, GPU-driven rendering
+        enabledFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+        enabledFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC; // optional, compressed texture containers
+        enabledFeatures.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+        createInfo.pEnabledFeatures = &enabledFeatures;
+
+        // Bindless texture table, checked by the physical device selection
+        enabledIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        enabledIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+        enabledIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        enabledIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        enabledIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        createInfo.pNext = &enabledIndexingFeatures;
 
         if (VkResult errCode = vkCreateDevice(*physicalDevice, &createInfo, nullptr, &device); errCode != VK_SUCCESS) {
             throw std::runtime_error(std::format("failed to create logical device: {}", static_cast<int>(errCode)));
@@ -76,6 +112,10 @@ public:
         vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
         vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
 
+        if(isExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)){
+            drawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR) vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
+        }
+
     }
 
     ~VulkanDevice(){
@@ -141,14 +181,32 @@ public:
         return createMemoryManager();
     }
 
-    std::shared_ptr<VulkanTextureSampler> createTextureSampler(){ //TODO change to get as samplers can be global
-        auto ts = std::make_shared<VulkanTextureSampler>(shared_from_this()); //TODO pool this
+    std::shared_ptr<VulkanTextureSampler> getTextureSampler(){
+        return getTextureSampler(VulkanSamplerDescription());
+    }
 
-        samplers.push_back(ts);
+    // Samplers live while anyone holds them, the count stays with the distinct descriptions in use
+    std::shared_ptr<VulkanTextureSampler> getTextureSampler(const VulkanSamplerDescription& description){
+        if(auto it = samplers.find(description); it != samplers.end()){
+            if(std::shared_ptr<VulkanTextureSampler> sampler = it->second.lock()){
+                return sampler;
+            }
+        }
+
+        auto ts = std::make_shared<VulkanTextureSampler>(shared_from_this(), description);
+        samplers.insert_or_assign(description, ts);
 
         return ts;
     }
 
+    size_t getTextureSamplerCount(){
+        std::erase_if(samplers, [](const auto& kv){
+            return kv.second.expired();
+        });
+
+        return samplers.size();
+    }
+
     std::shared_ptr<VulkanSemaphore> createSemaphore(){ 
         auto sh = std::make_shared<VulkanSemaphore>(shared_from_this());
 
@@ -177,6 +235,37 @@ public:
         return dp;
     }
 
+    std::shared_ptr<VulkanQueryPool> createQueryPool(VkQueryType type, uint32_t queryCount, VkQueryPipelineStatisticFlags pipelineStatistics = 0){
+        auto qp = std::make_shared<VulkanQueryPool>(shared_from_this(), type, queryCount, pipelineStatistics);
+
+        queryPools.push_back(qp);
+
+        return qp;
+    }
+
+    std::shared_ptr<VulkanBindlessTextures> getBindlessTextures(){
+        if(bindlessTextures.expired()){
+            auto bt = std::make_shared<VulkanBindlessTextures>(shared_from_this());
+            bindlessTextures = bt;
+            return bt;
+        }else{
+            return bindlessTextures.lock();
+        }
+    }
+
+    const VkPhysicalDeviceFeatures& getEnabledFeatures(){
+        return enabledFeatures;
+    }
+
+    bool isExtensionEnabled(std::string name){
+        return std::find(enabledExtensions.begin(), enabledExtensions.end(), name) != enabledExtensions.end();
+    }
+
+    // nullptr without VK_KHR_draw_indirect_count
+    PFN_vkCmdDrawIndexedIndirectCountKHR getDrawIndexedIndirectCount(){
+        return drawIndexedIndirectCount;
+    }
+
     void waitForIdle(){
         vkDeviceWaitIdle(device);
     }
@@ -0,0 +1,68 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "vulkanUniform.h"
+
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <vector>
+
+namespace MSIVulkanDemo{
+
+
+// Descriptor sets of graphics pipelines split by update frequency: set 0 holds the engine data of the frame (shaders/include/frame.glsl),
+// written once per frame by the render graph and shared by every pipeline, set 1 the material's own bindings and set 2 the bindless textures.
+// Per object data is indexed by gl_InstanceIndex in the object buffer of set 0 or pushed as push constants
+class VulkanFrameData{
+public:
+    static constexpr uint32_t frameSet = 0;
+    static constexpr uint32_t materialSet = 1;
+
+    // std140 layout of FrameBuffer in frame.glsl
+    struct frameBlock{
+        glm::mat4 view;
+        glm::mat4 proj;
+        glm::vec4 viewPos; // xyz
+        glm::vec4 time; // x seconds since start, y frame time
+    };
+
+    // Same layout for every pipeline so the set stays compatible between them, bindings match the engine includes
+    static VulkanUniformData getUniformData(size_t minDeviceOffset){
+        auto engineBinding = [](VulkanUniformData::binding_id binding, std::string name, VkDescriptorType type){
+            VulkanUniformData::bindingBlock block;
+            block.binding = binding;
+            block.set = frameSet;
+            block.type = type;
+            block.attribs.push_back({.binding = binding, .name = name, .size = 0, .componentCount = 0});
+            return block;
+        };
+
+        VulkanUniformData::bindingBlock frame;
+        frame.binding = 0;
+        frame.set = frameSet;
+        frame.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        frame.attribs = {
+            {.binding = 0, .name = "_view", .size = sizeof(glm::mat4), .componentCount = 16},
+            {.binding = 0, .name = "_proj", .size = sizeof(glm::mat4), .componentCount = 16},
+            {.binding = 0, .name = "_viewPos", .size = sizeof(glm::vec4), .componentCount = 4},
+            {.binding = 0, .name = "_time", .size = sizeof(glm::vec4), .componentCount = 4}
+        };
+
+        return VulkanUniformData({
+            frame,
+            engineBinding(10, "_shadows", VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+            engineBinding(11, "_shadowCascades", VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+            engineBinding(12, "_shadowCubes", VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+            engineBinding(13, "_objects", VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+            engineBinding(14, "_lights", VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+            engineBinding(15, "_clusterLights", VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+        }, minDeviceOffset);
+    }
+
+};
+
+
+}
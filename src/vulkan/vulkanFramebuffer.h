@@ -25,9 +25,15 @@ private:
 
     VkFramebuffer framebuffer = nullptr;
     uint32_t width, height; 
+    VkExtent2D renderArea; // part of the framebuffer rendered to, smaller than it with dynamic resolution
 
 public:
-    VulkanFramebuffer(std::shared_ptr<VulkanRenderPassI> renderPass, std::vector<std::shared_ptr<VulkanImageView>> imageViews): renderPass(renderPass), imageViews(imageViews){
+    VulkanFramebuffer(std::shared_ptr<VulkanRenderPassI> renderPass, std::vector<std::shared_ptr<VulkanImageView>> imageViews): VulkanFramebuffer(renderPass, imageViews, renderPass->getSwapChain()->getSwapChainExtent()){
+
+    }
+
+    // Sized independently of the swapchain, e.g. shadow maps
+    VulkanFramebuffer(std::shared_ptr<VulkanRenderPassI> renderPass, std::vector<std::shared_ptr<VulkanImageView>> imageViews, VkExtent2D extent): renderPass(renderPass), imageViews(imageViews){
 
         std::vector<VkImageView> attachments;
 
@@ -35,8 +41,9 @@ public:
             attachments.push_back(*view);
         }
 
-        width = renderPass->getSwapChain()->getSwapChainExtent().width;
-        height = renderPass->getSwapChain()->getSwapChainExtent().height;
+        width = extent.width;
+        height = extent.height;
+        renderArea = {width, height};
     
         VkFramebufferCreateInfo framebufferInfo{};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -62,6 +69,18 @@ public:
         return {width, height};
     }
 
+    void setRenderArea(VkExtent2D extent){
+        renderArea = {std::clamp(extent.width, 1u, width), std::clamp(extent.height, 1u, height)};
+    }
+
+    VkExtent2D getRenderArea(){
+        return renderArea;
+    }
+
+    VkRenderPass getRenderPass(){
+        return *renderPass;
+    }
+
     void beginRenderPass(VkCommandBuffer& commandBuffer){
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -69,11 +88,9 @@ public:
         renderPassInfo.framebuffer = framebuffer;
 
         renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = renderPass->getSwapChain()->getSwapChainExtent();
+        renderPassInfo.renderArea.extent = renderArea;
 
-        std::array<VkClearValue, 2> clearValues{};
-        clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-        clearValues[1].depthStencil = {1.0f, 0};
+        std::vector<VkClearValue> clearValues = renderPass->getClearValues();
 
         renderPassInfo.clearValueCount = clearValues.size();
         renderPassInfo.pClearValues = clearValues.data();
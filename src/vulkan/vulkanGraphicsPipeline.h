@@ -9,16 +9,28 @@
 #include "vulkanShader.h"
 #include "vulkanVertexData.h"
 #include "vulkanUniform.h"
+#include "vulkanBindlessTextures.h"
+#include "vulkanFrameData.h"
 
 #include <iostream>
 #include <fstream>
 #include <set>
 #include <iomanip>
+#include <map>
+#include <tuple>
 
 namespace MSIVulkanDemo{
 
 
 class VulkanGraphicsPipeline : public VulkanComponent<VulkanGraphicsPipeline>{
+public:
+    enum class Variant{
+        Default,
+        DepthOnly, // vertex stage only, writes depth of a depth pre-pass
+        DepthEqual, // full shading where depth matches the pre-pass, no depth writes
+        Shadow // depth only with depth bias and no culling, for shadow map passes
+    };
+
 private:
     std::shared_ptr<VulkanRenderPassI> renderPass;
     //std::vector<std::shared_ptr<VulkanUniformLayout>> uniformLayouts;
@@ -28,13 +40,18 @@ private:
 
     std::unique_ptr<VulkanUniformData> vertexUniforms;
     std::unique_ptr<VulkanUniformData> fragmentUniforms; 
+    std::unique_ptr<VulkanPushConstantData> pushConstants;
+
+    std::shared_ptr<VulkanShader> vertShader;
+    std::shared_ptr<VulkanShader> fragShader;
+
+    std::shared_ptr<VulkanBindlessTextures> bindlessTextures; // null when the shaders don't sample the bindless table
+
+    std::map<std::tuple<VkRenderPass, uint32_t, Variant>, VkPipeline> variants; // same pipeline baked for other (merged) render passes or depth states
 
 public:
     VulkanGraphicsPipeline(std::shared_ptr<VulkanRenderPassI> renderPass, std::vector<std::shared_ptr<VulkanShader>> shaders): renderPass(renderPass){
 
-        std::shared_ptr<VulkanShader> vertShader;
-        std::shared_ptr<VulkanShader> fragShader;
-
         for(auto shader : shaders){
             if(shader->getType() == Vertex){
                 vertShader = shader;
@@ -44,68 +61,33 @@ public:
             }
         }
 
-        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertShaderStageInfo.module = *vertShader;
-        vertShaderStageInfo.pName = "main";
-
-        VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragShaderStageInfo.module = *fragShader;
-        fragShaderStageInfo.pName = "main";
-
-        VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
-
-
-        VkGraphicsPipelineCreateInfo pipelineInfo{};
-        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfo.stageCount = 2;
-        pipelineInfo.pStages = shaderStages;
-
-        VertexInputStateInfo vertexInputInfo = VertexInputStateInfo(vertShader->getVertexData());
-        pipelineInfo.pVertexInputState = &vertexInputInfo.vertexInputInfo;
-
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly = getInputAssemblyInfo();
-        pipelineInfo.pInputAssemblyState = &inputAssembly;
-
-        ViewportStateInfo viewportState = ViewportStateInfo(*renderPass->getSwapChain());
-        pipelineInfo.pViewportState = &viewportState.viewportState;
-
-        VkPipelineRasterizationStateCreateInfo rasterizer = getRasterizerInfo();
-        pipelineInfo.pRasterizationState = &rasterizer;
-
-        VkPipelineMultisampleStateCreateInfo multisampling = getMultisamplingInfo();
-        pipelineInfo.pMultisampleState = &multisampling;
-
-        VkPipelineDepthStencilStateCreateInfo depthStencilInfo = getDepthAndStencilInfo();
-        pipelineInfo.pDepthStencilState = &depthStencilInfo;
-
-        ColorBlendStateInfo colorBlending = ColorBlendStateInfo();
-        pipelineInfo.pColorBlendState = &colorBlending.colorBlending;
+        vertexUniforms.reset(new VulkanUniformData(vertShader->getUniformData(), renderPass->getDevice()->getPhysicalDevice().getDeviceLimits().minUniformBufferOffsetAlignment));
+        fragmentUniforms.reset(new VulkanUniformData(fragShader->getUniformData(), renderPass->getDevice()->getPhysicalDevice().getDeviceLimits().minUniformBufferOffsetAlignment));
+        std::vector<std::shared_ptr<VulkanUniformLayout>> uniformLayouts = {
+            VulkanFrameData::getUniformData(renderPass->getDevice()->getPhysicalDevice().getDeviceLimits().minUniformBufferOffsetAlignment).getUniformLayout(renderPass->getDevice()),
+            (*vertexUniforms + *fragmentUniforms).getUniformLayout(renderPass->getDevice())
+        };
 
-        DynamicStateInfo dynamicState = DynamicStateInfo();
-        pipelineInfo.pDynamicState = &dynamicState.dynamicState;
+        std::vector<VkDescriptorSetLayout> setLayouts;
+        for(auto uniformLayout : uniformLayouts){
+            setLayouts.push_back(*uniformLayout);
+        }
 
-        pipelineInfo.renderPass = *renderPass;
-        pipelineInfo.subpass = 0;
+        if(vertShader->usesBindlessTextures() || fragShader->usesBindlessTextures()){
+            bindlessTextures = renderPass->getDevice()->getBindlessTextures();
+            setLayouts.push_back(bindlessTextures->getLayout());
+        }
 
+        pushConstants.reset(new VulkanPushConstantData(vertShader->getPushConstantData() + fragShader->getPushConstantData()));
 
-        vertexUniforms.reset(new VulkanUniformData(vertShader->getUniformData(), renderPass->getDevice()->getPhysicalDevice().getDeviceLimits().minUniformBufferOffsetAlignment));
-        fragmentUniforms.reset(new VulkanUniformData(fragShader->getUniformData(), renderPass->getDevice()->getPhysicalDevice().getDeviceLimits().minUniformBufferOffsetAlignment));
-        std::vector<std::shared_ptr<VulkanUniformLayout>> uniformLayouts = {(*vertexUniforms + *fragmentUniforms).getUniformLayout(renderPass->getDevice())};
+        if(pushConstants->getSize() > renderPass->getDevice()->getPhysicalDevice().getDeviceLimits().maxPushConstantsSize){
+            throw std::runtime_error(std::format("Push constants exceed device limit: {} > {}", pushConstants->getSize(), renderPass->getDevice()->getPhysicalDevice().getDeviceLimits().maxPushConstantsSize));
+        }
 
-        PipelineLayout pipeline = PipelineLayout(*renderPass->getSwapChain(), uniformLayouts);
+        PipelineLayout pipeline = PipelineLayout(*renderPass->getSwapChain(), setLayouts, *pushConstants);
         pipelineLayout = pipeline.pipelineLayout;
-        pipelineInfo.layout = pipelineLayout;
 
-        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
-        pipelineInfo.basePipelineIndex = -1; // Optional
-
-        if (VkResult errCode = vkCreateGraphicsPipelines(*renderPass->getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline); errCode != VK_SUCCESS) {
-            throw std::runtime_error(std::format("failed to create graphics pipeline: {}", static_cast<int>(errCode)));
-        }
+        graphicsPipeline = createPipeline(*renderPass, 0);
     }
 
     ~VulkanGraphicsPipeline(){
@@ -113,6 +95,10 @@ public:
             vkDestroyPipeline(*renderPass->getDevice(), graphicsPipeline, nullptr);
         }
 
+        for(auto& [key, variant] : variants){
+            vkDestroyPipeline(*renderPass->getDevice(), variant, nullptr);
+        }
+
         if(pipelineLayout){
             vkDestroyPipelineLayout(*renderPass->getDevice(), pipelineLayout, nullptr);
         }
@@ -126,22 +112,42 @@ public:
         return graphicsPipeline;
     }
 
+    VkPipeline getPipeline(VkRenderPass compatibleRenderPass, uint32_t subpass, Variant variant = Variant::Default){
+        if(compatibleRenderPass == *renderPass && subpass == 0 && variant == Variant::Default){
+            return graphicsPipeline;
+        }
+
+        if(!variants.contains({compatibleRenderPass, subpass, variant})){
+            variants.insert({{compatibleRenderPass, subpass, variant}, createPipeline(compatibleRenderPass, subpass, variant)});
+        }
+
+        return variants.at({compatibleRenderPass, subpass, variant});
+    }
+
     VulkanUniformData getUniformData(){
         return *vertexUniforms + *fragmentUniforms;
     }
 
+    const VulkanPushConstantData& getPushConstantData(){
+        return *pushConstants;
+    }
+
     VulkanSwapChainI& getSwapChain(){
         return *renderPass->getSwapChain();
     }
 
+    std::shared_ptr<VulkanBindlessTextures> getBindlessTextures(){
+        return bindlessTextures;
+    }
+
     struct ViewportStateInfo{
         VkViewport viewport{};
         VkRect2D scissor{};
         VkPipelineViewportStateCreateInfo viewportState{};
 
-        ViewportStateInfo(VulkanSwapChainI& swapChain){
-            VkExtent2D swapChainExtent = swapChain.getSwapChainExtent();
+        ViewportStateInfo(VulkanSwapChainI& swapChain): ViewportStateInfo(swapChain.getSwapChainExtent()){}
 
+        ViewportStateInfo(VkExtent2D swapChainExtent){
             viewport.x = 0.0f;
             viewport.y = 0.0f;
             viewport.width = static_cast<float>(swapChainExtent.width);
@@ -162,6 +168,86 @@ public:
 
 private:
 
+    VkPipeline createPipeline(VkRenderPass compatibleRenderPass, uint32_t subpass, Variant variant = Variant::Default){
+
+        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+        vertShaderStageInfo.module = *vertShader;
+        vertShaderStageInfo.pName = "main";
+
+        VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        fragShaderStageInfo.module = *fragShader;
+        fragShaderStageInfo.pName = "main";
+
+        VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = (variant == Variant::DepthOnly || variant == Variant::Shadow) ? 1 : 2; // depth only pipelines skip the fragment stage
+        pipelineInfo.pStages = shaderStages;
+
+        VertexInputStateInfo vertexInputInfo = VertexInputStateInfo(vertShader->getVertexData());
+        pipelineInfo.pVertexInputState = &vertexInputInfo.vertexInputInfo;
+
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly = getInputAssemblyInfo();
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+
+        ViewportStateInfo viewportState = ViewportStateInfo(*renderPass->getSwapChain());
+        pipelineInfo.pViewportState = &viewportState.viewportState;
+
+        VkPipelineRasterizationStateCreateInfo rasterizer = getRasterizerInfo();
+        if(variant == Variant::Shadow){
+            // Open meshes still have to cast, acne is handled by the slope scaled bias
+            rasterizer.cullMode = VK_CULL_MODE_NONE;
+            rasterizer.depthBiasEnable = VK_TRUE;
+            rasterizer.depthBiasConstantFactor = 1.25f;
+            rasterizer.depthBiasSlopeFactor = 1.75f;
+        }
+        pipelineInfo.pRasterizationState = &rasterizer;
+
+        VkPipelineMultisampleStateCreateInfo multisampling = getMultisamplingInfo();
+        pipelineInfo.pMultisampleState = &multisampling;
+
+        VkPipelineDepthStencilStateCreateInfo depthStencilInfo = getDepthAndStencilInfo();
+        if(variant == Variant::DepthOnly){
+            depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+        }
+        if(variant == Variant::DepthEqual){
+            depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+            depthStencilInfo.depthWriteEnable = VK_FALSE;
+        }
+        pipelineInfo.pDepthStencilState = &depthStencilInfo;
+
+        ColorBlendStateInfo colorBlending = ColorBlendStateInfo();
+        if(variant == Variant::DepthOnly || variant == Variant::Shadow){
+            colorBlending.colorBlending.attachmentCount = 0;
+        }
+        pipelineInfo.pColorBlendState = &colorBlending.colorBlending;
+
+        DynamicStateInfo dynamicState = DynamicStateInfo();
+        pipelineInfo.pDynamicState = &dynamicState.dynamicState;
+
+        pipelineInfo.renderPass = compatibleRenderPass;
+        pipelineInfo.subpass = subpass;
+
+        pipelineInfo.layout = pipelineLayout;
+
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+        pipelineInfo.basePipelineIndex = -1; // Optional
+
+        VkPipeline pipeline = nullptr;
+
+        if (VkResult errCode = vkCreateGraphicsPipelines(*renderPass->getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline); errCode != VK_SUCCESS) {
+            throw std::runtime_error(std::format("failed to create graphics pipeline: {}", static_cast<int>(errCode)));
+        }
+
+        return pipeline;
+    }
+
     struct DynamicStateInfo{
         std::vector<VkDynamicState> dynamicStates = {
             VK_DYNAMIC_STATE_VIEWPORT,
@@ -278,20 +364,15 @@ private:
         VkDescriptorSetLayout layout;
         VkPipelineLayout pipelineLayout = nullptr;
 
-        PipelineLayout(VulkanSwapChainI& swapChain, std::vector<std::shared_ptr<VulkanUniformLayout>> uniformLayouts){
+        PipelineLayout(VulkanSwapChainI& swapChain, std::vector<VkDescriptorSetLayout> layouts, const VulkanPushConstantData& pushConstants){
             VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
             pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-            pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(uniformLayouts.size());
-            
-            std::vector<VkDescriptorSetLayout> layouts;
-            for(auto uniformLayout : uniformLayouts){
-                layouts.push_back(*uniformLayout);
-            }
-
+            pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
             pipelineLayoutInfo.pSetLayouts = layouts.data();
             
-            pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-            pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+            VkPushConstantRange pushConstantRange = pushConstants.getRange();
+            pipelineLayoutInfo.pushConstantRangeCount = pushConstants.getSize() > 0 ? 1 : 0;
+            pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
             if (VkResult errCode = vkCreatePipelineLayout(*swapChain.getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout); errCode != VK_SUCCESS) {
                 throw std::runtime_error(std::format("failed to create pipeline layout: {}", static_cast<int>(errCode)));
@@ -5,32 +5,45 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <algorithm>
+#include <stdexcept>
 
 namespace MSIVulkanDemo{
 
+// Pixels of every layer of every mip level, level after level with the layers of a level next to each other
 class VulkanImageData{
 private:
 
     std::vector<uint8_t> imageData;
     std::pair<uint32_t, uint32_t> resolution;
     uint32_t channels, layers;
+    uint32_t mipLevels = 1;
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    std::vector<size_t> levelOffsets; // of precomputed levels, otherwise derived from the resolution and channels
+    bool cubemap = false;
 
 public:
     VulkanImageData(std::pair<uint32_t, uint32_t> resolution, uint32_t channels, uint32_t layers = 1):resolution(resolution), channels(channels), layers(layers){
 
     }
 
+    // Precomputed levels as stored in a container, e.g. block compressed
+    VulkanImageData(std::pair<uint32_t, uint32_t> resolution, VkFormat format, uint32_t layers, std::vector<size_t> levelOffsets, std::vector<uint8_t> data, bool cubemap = false):
+        imageData(std::move(data)), resolution(resolution), channels(0), layers(layers), mipLevels(static_cast<uint32_t>(levelOffsets.size())), format(format), levelOffsets(std::move(levelOffsets)), cubemap(cubemap){
+
+    }
+
     ~VulkanImageData(){
-        
+
     }
 
-    void append(std::vector<std::vector<uint8_t>> data){
+    void append(const std::vector<std::vector<uint8_t>>& data){
 
         if(data.size() != layers){
             throw std::exception("Mismatch layers size of data");
         }
 
-        for(auto layerData : data){
+        for(const auto& layerData : data){
             if(layerData.size() != resolution.first * resolution.second * channels){
                 throw std::exception("Mismatch size of layer");
             }
@@ -40,10 +53,138 @@ public:
 
     }
 
+    // Storage of the first level to be written through getLayerData, with capacity for the given levels so generating them does not reallocate
+    void allocate(uint32_t levels = 1){
+        imageData.reserve(getMipOffset(levels));
+        imageData.resize(getMipOffset(1));
+    }
+
+    uint8_t* getLayerData(uint32_t level, uint32_t layer){
+        size_t layerSize = (getMipOffset(level + 1) - getMipOffset(level)) / layers;
+        return imageData.data() + getMipOffset(level) + layerSize * layer;
+    }
+
+    // Full chain down to 1x1 by a 2x2 box filter, only for decoded images holding just their first level
+    void generateMipmaps(){
+        if(mipLevels > 1 || !levelOffsets.empty()){
+            return;
+        }
+
+        uint32_t levels = getFullMipLevels(resolution);
+
+        for(uint32_t level = 1; level < levels; level++){
+            auto [srcWidth, srcHeight] = getMipResolution(level - 1);
+            auto [width, height] = getMipResolution(level);
+            size_t srcOffset = getMipOffset(level - 1);
+
+            imageData.resize(imageData.size() + static_cast<size_t>(width) * height * channels * layers);
+            mipLevels = level + 1;
+
+            size_t dstOffset = getMipOffset(level);
+
+            for(uint32_t layer = 0; layer < layers; layer++){
+                const uint8_t* src = imageData.data() + srcOffset + static_cast<size_t>(srcWidth) * srcHeight * channels * layer;
+                uint8_t* dst = imageData.data() + dstOffset + static_cast<size_t>(width) * height * channels * layer;
+
+                for(uint32_t y = 0; y < height; y++){
+                    uint32_t y0 = std::min(2 * y, srcHeight - 1), y1 = std::min(2 * y + 1, srcHeight - 1);
+
+                    for(uint32_t x = 0; x < width; x++){
+                        uint32_t x0 = std::min(2 * x, srcWidth - 1), x1 = std::min(2 * x + 1, srcWidth - 1);
+
+                        for(uint32_t c = 0; c < channels; c++){
+                            uint32_t sum = src[(y0 * srcWidth + x0) * channels + c] + src[(y0 * srcWidth + x1) * channels + c]
+                                + src[(y1 * srcWidth + x0) * channels + c] + src[(y1 * srcWidth + x1) * channels + c];
+
+                            dst[(y * width + x) * channels + c] = static_cast<uint8_t>((sum + 2) / 4);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Levels from baseLevel on, baseLevel becomes the first level
+    VulkanImageData mipTail(uint32_t baseLevel) const{
+        baseLevel = std::min(baseLevel, mipLevels - 1);
+
+        VulkanImageData tail(getMipResolution(baseLevel), channels, layers);
+        tail.mipLevels = mipLevels - baseLevel;
+        tail.format = format;
+        tail.cubemap = cubemap;
+        tail.imageData.assign(imageData.begin() + getMipOffset(baseLevel), imageData.end());
+
+        for(uint32_t level = baseLevel; level < levelOffsets.size(); level++){
+            tail.levelOffsets.push_back(levelOffsets[level] - levelOffsets[baseLevel]);
+        }
+
+        return tail;
+    }
+
+    // Layers of the parts one after another, e.g. the faces of a cubemap loaded from separate files
+    static VulkanImageData combineLayers(const std::vector<VulkanImageData>& parts){
+        const VulkanImageData& first = parts.front();
+
+        uint32_t layers = 0;
+        for(const auto& part : parts){
+            if(part.resolution != first.resolution || part.format != first.format || part.mipLevels != first.mipLevels){
+                throw std::runtime_error("Layers of an image differ in resolution, format or mip levels");
+            }
+            layers += part.layers;
+        }
+
+        std::vector<uint8_t> data;
+        std::vector<size_t> offsets;
+
+        for(uint32_t level = 0; level < first.mipLevels; level++){
+            offsets.push_back(data.size());
+
+            for(const auto& part : parts){
+                data.insert(data.end(), part.imageData.begin() + part.getMipOffset(level), part.imageData.begin() + part.getMipOffset(level + 1));
+            }
+        }
+
+        if(first.levelOffsets.empty()){
+            VulkanImageData combined(first.resolution, first.channels, layers);
+            combined.imageData = std::move(data);
+            combined.mipLevels = first.mipLevels;
+            combined.format = first.format;
+            return combined;
+        }
+
+        return VulkanImageData(first.resolution, first.format, layers, offsets, std::move(data));
+    }
+
+    static uint32_t getFullMipLevels(std::pair<uint32_t, uint32_t> resolution){
+        uint32_t levels = 1;
+        while((std::max(resolution.first, resolution.second) >> levels) > 0){
+            levels++;
+        }
+        return levels;
+    }
+
     std::pair<uint32_t, uint32_t> getResolution(){
         return resolution;
     }
 
+    std::pair<uint32_t, uint32_t> getMipResolution(uint32_t level) const{
+        return {std::max(resolution.first >> level, 1u), std::max(resolution.second >> level, 1u)};
+    }
+
+    // Bytes from the start of the data to the first layer of the level, mipLevels gives the end of the data
+    size_t getMipOffset(uint32_t level) const{
+        if(!levelOffsets.empty()){
+            return level < levelOffsets.size() ? levelOffsets[level] : imageData.size();
+        }
+
+        size_t offset = 0;
+        for(uint32_t i = 0; i < level; i++){
+            auto [width, height] = getMipResolution(i);
+            offset += static_cast<size_t>(width) * height * channels * layers;
+        }
+        return offset;
+    }
+
     uint32_t getChannelsNum(){
         return channels;
     }
@@ -52,14 +193,26 @@ public:
         return layers;
     }
 
+    uint32_t getMipLevelsNum(){
+        return mipLevels;
+    }
+
+    VkFormat getFormat(){
+        return format;
+    }
+
+    bool isCubemap(){
+        return cubemap;
+    }
+
     uint8_t* data(){
         return imageData.data();
     }
 
     size_t size(){
-        return resolution.first * resolution.second * channels * layers;
+        return imageData.size();
     }
 
 };
 
-}
\ No newline at end of file
+}
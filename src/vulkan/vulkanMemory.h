@@ -12,6 +12,11 @@
 #include <vector>
 #include <cstdint>
 #include <type_traits>
+#include <optional>
+#include <map>
+#include <array>
+#include <algorithm>
+#include <functional>
 
 #include "interface/vulkanDeviceI.h"
 #include "interface/vulkanBufferI.h"
@@ -27,12 +32,57 @@ namespace MSIVulkanDemo{
 
 class VulkanImage;
 
+// Device wide VMA allocator, resources of each category are placed in their own custom pools (one per memory type) with a
+// configurable block size. Once a heap's usage would pass budgetLimit of its VK_EXT_memory_budget budget, the eviction handler
+// frees GPU copies of resources first, only geometry and textures are refused when that is not enough
 class VulkanMemoryManager : public VulkanComponent<VulkanMemoryManager>{
+public:
+    enum class Category{
+        Geometry,
+        Textures,
+        Uniforms,
+        Staging,
+        RenderTargets,
+        Other // VMA default pools, e.g. storage buffers of engine features
+    };
+
+    static constexpr size_t categoryCount = 6;
+
+    static constexpr std::array<const char*, categoryCount> categoryNames = {"Geometry", "Textures", "Uniforms", "Staging", "Render targets", "Other"};
+
+    // Allocations attributed to one owner, e.g. the path of a mesh or texture resource
+    struct ownerStats{
+        std::string owner;
+        Category category;
+        uint32_t allocationCount = 0;
+        VkDeviceSize bytes = 0;
+    };
+
 private:
+    struct allocationInfo{
+        Category category;
+        std::string owner;
+    };
+
     std::shared_ptr<VulkanDeviceI> device;
 
     VmaAllocator allocator = nullptr;
 
+    std::array<VkDeviceSize, categoryCount> blockSizes = {
+        64ull * 1024 * 1024,  // Geometry
+        128ull * 1024 * 1024, // Textures
+        4ull * 1024 * 1024,   // Uniforms
+        32ull * 1024 * 1024,  // Staging
+        128ull * 1024 * 1024, // RenderTargets
+        0
+    };
+    std::map<std::pair<Category, uint32_t>, VmaPool> pools; // by memory type index
+
+    float budgetLimit = 0.9f;
+    std::function<bool(VkDeviceSize)> evictionHandler; // evicts at least the given bytes if it can, false once nothing is left
+
+    std::map<VmaAllocation, allocationInfo> allocations; // of buffers, images and transient memory
+
 public:
     VulkanMemoryManager(std::shared_ptr<VulkanDeviceI> device): device(device){
 
@@ -49,6 +99,10 @@ public:
     }
 
     ~VulkanMemoryManager(){
+        for(auto& [key, pool] : pools){
+            vmaDestroyPool(allocator, pool);
+        }
+
         if(allocator){       
             vmaDestroyAllocator(allocator);
         }
@@ -75,6 +129,231 @@ public:
         return std::make_shared<T>(shared_from_this(), args...);
     }
 
+    // Used by pools created afterwards, 0 lets VMA choose
+    void setBlockSize(Category category, VkDeviceSize size){
+        blockSizes[static_cast<size_t>(category)] = size;
+    }
+
+    VkDeviceSize getBlockSize(Category category){
+        return blockSizes[static_cast<size_t>(category)];
+    }
+
+    // Fraction of each heap's budget allocations may fill
+    void setBudgetLimit(float limit){
+        budgetLimit = std::clamp(limit, 0.0f, 1.0f);
+    }
+
+    float getBudgetLimit(){
+        return budgetLimit;
+    }
+
+    // E.g. the residency manager's least recently used eviction
+    void setEvictionHandler(std::function<bool(VkDeviceSize)> handler){
+        evictionHandler = handler;
+    }
+
+    void prepareBufferAllocation(Category category, const VkBufferCreateInfo& bufferInfo, VmaAllocationCreateInfo& allocInfo){
+        uint32_t memoryTypeIndex;
+
+        if (VkResult errCode = vmaFindMemoryTypeIndexForBufferInfo(allocator, &bufferInfo, &allocInfo, &memoryTypeIndex); errCode != VK_SUCCESS) {
+            throw std::runtime_error(std::format("failed to find buffer memory type: {}", static_cast<int>(errCode)));
+        }
+
+        prepareAllocation(category, memoryTypeIndex, bufferInfo.size, allocInfo);
+    }
+
+    // Requirements of the created image, its memory is allocated and bound afterwards
+    void prepareImageAllocation(Category category, const VkMemoryRequirements& requirements, VmaAllocationCreateInfo& allocInfo){
+        uint32_t memoryTypeIndex;
+
+        if (VkResult errCode = vmaFindMemoryTypeIndex(allocator, requirements.memoryTypeBits, &allocInfo, &memoryTypeIndex); errCode != VK_SUCCESS) {
+            throw std::runtime_error(std::format("failed to find image memory type: {}", static_cast<int>(errCode)));
+        }
+
+        prepareAllocation(category, memoryTypeIndex, requirements.size, allocInfo);
+    }
+
+    // Render targets, staging, uniform pages and engine buffers are needed to draw at all, they go over the budget rather than fail
+    void prepareAllocation(Category category, uint32_t memoryTypeIndex, VkDeviceSize size, VmaAllocationCreateInfo& allocInfo){
+        uint32_t heapIndex = getMemoryProperties().memoryTypes[memoryTypeIndex].heapIndex;
+
+        // One eviction pass, VMA keeps emptied blocks, so the space freed in the target pool counts as well as the heap usage
+        bool withinBudget = isWithinBudget(heapIndex, size);
+        if(!withinBudget && evictionHandler){
+            VmaPool pool = category == Category::Other ? VK_NULL_HANDLE : getPool(category, memoryTypeIndex);
+            VkDeviceSize usedBefore = getPoolUsage(pool);
+
+            evictionHandler(size);
+
+            withinBudget = usedBefore - getPoolUsage(pool) >= size || isWithinBudget(heapIndex, size);
+        }
+
+        if(category == Category::Geometry || category == Category::Textures){
+            if(!withinBudget){
+                throw std::runtime_error(std::format("GPU memory budget exceeded on heap {}: {} KiB requested", heapIndex, size / 1024));
+            }
+
+            allocInfo.flags |= VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+        }
+
+        if(category == Category::Other){
+            return;
+        }
+
+        allocInfo.pool = getPool(category, memoryTypeIndex);
+    }
+
+    bool isWithinBudget(uint32_t heapIndex, VkDeviceSize size){
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+        vmaGetHeapBudgets(allocator, budgets);
+
+        return budgets[heapIndex].usage + size <= budgets[heapIndex].budget * budgetLimit;
+    }
+
+    std::vector<VmaBudget> getHeapBudgets(){
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+        vmaGetHeapBudgets(allocator, budgets);
+
+        return std::vector<VmaBudget>(budgets, budgets + getMemoryProperties().memoryHeapCount);
+    }
+
+    void registerAllocation(VmaAllocation allocation, Category category, std::string owner = ""){
+        allocations.insert_or_assign(allocation, allocationInfo{category, ""});
+
+        if(!owner.empty()){
+            setAllocationOwner(allocation, owner);
+        }
+    }
+
+    void unregisterAllocation(VmaAllocation allocation){
+        allocations.erase(allocation);
+    }
+
+    // Also stored as the VMA allocation name, so it shows up in the JSON statistics
+    void setAllocationOwner(VmaAllocation allocation, std::string owner){
+        if(auto info = allocations.find(allocation); info != allocations.end()){
+            info->second.owner = owner;
+        }
+
+        vmaSetAllocationName(allocator, allocation, owner.c_str());
+    }
+
+    // Allocation count and bytes of each category, all registered allocations including Other and transient memory
+    std::array<VmaStatistics, categoryCount> getAllocationStatistics(){
+        std::array<VmaStatistics, categoryCount> stats = {};
+
+        for(const auto& [allocation, info] : allocations){
+            VmaAllocationInfo vmaInfo;
+            vmaGetAllocationInfo(allocator, allocation, &vmaInfo);
+
+            auto& categoryStats = stats[static_cast<size_t>(info.category)];
+            categoryStats.allocationCount++;
+            categoryStats.allocationBytes += vmaInfo.size;
+        }
+
+        return stats;
+    }
+
+    // Biggest first, allocations without an owner are grouped by category
+    std::vector<ownerStats> getOwnerStatistics(){
+        std::map<std::pair<std::string, Category>, ownerStats> owners;
+
+        for(const auto& [allocation, info] : allocations){
+            VmaAllocationInfo vmaInfo;
+            vmaGetAllocationInfo(allocator, allocation, &vmaInfo);
+
+            std::string owner = info.owner.empty() ? std::format("({})", categoryNames[static_cast<size_t>(info.category)]) : info.owner;
+
+            auto& stats = owners[{owner, info.category}];
+            stats.owner = owner;
+            stats.category = info.category;
+            stats.allocationCount++;
+            stats.bytes += vmaInfo.size;
+        }
+
+        std::vector<ownerStats> sorted;
+        for(auto& [key, stats] : owners){
+            sorted.push_back(stats);
+        }
+
+        std::sort(sorted.begin(), sorted.end(), [](const ownerStats& a, const ownerStats& b){
+            return a.bytes > b.bytes;
+        });
+
+        return sorted;
+    }
+
+    // VMA statistics with the detailed map of every block and named allocation
+    std::string getStatsJson(){
+        char* statsString = nullptr;
+        vmaBuildStatsString(allocator, &statsString, VK_TRUE);
+
+        std::string json(statsString);
+        vmaFreeStatsString(allocator, statsString);
+
+        return json;
+    }
+
+    // Summed over the category's pools, Other is not tracked separately
+    VmaStatistics getCategoryStatistics(Category category){
+        VmaStatistics total = {};
+
+        for(auto& [key, pool] : pools){
+            if(key.first != category){
+                continue;
+            }
+
+            VmaStatistics stats;
+            vmaGetPoolStatistics(allocator, pool, &stats);
+
+            total.blockCount += stats.blockCount;
+            total.allocationCount += stats.allocationCount;
+            total.blockBytes += stats.blockBytes;
+            total.allocationBytes += stats.allocationBytes;
+        }
+
+        return total;
+    }
+
+    const VkPhysicalDeviceMemoryProperties& getMemoryProperties(){
+        const VkPhysicalDeviceMemoryProperties* properties;
+        vmaGetMemoryProperties(allocator, &properties);
+
+        return *properties;
+    }
+
+private:
+
+    // Bytes allocated from the pool, 0 without one
+    VkDeviceSize getPoolUsage(VmaPool pool){
+        if(!pool){
+            return 0;
+        }
+
+        VmaStatistics stats;
+        vmaGetPoolStatistics(allocator, pool, &stats);
+        return stats.allocationBytes;
+    }
+
+    VmaPool getPool(Category category, uint32_t memoryTypeIndex){
+        if(auto pool = pools.find({category, memoryTypeIndex}); pool != pools.end()){
+            return pool->second;
+        }
+
+        VmaPoolCreateInfo poolInfo = {};
+        poolInfo.memoryTypeIndex = memoryTypeIndex;
+        poolInfo.blockSize = blockSizes[static_cast<size_t>(category)];
+
+        VmaPool pool;
+        if (VkResult errCode = vmaCreatePool(allocator, &poolInfo, &pool); errCode != VK_SUCCESS) {
+            throw std::runtime_error(std::format("failed to create memory pool: {}", static_cast<int>(errCode)));
+        }
+
+        pools.insert({{category, memoryTypeIndex}, pool});
+
+        return pool;
+    }
+
 };
 
 class VulkanBuffer : public VulkanComponent<VulkanBuffer>, public VulkanBufferI{
@@ -87,7 +366,7 @@ protected:
     VmaAllocationInfo allocationInfo = {};
 
 public:
-    VulkanBuffer(std::shared_ptr<VulkanMemoryManager> allocator, VkDeviceSize size, VkBufferUsageFlags usage, VmaAllocationCreateFlags properties): allocator(allocator), size(size){
+    VulkanBuffer(std::shared_ptr<VulkanMemoryManager> allocator, VkDeviceSize size, VkBufferUsageFlags usage, VmaAllocationCreateFlags properties, VulkanMemoryManager::Category category = VulkanMemoryManager::Category::Other): allocator(allocator), size(size){
 
         VkBufferCreateInfo bufferInfo = {};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -98,18 +377,28 @@ public:
         VmaAllocationCreateInfo allocInfo = {};
         allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
         allocInfo.flags = properties;
+
+        allocator->prepareBufferAllocation(category, bufferInfo, allocInfo);
         
         if (VkResult errCode = vmaCreateBuffer(*allocator, &bufferInfo, &allocInfo, &buffer, &allocation, &allocationInfo); errCode != VK_SUCCESS) {
             throw std::runtime_error(std::format("failed to create Buffer: {}", static_cast<int>(errCode)));
         }
+
+        allocator->registerAllocation(allocation, category);
     }
 
     ~VulkanBuffer(){
         if(buffer && allocation){
+            allocator->unregisterAllocation(allocation);
             vmaDestroyBuffer(*allocator, buffer, allocation);
         }
     }
 
+    // Attributes the memory to e.g. the resource path in the memory statistics
+    void setOwner(std::string owner){
+        allocator->setAllocationOwner(allocation, owner);
+    }
+
     operator VkBuffer() const{
         return buffer;
     }
@@ -136,7 +425,7 @@ class VulkanStagingBuffer : public VulkanBuffer{
 private:
 
 public:
-    VulkanStagingBuffer(std::shared_ptr<VulkanMemoryManager> allocator, V* data, size_t size): VulkanBuffer(allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT){
+    VulkanStagingBuffer(std::shared_ptr<VulkanMemoryManager> allocator, V* data, size_t size): VulkanBuffer(allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VulkanMemoryManager::Category::Staging){
 
         vmaCopyMemoryToAllocation(*allocator, static_cast<void*>(data), allocation, 0, size);
 
@@ -157,7 +446,7 @@ private:
     uint32_t vertexCount;
     
 public:
-    VulkanVertexBuffer(std::shared_ptr<VulkanMemoryManager> allocator, VulkanVertexData& vertices): VulkanBuffer(allocator, vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT), vertexCount(vertices.getVertexCount()){
+    VulkanVertexBuffer(std::shared_ptr<VulkanMemoryManager> allocator, VulkanVertexData& vertices): VulkanBuffer(allocator, vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0, VulkanMemoryManager::Category::Geometry), vertexCount(vertices.getVertexCount()){
         
         VulkanStagingBuffer<float> stagingBuffer(allocator, vertices.data(), vertices.size());
         copyBuffer(stagingBuffer, *this, this->getSize());
@@ -184,7 +473,7 @@ private:
     uint32_t indexCount;
     
 public:
-    VulkanIndexBuffer(std::shared_ptr<VulkanMemoryManager> allocator, VulkanVertexData& vertices): VulkanBuffer(allocator, vertices.getIndicesSize(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT), indexCount(vertices.getIndicesCount()){
+    VulkanIndexBuffer(std::shared_ptr<VulkanMemoryManager> allocator, VulkanVertexData& vertices): VulkanBuffer(allocator, vertices.getIndicesSize(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0, VulkanMemoryManager::Category::Geometry), indexCount(vertices.getIndicesCount()){
 
         if(!vertices.hasIndices()){
             throw std::runtime_error("Vertices had to have indices");
@@ -209,17 +498,14 @@ public:
 
 
 
+// Page of uniform data of descriptor sets, ranges are handed out first fit and merged back when freed
 class VulkanUniformBuffer : public VulkanBuffer{
     private:
-        std::shared_ptr<VulkanDescriptorPool> descriptorPool;
+        std::map<size_t, size_t> freeRanges; // offset, size
 
-        std::vector<std::shared_ptr<VulkanDescriptorSet>> descriptorSet;
-        std::shared_ptr<VulkanDescriptorSet> bindedDescriptorSet;
-        size_t bufferSize = 0;
-        
     public:
-        VulkanUniformBuffer(std::shared_ptr<VulkanMemoryManager> allocator, std::shared_ptr<VulkanDescriptorPool> descriptorPool, size_t size): VulkanBuffer(allocator, size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,  VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT), descriptorPool(descriptorPool){
-            
+        VulkanUniformBuffer(std::shared_ptr<VulkanMemoryManager> allocator, size_t size): VulkanBuffer(allocator, size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,  VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, VulkanMemoryManager::Category::Uniforms){
+            freeRanges.insert({0, size});
         }
     
         ~VulkanUniformBuffer(){}
@@ -228,65 +514,306 @@ class VulkanUniformBuffer : public VulkanBuffer{
             throw std::runtime_error("Bind uniform buffer by binding descriptor set");
         }
 
-        void bindDescriptorSet(VulkanCommandBufferI& commandBuffer, std::shared_ptr<VulkanGraphicsPipeline> graphicsPipeline, std::vector<std::shared_ptr<VulkanDescriptorSet>> uniformSet){
+        // Sizes of uniform data are multiples of the minimum uniform buffer offset, so every range stays aligned
+        std::optional<size_t> allocate(size_t rangeSize){
+            for(auto range = freeRanges.begin(); range != freeRanges.end(); range++){
+                if(range->second < rangeSize){
+                    continue;
+                }
+
+                auto [offset, freeSize] = *range;
+                freeRanges.erase(range);
+
+                if(freeSize > rangeSize){
+                    freeRanges.insert({offset + rangeSize, freeSize - rangeSize});
+                }
+
+                return offset;
+            }
+
+            return std::nullopt;
+        }
 
-            VkDescriptorSet sets[1];
+        void free(size_t offset, size_t rangeSize){
+            auto range = freeRanges.insert({offset, rangeSize}).first;
+
+            if(auto next = std::next(range); next != freeRanges.end() && range->first + range->second == next->first){
+                range->second += next->second;
+                freeRanges.erase(next);
+            }
+
+            if(range != freeRanges.begin()){
+                if(auto prev = std::prev(range); prev->first + prev->second == range->first){
+                    prev->second += range->second;
+                    freeRanges.erase(range);
+                }
+            }
+        }
+
+        bool isEmpty() const{
+            return freeRanges.size() == 1 && freeRanges.begin()->second == size;
+        }
+
+        void uploadData(size_t offset, const void* data, size_t dataSize){
+            if(offset + dataSize > size){
+                throw std::runtime_error(std::format("Uniform buffer upload out of range: {} > {}", offset + dataSize, size));
+            }
+
+            if (VkResult errCode = vmaCopyMemoryToAllocation(*allocator, data, allocation, offset, dataSize); errCode != VK_SUCCESS) {
+                throw std::runtime_error(std::format("failed to upload uniform buffer: {}", static_cast<int>(errCode)));
+            }
+        }
+    
+    };
+
+
+// Uniform data and descriptor sets of one command buffer, grows by chaining pages and pools,
+// ranges of released sets are reclaimed when the command buffer is reset, its previous submission has finished by then
+class VulkanUniformAllocator{
+    public:
+        static constexpr size_t pageSize = 256 * 1024;
+        static constexpr uint32_t setsPerPool = 256;
+
+        struct memoryStats{
+            uint32_t pages = 0;
+            uint32_t descriptorSets = 0;
+            size_t capacity = 0;
+            size_t used = 0;
+            size_t highWater = 0; // most used at once since creation
+        };
+
+    private:
+        struct allocation{
+            std::weak_ptr<VulkanDescriptorSet> set;
+            VkDescriptorSet handle;
+            std::shared_ptr<VulkanDescriptorPool> descriptorPool;
+            std::shared_ptr<VulkanUniformBuffer> page;
+            size_t offset;
+            size_t size;
+        };
+
+        std::shared_ptr<VulkanMemoryManager> memoryManager;
+
+        std::vector<std::shared_ptr<VulkanUniformBuffer>> pages;
+        std::vector<std::pair<std::shared_ptr<VulkanDescriptorPool>, uint32_t>> descriptorPools; // with count of live sets
+        std::map<VulkanDescriptorSet*, allocation> allocations;
+
+        std::shared_ptr<VulkanDescriptorSet> bindedDescriptorSet;
+        allocation* bindedAllocation = nullptr;
+
+        memoryStats stats;
+
+    public:
+        VulkanUniformAllocator(std::shared_ptr<VulkanMemoryManager> memoryManager): memoryManager(memoryManager){
+            addPage(pageSize);
+        }
+
+        // Frame, material and bindless sets in one call, push constant ranges differ between pipelines so earlier bound sets can be disturbed
+        void bindDescriptorSet(VulkanCommandBufferI& commandBuffer, std::shared_ptr<VulkanGraphicsPipeline> graphicsPipeline, std::shared_ptr<VulkanDescriptorSet> frameSet, std::vector<std::shared_ptr<VulkanDescriptorSet>> uniformSet){
+
+            VkDescriptorSet sets[3];
+            uint32_t setCount = 2;
+
+            sets[VulkanFrameData::frameSet] = *frameSet;
 
             for(auto uniform : uniformSet){
-                if(std::find(descriptorSet.begin(), descriptorSet.end(), uniform) != descriptorSet.end()){
+                if(auto found = allocations.find(uniform.get()); found != allocations.end()){
                     bindedDescriptorSet = uniform;
-                    sets[0] = {*uniform}; //TODO to map
+                    bindedAllocation = &found->second;
+                    sets[VulkanFrameData::materialSet] = {*uniform}; //TODO to map
                     break;
                 }
             }
 
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *graphicsPipeline, 0, 1, sets, 0, nullptr);
+            if(auto bindlessTextures = graphicsPipeline->getBindlessTextures(); bindlessTextures){
+                sets[VulkanBindlessTextures::set] = *bindlessTextures;
+                setCount++;
+            }
+
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *graphicsPipeline, 0, setCount, sets, 0, nullptr);
         }
 
+        std::shared_ptr<VulkanDescriptorSet> getBindedDescriptorSet(){
+            return bindedDescriptorSet;
+        }
+
+        // Released sets are reclaimed by collect when the command buffer is reset, not here, sets may be created while it records
         std::shared_ptr<VulkanDescriptorSet> createDescriptorSet(const VulkanUniformData& uniformData){
+            size_t size = uniformData.getSize();
+            auto [page, offset] = allocateRange(size);
+            auto& [descriptorPool, poolSets] = getDescriptorPool();
+
+            auto set = descriptorPool->getDescriptorSet(uniformData, page, offset);
 
-            auto set = descriptorPool->getDescriptorSet(uniformData, shared_from_this(), bufferSize);
-            descriptorSet.push_back(set);
-            bufferSize += uniformData.getSize();
+            allocations.insert({set.get(), {set, *set, descriptorPool, page, offset, size}});
+            poolSets++;
+
+            stats.descriptorSets++;
+            stats.used += size;
+            stats.highWater = std::max(stats.highWater, stats.used);
 
             return set;
         }
 
+        // Offset in the bound set's uniform data
+        void uploadData(size_t offset, const void* data, size_t dataSize){
+            if(!bindedAllocation){
+                throw std::runtime_error("Need to bind descriptor set first");
+            }
+
+            if(offset + dataSize > bindedAllocation->size){
+                throw std::runtime_error(std::format("Uniform data upload out of range: {} > {}", offset + dataSize, bindedAllocation->size));
+            }
+
+            bindedAllocation->page->uploadData(bindedAllocation->offset + offset, data, dataSize);
+        }
+
         template<typename T>
         void uploadData(size_t offset, T& val){
-            
-            VkMemoryPropertyFlags memPropFlags;
-            vmaGetAllocationMemoryProperties(*allocator, allocation, &memPropFlags);
+            uploadData(offset, static_cast<void*>(&val), sizeof(T));
+        }
+
+        void uploadData(size_t offset, std::vector<float> val){
+            if(val.size() <= 0){
+                throw std::runtime_error("Value need to have data");
+            }
+
+            uploadData(offset, static_cast<void*>(val.data()), val.size() * sizeof(float));
+        }
+
+        // Frees ranges and descriptor sets nobody holds anymore, only while no submission of the owning command buffer is pending
+        void collect(){
+            bindedDescriptorSet.reset();
+            bindedAllocation = nullptr;
+
+            std::erase_if(allocations, [&](auto& entry){
+                auto& [key, alloc] = entry;
+                if(!alloc.set.expired()){
+                    return false;
+                }
+
+                if(alloc.size > 0){
+                    alloc.page->free(alloc.offset, alloc.size);
+                }
+
+                vkFreeDescriptorSets(alloc.descriptorPool->getDevice(), *alloc.descriptorPool, 1, &alloc.handle);
+
+                for(auto& [descriptorPool, poolSets] : descriptorPools){
+                    if(descriptorPool == alloc.descriptorPool){
+                        poolSets--;
+                    }
+                }
 
-            if(memPropFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT){
+                stats.descriptorSets--;
+                stats.used -= alloc.size;
 
-                vmaCopyMemoryToAllocation(*allocator, static_cast<void*>(&val), allocation, bindedDescriptorSet->getOffset() + offset, sizeof(T));
-            
-            }else{
-                throw std::runtime_error("Nieeeee");
+                return true;
+            });
+
+            // The first page and pool stay for the next sets, the others go once empty
+            auto firstPage = pages.front();
+            std::erase_if(pages, [&](auto& page){
+                if(page != firstPage && page->isEmpty() && page.use_count() == 1){
+                    stats.pages--;
+                    stats.capacity -= page->getSize();
+                    return true;
+                }
+                return false;
+            });
+
+            if(!descriptorPools.empty()){
+                auto firstPool = descriptorPools.front().first;
+                std::erase_if(descriptorPools, [&](auto& pool){
+                    return pool.first != firstPool && pool.second == 0 && pool.first.use_count() == 1;
+                });
             }
+        }
 
+        memoryStats getStats(){
+            return stats;
         }
 
-        void uploadData(size_t offset, std::vector<float> val){
-            
-            VkMemoryPropertyFlags memPropFlags;
-            vmaGetAllocationMemoryProperties(*allocator, allocation, &memPropFlags);
+    private:
 
-            if(val.size() <= 0){
-                throw std::runtime_error("Value need to have data");
+        std::pair<std::shared_ptr<VulkanUniformBuffer>, size_t> allocateRange(size_t size){
+            if(size == 0){
+                return {pages.front(), 0};
+            }
+
+            for(auto& page : pages){
+                if(auto offset = page->allocate(size); offset){
+                    return {page, *offset};
+                }
             }
 
-            if(memPropFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT){
+            auto page = addPage(std::max(pageSize, size));
 
-                vmaCopyMemoryToAllocation(*allocator, static_cast<void*>(val.data()), allocation, bindedDescriptorSet->getOffset() + offset, val.size() * sizeof(float));
-            
-            }else{
-                throw std::runtime_error("Nieeeee");
+            return {page, *page->allocate(size)};
+        }
+
+        std::shared_ptr<VulkanUniformBuffer> addPage(size_t size){
+            auto page = memoryManager->createBuffer<VulkanUniformBuffer>(size);
+            pages.push_back(page);
+
+            stats.pages++;
+            stats.capacity += size;
+
+            return page;
+        }
+
+        std::pair<std::shared_ptr<VulkanDescriptorPool>, uint32_t>& getDescriptorPool(){
+            for(auto& pool : descriptorPools){
+                if(pool.second < setsPerPool){
+                    return pool;
+                }
             }
 
+            descriptorPools.push_back({std::make_shared<VulkanDescriptorPool>(memoryManager->getDevice(), std::vector<std::pair<VkDescriptorType, uint32_t>>{
+                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4 * setsPerPool},
+                {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8 * setsPerPool},
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * setsPerPool}
+            }, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT), 0});
+
+            return descriptorPools.back();
+        }
+
+    };
+
+
+
+// Host written buffers are mapped and updated directly, device local ones are written by shaders
+class VulkanStorageBuffer : public VulkanBuffer{
+    public:
+        VulkanStorageBuffer(std::shared_ptr<VulkanMemoryManager> allocator, size_t size, bool hostWritten = true, VkBufferUsageFlags extraUsage = 0): VulkanBuffer(allocator, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | extraUsage, hostWritten ? (VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT) : 0){
+
+        }
+
+        ~VulkanStorageBuffer(){}
+
+        void bind(VulkanCommandBufferI& commandBuffer) const{
+            throw std::runtime_error("Bind storage buffer by binding descriptor set");
+        }
+
+        void uploadData(size_t offset, const void* data, size_t dataSize){
+            if(offset + dataSize > size){
+                throw std::runtime_error(std::format("Storage buffer upload out of range: {} > {}", offset + dataSize, size));
+            }
+
+            if (VkResult errCode = vmaCopyMemoryToAllocation(*allocator, data, allocation, offset, dataSize); errCode != VK_SUCCESS) {
+                throw std::runtime_error(std::format("failed to upload storage buffer: {}", static_cast<int>(errCode)));
+            }
+        }
+
+        // Host written buffers only, e.g. counters written by shaders and read after the frame fence
+        void downloadData(size_t offset, void* data, size_t dataSize){
+            if(offset + dataSize > size){
+                throw std::runtime_error(std::format("Storage buffer download out of range: {} > {}", offset + dataSize, size));
+            }
+
+            if (VkResult errCode = vmaCopyAllocationToMemory(*allocator, allocation, offset, data, dataSize); errCode != VK_SUCCESS) {
+                throw std::runtime_error(std::format("failed to download storage buffer: {}", static_cast<int>(errCode)));
+            }
         }
-    
     };
 
 
@@ -302,14 +829,17 @@ private:
 
     VkImage image = nullptr;
     VmaAllocation allocation = nullptr;
-    VkDeviceSize size = 0; // TODO
+    VkDeviceSize size = 0;
     VmaAllocationInfo allocationInfo = {};
     VkFormat format;
     VkImageCreateInfo imageInfo = {};
     VmaAllocationCreateInfo allocInfo = {};
     VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VulkanMemoryManager::Category category = VulkanMemoryManager::Category::RenderTargets;
+    std::string owner; // kept across resize
 
     bool isSwapChainImage = false;
+    bool ownsAllocation = true;
 
     std::vector<std::weak_ptr<VulkanImageView>> imageViews;
 
@@ -321,16 +851,19 @@ public:
         VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
         VmaAllocationCreateFlags properties = 0;
         VkImageCreateFlags flags = 0;
+        bool deferAllocation = false; // image is created unbound, memory is bound later with bindMemory
+        uint32_t mipLevels = 1;
+        VulkanMemoryManager::Category category = VulkanMemoryManager::Category::RenderTargets;
     };
 
-    VulkanImage(std::shared_ptr<VulkanMemoryManager> allocator, std::pair<uint32_t, uint32_t> resolution, constructParameters params = constructParameters()): allocator(allocator), resolution(resolution), format(params.format){
+    VulkanImage(std::shared_ptr<VulkanMemoryManager> allocator, std::pair<uint32_t, uint32_t> resolution, constructParameters params = constructParameters()): allocator(allocator), resolution(resolution), format(params.format), category(params.category), ownsAllocation(!params.deferAllocation){
         
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
         imageInfo.extent.width = resolution.first;
         imageInfo.extent.height = resolution.second;
         imageInfo.extent.depth = 1;
-        imageInfo.mipLevels = 1;
+        imageInfo.mipLevels = params.mipLevels;
         imageInfo.arrayLayers = params.layers;
         imageInfo.format = format;
         imageInfo.tiling = params.tiling;
@@ -347,7 +880,7 @@ public:
         allocInfo.flags = params.properties;
         //allocInfo.memoryTypeBits = memRequirements.memoryTypeBits;
 
-        vmaCreateImage(*allocator, &imageInfo, &allocInfo, &image, &allocation, &allocationInfo);
+        createImage();
     }
 
     VulkanImage(std::shared_ptr<VulkanDeviceI> device, VkImage image, VkFormat format): isSwapChainImage(true), image(image), device(device), format(format){
@@ -355,9 +888,7 @@ public:
     }
 
     ~VulkanImage(){
-        if(image && allocator){
-            vmaDestroyImage(*allocator, image, allocation);
-        }
+        destroyImage();
     }
 
     operator VkImage() const{
@@ -368,6 +899,30 @@ public:
         return format;
     }
 
+    VkImageAspectFlags getAspectMask(){
+        switch(format){
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+    }
+
+    uint32_t getArrayLayers(){
+        return imageInfo.arrayLayers;
+    }
+
+    uint32_t getMipLevels(){
+        return imageInfo.mipLevels;
+    }
+
     std::shared_ptr<VulkanDeviceI> getDevice(){
         if(isSwapChainImage){
             return device;
@@ -394,14 +949,48 @@ public:
     }
 
     void resize(std::pair<uint32_t, uint32_t> resolution){
-        if(image && allocator){
-            vmaDestroyImage(*allocator, image, allocation);
-        }
+        destroyImage();
 
+        this->resolution = resolution;
         imageInfo.extent.width = resolution.first;
-        imageInfo.extent.height = resolution.first;
+        imageInfo.extent.height = resolution.second;
+
+        createImage();
+    }
+
+    std::pair<uint32_t, uint32_t> getResolution(){
+        return resolution;
+    }
 
-        vmaCreateImage(*allocator, &imageInfo, &allocInfo, &image, &allocation, &allocationInfo);
+    // Bytes of the image's own allocation, 0 for swapchain images and images bound to external memory
+    VkDeviceSize getSize(){
+        return size;
+    }
+
+    // Attributes the memory to e.g. the resource path in the memory statistics
+    void setOwner(std::string owner){
+        this->owner = owner;
+
+        if(ownsAllocation && allocation){
+            allocator->setAllocationOwner(allocation, owner);
+        }
+    }
+
+    VkMemoryRequirements getMemoryRequirements(){
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(*allocator->getDevice(), image, &memRequirements);
+
+        return memRequirements;
+    }
+
+    void bindMemory(VmaAllocation memory, VkDeviceSize offset = 0){
+        if(ownsAllocation){
+            throw std::runtime_error("Only images created with deferred allocation can be bound to external memory");
+        }
+
+        if (VkResult errCode = vmaBindImageMemory2(*allocator, memory, offset, image, nullptr); errCode != VK_SUCCESS) {
+            throw std::runtime_error(std::format("failed to bind image memory: {}", static_cast<int>(errCode)));
+        }
     }
 
     void transitionImageLayout(VkImageLayout newLayout){
@@ -415,9 +1004,9 @@ public:
         barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
         barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
         barrier.image = image;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.aspectMask = getAspectMask();
         barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.levelCount = imageInfo.mipLevels;
         barrier.subresourceRange.baseArrayLayer = 0;
         barrier.subresourceRange.layerCount = imageInfo.arrayLayers;
 
@@ -436,6 +1025,33 @@ public:
 
             srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
             dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        } else if (layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+            // Layers of texture arrays written after the first upload
+            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+            srcStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        } else if (layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+            // Texture arrays copied into a bigger image
+            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+            srcStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        } else if (layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+            srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        } else if (layout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+            // Render targets sampled before they are first written
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+            srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
         } else {
             throw std::invalid_argument("unsupported layout transition!");
         }
@@ -448,31 +1064,118 @@ public:
         layout = newLayout;
     }
 
-    void copyBufferToImage(VulkanBuffer& srcBuffer, VulkanImage& dstImage){
+    // One region per mip level, levelOffsets are where the levels start in the buffer, layerCount 0 copies all layers from baseLayer on
+    void copyBufferToImage(VulkanBuffer& srcBuffer, VulkanImage& dstImage, std::vector<VkDeviceSize> levelOffsets = {0}, uint32_t baseLayer = 0, uint32_t layerCount = 0){
         std::shared_ptr<VulkanCommandBufferI> commandBuffer = std::dynamic_pointer_cast<VulkanCommandBufferI>(allocator->getDevice()->createCommandBuffer());
         commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
-        VkBufferImageCopy region{};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = imageInfo.arrayLayers;
-
-        region.imageOffset = {0, 0, 0};
-        region.imageExtent = {
-            resolution.first,
-            resolution.second,
-            1
-        };
+        for(uint32_t level = 0; level < levelOffsets.size(); level++){
+            VkBufferImageCopy region{};
+            region.bufferOffset = levelOffsets[level];
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = baseLayer;
+            region.imageSubresource.layerCount = layerCount > 0 ? layerCount : imageInfo.arrayLayers - baseLayer;
+
+            region.imageOffset = {0, 0, 0};
+            region.imageExtent = {
+                std::max(resolution.first >> level, 1u),
+                std::max(resolution.second >> level, 1u),
+                1
+            };
+
+            commandBuffer->copyBufferToImage(srcBuffer, dstImage, region);
+        }
+
+        commandBuffer->end();
+        commandBuffer->submit();
+    }
+
+    // Levels from srcBaseMip on of layerCount layers into all levels of dstImage, which has the format and the resolution of level srcBaseMip
+    // and has to be in TRANSFER_DST layout
+    void copyLayersToImage(VulkanImage& dstImage, uint32_t baseLayer, uint32_t layerCount, uint32_t srcBaseMip = 0){
+        transitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+        std::shared_ptr<VulkanCommandBufferI> commandBuffer = std::dynamic_pointer_cast<VulkanCommandBufferI>(allocator->getDevice()->createCommandBuffer());
+        commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
-        commandBuffer->copyBufferToImage(srcBuffer, dstImage, region);
+        for(uint32_t level = 0; level < dstImage.getMipLevels(); level++){
+            VkImageCopy region{};
+            region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, srcBaseMip + level, baseLayer, layerCount};
+            region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, baseLayer, layerCount};
+            region.extent = {
+                std::max(dstImage.getResolution().first >> level, 1u),
+                std::max(dstImage.getResolution().second >> level, 1u),
+                1
+            };
+
+            commandBuffer->copyImage(*this, dstImage, region);
+        }
 
         commandBuffer->end();
         commandBuffer->submit();
+
+        transitionImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+private:
+
+    void createImage(){
+        if(ownsAllocation){
+            // Created first, so the budget is checked and evicted for with the image's real size
+            if (VkResult errCode = vkCreateImage(*allocator->getDevice(), &imageInfo, nullptr, &image); errCode != VK_SUCCESS) {
+                throw std::runtime_error(std::format("failed to create image: {}", static_cast<int>(errCode)));
+            }
+
+            VkMemoryRequirements requirements;
+            vkGetImageMemoryRequirements(*allocator->getDevice(), image, &requirements);
+
+            try{
+                VmaAllocationCreateInfo imageAllocInfo = allocInfo;
+                allocator->prepareImageAllocation(category, requirements, imageAllocInfo);
+
+                if (VkResult errCode = vmaAllocateMemoryForImage(*allocator, image, &imageAllocInfo, &allocation, &allocationInfo); errCode != VK_SUCCESS) {
+                    throw std::runtime_error(std::format("failed to allocate image memory: {}", static_cast<int>(errCode)));
+                }
+            }catch(...){
+                vkDestroyImage(*allocator->getDevice(), image, nullptr);
+                image = VK_NULL_HANDLE;
+                throw;
+            }
+
+            if (VkResult errCode = vmaBindImageMemory(*allocator, allocation, image); errCode != VK_SUCCESS) {
+                vmaDestroyImage(*allocator, image, allocation);
+                image = VK_NULL_HANDLE;
+                throw std::runtime_error(std::format("failed to bind image memory: {}", static_cast<int>(errCode)));
+            }
+
+            allocator->registerAllocation(allocation, category, owner);
+            size = allocationInfo.size;
+            return;
+        }
+
+        if (VkResult errCode = vkCreateImage(*allocator->getDevice(), &imageInfo, nullptr, &image); errCode != VK_SUCCESS) {
+            throw std::runtime_error(std::format("failed to create image: {}", static_cast<int>(errCode)));
+        }
+    }
+
+    void destroyImage(){
+        if(!image || !allocator){
+            return;
+        }
+
+        if(ownsAllocation){
+            allocator->unregisterAllocation(allocation);
+            vmaDestroyImage(*allocator, image, allocation);
+        }else{
+            vkDestroyImage(*allocator->getDevice(), image, nullptr);
+        }
+
+        image = nullptr;
+        size = 0;
     }
 
 };
@@ -499,22 +1202,35 @@ public:
         textureType type,
         VkFormat format = VK_FORMAT_R8G8B8A8_SRGB,
         VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL,
-        VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, // source of mip tails
         VmaAllocationCreateFlags properties = 0
-    ): VulkanImage(allocator, imageData.getResolution(), {.layers = imageData.getLayersNum(), .format = format, .tiling = tiling, .usage = usage, .properties = properties, .flags = (type == Cubemap ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : static_cast<VkImageCreateFlags>(0))}), texType(type){
+    ): VulkanImage(allocator, imageData.getResolution(), {.layers = imageData.getLayersNum(), .format = format, .tiling = tiling, .usage = usage, .properties = properties, .flags = (type == Cubemap ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : static_cast<VkImageCreateFlags>(0)), .mipLevels = imageData.getMipLevelsNum(), .category = VulkanMemoryManager::Category::Textures}), texType(type){
         
         if(imageData.size() <= 0){
             throw std::runtime_error("Image had to have data");
         }
 
         VulkanStagingBuffer<uint8_t> stagingBuffer(allocator, imageData.data(), imageData.size());
+
+        std::vector<VkDeviceSize> levelOffsets;
+        for(uint32_t level = 0; level < imageData.getMipLevelsNum(); level++){
+            levelOffsets.push_back(imageData.getMipOffset(level));
+        }
         
         transitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        copyBufferToImage(stagingBuffer, *this);
+        copyBufferToImage(stagingBuffer, *this, levelOffsets);
         transitionImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
     }
 
+    // Levels from baseMip on of another texture, copied on the GPU, baseMip has to be below its level count
+    VulkanTexture(std::shared_ptr<VulkanMemoryManager> allocator, VulkanTexture& source, uint32_t baseMip): VulkanImage(allocator, {std::max(source.getResolution().first >> baseMip, 1u), std::max(source.getResolution().second >> baseMip, 1u)}, {.layers = source.getArrayLayers(), .format = source.getFormat(), .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, .flags = (source.getType() == Cubemap ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : static_cast<VkImageCreateFlags>(0)), .mipLevels = source.getMipLevels() - baseMip, .category = VulkanMemoryManager::Category::Textures}), texType(source.getType()){
+
+        transitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        source.copyLayersToImage(*this, 0, source.getArrayLayers(), baseMip);
+        transitionImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
     ~VulkanTexture(){}
 
     textureType getType(){
@@ -537,7 +1253,7 @@ private:
     VkImageViewCreateInfo createInfo = {};
 
 public:
-    VulkanImageView(std::shared_ptr<VulkanImage> image, VkImageAspectFlags aspectFlags = VK_IMAGE_ASPECT_COLOR_BIT, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D, uint32_t layerCount = 1): image(image){
+    VulkanImageView(std::shared_ptr<VulkanImage> image, VkImageAspectFlags aspectFlags = VK_IMAGE_ASPECT_COLOR_BIT, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D, uint32_t layerCount = 1, uint32_t baseLayer = 0, uint32_t baseMip = 0, uint32_t mipCount = 1): image(image){
         
         createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         createInfo.image = *image;
@@ -550,9 +1266,9 @@ public:
         createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
 
         createInfo.subresourceRange.aspectMask = aspectFlags;
-        createInfo.subresourceRange.baseMipLevel = 0;
-        createInfo.subresourceRange.levelCount = 1;
-        createInfo.subresourceRange.baseArrayLayer = 0;
+        createInfo.subresourceRange.baseMipLevel = baseMip;
+        createInfo.subresourceRange.levelCount = mipCount;
+        createInfo.subresourceRange.baseArrayLayer = baseLayer;
         createInfo.subresourceRange.layerCount = layerCount;
 
         if(VkResult errCode = vkCreateImageView(*image->getDevice(), &createInfo, nullptr, &imageView); errCode != VK_SUCCESS) {
@@ -577,9 +1293,18 @@ public:
     void resize(std::pair<uint32_t, uint32_t> resolution){
         if(imageView){
             vkDestroyImageView(*image->getDevice(), imageView, nullptr);
+            imageView = nullptr;
         }
         
         image->resize(resolution);
+        recreate();
+    }
+
+    void recreate(){
+        if(imageView){
+            vkDestroyImageView(*image->getDevice(), imageView, nullptr);
+        }
+
         createInfo.image = *image;
 
         if (VkResult errCode = vkCreateImageView(*image->getDevice(), &createInfo, nullptr, &imageView); errCode != VK_SUCCESS) {
@@ -587,6 +1312,10 @@ public:
         }
     }
 
+    std::shared_ptr<VulkanImage> getImage(){
+        return image;
+    }
+
 };
 
 
@@ -594,7 +1323,7 @@ public:
 class VulkanTextureView: public VulkanImageView{
     
 public:
-    VulkanTextureView(std::shared_ptr<VulkanTexture> texture): VulkanImageView(std::static_pointer_cast<VulkanImage>(texture), VK_IMAGE_ASPECT_COLOR_BIT, (texture->getType() == VulkanTexture::Cubemap ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D), (texture->getType() == VulkanTexture::Cubemap ? 6 : 1)){
+    VulkanTextureView(std::shared_ptr<VulkanTexture> texture): VulkanImageView(std::static_pointer_cast<VulkanImage>(texture), VK_IMAGE_ASPECT_COLOR_BIT, (texture->getType() == VulkanTexture::Cubemap ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D), (texture->getType() == VulkanTexture::Cubemap ? 6 : 1), 0, 0, texture->getMipLevels()){
         
     }
 
@@ -11,6 +11,7 @@
 #include <vector>
 #include <optional>
 #include <set>
+#include <algorithm>
 
 namespace MSIVulkanDemo{
 
@@ -120,6 +121,17 @@ public:
         return indices;
     }
 
+    // Bits of timestamps written on the graphics queue, 0 when it does not support them
+    uint32_t getTimestampValidBits(){
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+        return queueFamilies[findQueueFamilies(physicalDevice).graphicsFamily.value()].timestampValidBits;
+    }
+
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device) {
         SwapChainSupportDetails details;
     
@@ -179,21 +191,66 @@ public:
         return getProperties().limits;
     }
 
+    VkPhysicalDeviceFeatures getFeatures(){
+        VkPhysicalDeviceFeatures features{};
+        vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+        return features;
+    }
+
+    bool isExtensionSupported(std::string name){
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+        return std::any_of(availableExtensions.begin(), availableExtensions.end(), [&](const VkExtensionProperties& extension){
+            return name == extension.extensionName;
+        });
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT getDescriptorIndexingFeatures(){
+        return getDescriptorIndexingFeatures(physicalDevice);
+    }
+
 private:
     bool isDeviceSuitable(VkPhysicalDevice device) {
         VkPhysicalDeviceProperties properties;
         vkGetPhysicalDeviceProperties(device, &properties);
 
         bool swapChainAdequate = false;
+        bool bindlessAdequate = false;
         if (checkDeviceExtensionSupport(device)) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+
+            VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = getDescriptorIndexingFeatures(device);
+            bindlessAdequate = indexingFeatures.runtimeDescriptorArray && indexingFeatures.descriptorBindingPartiallyBound && indexingFeatures.shaderSampledImageArrayNonUniformIndexing && indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
         }
 
         VkPhysicalDeviceFeatures supportedFeatures;
         vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
-        return properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && findQueueFamilies(device).isComplete() && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+        return properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && findQueueFamilies(device).isComplete() && swapChainAdequate && bindlessAdequate && supportedFeatures.samplerAnisotropy;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT getDescriptorIndexingFeatures(VkPhysicalDevice device){
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+        indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+        VkPhysicalDeviceFeatures2KHR features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features.pNext = &indexingFeatures;
+
+        // Vulkan 1.0 instance, entry point of VK_KHR_get_physical_device_properties2
+        auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(*instance, "vkGetPhysicalDeviceFeatures2KHR");
+        if(getFeatures2){
+            getFeatures2(device, &features);
+        }
+
+        indexingFeatures.pNext = nullptr;
+        return indexingFeatures;
     }
 
     void printDeviceInfo(){
@@ -0,0 +1,69 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "interface/vulkanDeviceI.h"
+
+#include <iostream>
+#include <vector>
+#include <cstdint> 
+#include <limits> 
+#include <algorithm> 
+#include <bit>
+
+namespace MSIVulkanDemo{
+
+class VulkanQueryPool{
+private:
+    std::shared_ptr<VulkanDeviceI> device;
+
+    VkQueryPool queryPool = nullptr;
+    VkQueryType type;
+    uint32_t queryCount = 0;
+    uint32_t valuesPerQuery = 1;
+
+public:
+    VulkanQueryPool(std::shared_ptr<VulkanDeviceI> device, VkQueryType type, uint32_t queryCount, VkQueryPipelineStatisticFlags pipelineStatistics = 0): device(device), type(type), queryCount(queryCount){
+
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = type;
+        queryPoolInfo.queryCount = queryCount;
+        queryPoolInfo.pipelineStatistics = pipelineStatistics;
+
+        if(type == VK_QUERY_TYPE_PIPELINE_STATISTICS){
+            valuesPerQuery = std::popcount(pipelineStatistics);
+        }
+
+        if(VkResult errCode = vkCreateQueryPool(*device, &queryPoolInfo, nullptr, &queryPool); errCode != VK_SUCCESS){
+            throw std::runtime_error(std::format("failed to create query pool: {}", static_cast<int>(errCode)));
+        }
+    }
+
+    ~VulkanQueryPool(){
+        if(queryPool){
+            vkDestroyQueryPool(*device, queryPool, nullptr);
+        }
+    }
+
+    uint32_t getQueryCount(){
+        return queryCount;
+    }
+
+    // Returns false when results are not available yet, values are written query after query
+    bool getResults(std::vector<uint64_t>& results, uint32_t firstQuery = 0, uint32_t count = std::numeric_limits<uint32_t>::max()){
+        count = std::min(count, queryCount - firstQuery);
+        results.resize(count * valuesPerQuery);
+
+        VkResult result = vkGetQueryPoolResults(*device, queryPool, firstQuery, count, results.size() * sizeof(uint64_t), results.data(), valuesPerQuery * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+        return result == VK_SUCCESS;
+    }
+
+    operator VkQueryPool() const{
+        return queryPool;
+    }
+};
+
+}
@@ -8,6 +8,8 @@
 #include "vulkanSync.h"
 #include "vulkanRenderPass.h"
 #include "vulkanMemory.h"
+#include "vulkanTransientResources.h"
+#include "vulkanFrameData.h"
 
 #include <iostream>
 #include <vector>
@@ -37,6 +39,7 @@ class VulkanRenderGraph : public VulkanComponent<VulkanRenderGraph>{
         bool isBaked = false;
 
         std::shared_ptr<std::function<void(VulkanCommandBuffer&)>> renderFunction;
+        std::vector<std::function<void(VulkanCommandBuffer&)>> computeFunctions; // recorded before the render pass of the node begins
 
         bool isOutputTarget = false;
 
@@ -44,6 +47,17 @@ class VulkanRenderGraph : public VulkanComponent<VulkanRenderGraph>{
         bool hasInputTarget = false;
         std::weak_ptr<RenderGraphNode> inputNode;
 
+        std::vector<std::pair<std::string, std::string>> attachmentResources; // graph resource name, attachment name
+        std::vector<std::string> sampledResources;
+
+        bool mergeable = true; // can run as a subpass of its input node
+        bool scaled = false; // renders at the graph render scale instead of the swapchain extent
+        bool optional = false; // can be disabled at runtime
+        bool enabled = true;
+        std::shared_ptr<VulkanRenderPass> clearingRenderPass; // used instead of the own pass while the input node is disabled
+        std::shared_ptr<VulkanRenderPass> mergedRenderPass;
+        uint32_t subpassIndex = 0;
+
     public:
         RenderGraphNode(std::shared_ptr<VulkanRenderGraph> renderGraph, std::shared_ptr<VulkanSwapChainI> swapChain, std::string name): renderPass(std::shared_ptr<VulkanRenderPass>(new VulkanRenderPass(swapChain))), renderGraph(renderGraph), swapChain(swapChain), name(name){
 
@@ -62,19 +76,118 @@ class VulkanRenderGraph : public VulkanComponent<VulkanRenderGraph>{
             renderFunction = std::shared_ptr<std::function<void(VulkanCommandBuffer&)>>(new std::function<void(VulkanCommandBuffer&)>(fun));
         }
 
-        void bake(VulkanSwapChainI& swapChain){
-            
+        void addComputeFunction(std::function<void(VulkanCommandBuffer&)>& fun){
+            computeFunctions.push_back(fun);
+        }
+
+        std::vector<std::function<void(VulkanCommandBuffer&)>>& getComputeFunctions(){
+            return computeFunctions;
+        }
+
+        std::string getName(){
+            return name;
+        }
+
+        std::shared_ptr<VulkanRenderGraph> getRenderGraph(){
+            return renderGraph.lock();
+        }
+
+        void resolveInput(){
             if(hasInputTarget){
                 inputNode = renderGraph.lock()->getNode(inputName);
-                renderPass->getAttachment("Color").initialLayout = inputNode.lock()->getRenderPass()->getAttachment("Color").finalLayout;
-                renderPass->getAttachment("Color").loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+                auto input = inputNode.lock();
+
+                // Color target shared with the input node (same swapchain image or same graph resource) is continued instead of cleared
+                if(renderPass->hasAttachment("Color") && input->getRenderPass()->hasAttachment("Color") && getAttachmentResource("Color") == input->getAttachmentResource("Color")){
+                    renderPass->getAttachment("Color").initialLayout = input->getRenderPass()->getAttachment("Color").finalLayout;
+                    renderPass->getAttachment("Color").loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+                }
+
+                // Same for the depth buffer
+                if(renderPass->hasAttachment("Depth") && input->getRenderPass()->hasAttachment("Depth") && !getAttachmentResource("Depth").empty() && getAttachmentResource("Depth") == input->getAttachmentResource("Depth")){
+                    input->getRenderPass()->getAttachment("Depth").storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                    renderPass->getAttachment("Depth").loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+                    renderPass->getAttachment("Depth").initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+                    renderPass->addDependencyMask(VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT);
+                }
             }
+        }
 
+        void bake(VulkanSwapChainI& swapChain){
             // TODO validate ? 
             renderPass->bake();
+
+            if(hasInputTarget && inputNode.lock()->isOptional()){
+                clearingRenderPass = renderPass->createClearingVariant();
+            }
+
             isBaked = true;
         }
 
+        // Pass to record the node with, attachments loaded from a disabled input node are cleared instead
+        std::shared_ptr<VulkanRenderPass> getRecordedRenderPass(){
+            auto input = getInputNode();
+            if(input && !input->isEnabled() && clearingRenderPass){
+                return clearingRenderPass;
+            }
+            return renderPass;
+        }
+
+        void addAttachmentResource(std::string resourceName, std::string viewName){
+            attachmentResources.push_back({resourceName, viewName});
+        }
+
+        std::vector<std::pair<std::string, std::string>>& getAttachmentResources(){
+            return attachmentResources;
+        }
+
+        // Empty for swapchain backed or missing attachments
+        std::string getAttachmentResource(std::string attachmentName){
+            for(const auto& [resourceName, attachName] : attachmentResources){
+                if(attachName == attachmentName){
+                    return resourceName;
+                }
+            }
+            return "";
+        }
+
+        void addSampledResource(std::string resourceName){
+            sampledResources.push_back(resourceName);
+        }
+
+        std::vector<std::string>& getSampledResources(){
+            return sampledResources;
+        }
+
+        bool isScaled(){
+            return scaled;
+        }
+
+        void setScaled(bool value){
+            scaled = value;
+        }
+
+        bool isOptional(){
+            return optional;
+        }
+
+        void setOptional(bool value){
+            optional = value;
+        }
+
+        bool isEnabled(){
+            return enabled;
+        }
+
+        // Optional nodes and the nodes reading them switch render passes at runtime, they are never merged
+        bool isStandalone(){
+            return optional || (getInputNode() && getInputNode()->isOptional());
+        }
+
+        void setEnabled(bool value){
+            enabled = value;
+        }
+
         void addDependency(std::shared_ptr<Dependency> dependency){
             dependencies.push_back(dependency);
         }
@@ -101,6 +214,27 @@ class VulkanRenderGraph : public VulkanComponent<VulkanRenderGraph>{
             return inputNode.lock();
         }
 
+        bool isMergeable(){
+            return mergeable;
+        }
+
+        void setMergeable(bool value){
+            mergeable = value;
+        }
+
+        void setMergedRenderPass(std::shared_ptr<VulkanRenderPass> pass, uint32_t subpass){
+            mergedRenderPass = pass;
+            subpassIndex = subpass;
+        }
+
+        std::shared_ptr<VulkanRenderPass> getMergedRenderPass(){
+            return mergedRenderPass;
+        }
+
+        uint32_t getSubpassIndex(){
+            return subpassIndex;
+        }
+
     };
 
 
@@ -139,6 +273,33 @@ private:
     std::vector<std::shared_ptr<VulkanSemaphore>> renderFinishedSemaphores;
     std::vector<std::shared_ptr<VulkanFence>> inFlightFences;
 
+    std::shared_ptr<VulkanTransientResources> transientResources;
+
+    std::vector<std::shared_ptr<VulkanRenderPass>> mergedRenderPasses;
+    bool mergeSubpasses = true;
+    bool pendingMergeSubpasses = true;
+    std::vector<std::function<void(VulkanRenderGraph&)>> renderPassChangeCallbacks;
+
+    std::vector<std::shared_ptr<VulkanQueryPool>> statisticsQueryPools; // fragment shader invocations, one query per queued node
+    std::map<std::string, uint64_t> fragmentInvocations;
+
+    std::vector<std::shared_ptr<VulkanQueryPool>> timestampQueryPools; // begin and end of the frame
+    uint64_t timestampMask = ~0ull; // valid bits of the graphics queue's timestamps
+    float gpuFrameTime = 0.0f; // ms
+
+    float renderScale = 1.0f;
+    VkExtent2D renderExtent = {}; // extent of scaled nodes used by the last recorded frame
+
+    uint64_t recordedFrame = 0;
+    std::map<std::string, std::vector<std::shared_ptr<VulkanBuffer>>> globalBuffers; // one buffer per frame in flight, bound by name to every registered descriptor set
+    std::map<std::string, std::pair<std::shared_ptr<VulkanImageView>, VkSampler>> globalTextures; // same for engine owned images, e.g. shadow maps
+
+    std::shared_ptr<VulkanDescriptorPool> frameDescriptorPool;
+    std::vector<std::shared_ptr<VulkanStorageBuffer>> frameBuffers; // VulkanFrameData::frameBlock of each frame in flight
+    std::vector<std::shared_ptr<VulkanDescriptorSet>> frameSets; // set 0 of graphics pipelines, holds the globals
+    bool frameSetsOutdated = true;
+    size_t frameBytesUploaded = 0; // frame data and descriptor set uniforms of the last recorded frame
+
 public:
     VulkanRenderGraph(std::shared_ptr<VulkanSwapChainI> swapChain): swapChain(swapChain){
         // TODO max frames in flight depended
@@ -146,6 +307,26 @@ public:
         imageAvailableSemaphores = {swapChain->getDevice()->createSemaphore(), swapChain->getDevice()->createSemaphore()};
         renderFinishedSemaphores = {swapChain->getDevice()->createSemaphore(), swapChain->getDevice()->createSemaphore()};
         inFlightFences = {swapChain->getDevice()->createFence(true), swapChain->getDevice()->createFence(true)};
+
+        transientResources = std::make_shared<VulkanTransientResources>(swapChain->getDevice()->getMemoryManager());
+
+        uint32_t frames = commandBuffers.size();
+        frameDescriptorPool = swapChain->getDevice()->createDescriptorPool({{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frames}, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * frames}, {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * frames}});
+
+        for(auto commandBuffer : commandBuffers){
+            auto frameBuffer = swapChain->getDevice()->getMemoryManager()->createBuffer<VulkanStorageBuffer>(sizeof(VulkanFrameData::frameBlock), true, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+            auto frameSet = frameDescriptorPool->getDescriptorSet(getFrameUniformData(), frameBuffer, 0);
+
+            commandBuffer->setFrameDescriptorSet(frameSet);
+
+            frameBuffers.push_back(frameBuffer);
+            frameSets.push_back(frameSet);
+        }
+
+        // Registered before any node, so resources are reallocated before render passes rebuild their framebuffers
+        swapChain->addSwapChainRecreateCallback([&](VulkanSwapChainI& swapChain){
+            transientResources->resize(swapChain.getSwapChainExtent());
+        });
     }
 
     ~VulkanRenderGraph(){}
@@ -171,7 +352,7 @@ public:
         std::shared_ptr<RenderGraphNode> outputNode;
 
         for(auto [name, node] : nodes){
-            node->bake(*swapChain);
+            node->resolveInput();
             if(node->isMarkedAsOutput()){
                 if(outputNode){
                     throw std::runtime_error("RenderGraph cant have mora than one output node");
@@ -191,18 +372,72 @@ public:
             nextNode = nextNode->getInputNode();
         }
 
+        allocateTransientResources();
+
+        for(auto [name, node] : nodes){
+            node->bake(*swapChain);
+        }
+
+        bakeMergedRenderPasses();
+
+        timestampQueryPools.clear();
+        statisticsQueryPools.clear();
+
+        uint32_t timestampBits = swapChain->getDevice()->getPhysicalDevice().getTimestampValidBits();
+        timestampMask = timestampBits >= 64 ? ~0ull : (1ull << timestampBits) - 1;
+
+        if(swapChain->getDevice()->getPhysicalDevice().getDeviceLimits().timestampComputeAndGraphics && timestampBits > 0){
+            for(auto commandBuffer : commandBuffers){
+                timestampQueryPools.push_back(swapChain->getDevice()->createQueryPool(VK_QUERY_TYPE_TIMESTAMP, 2));
+            }
+        }
+
+        if(swapChain->getDevice()->getEnabledFeatures().pipelineStatisticsQuery){
+            for(auto commandBuffer : commandBuffers){
+                statisticsQueryPools.push_back(swapChain->getDevice()->createQueryPool(VK_QUERY_TYPE_PIPELINE_STATISTICS, nodesQueue.size(), VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT));
+            }
+        }
+
         isBaked = true;
     }
 
+    void declareTransientResource(std::string name, VulkanTransientResources::resourceDescription description){
+        transientResources->declare(name, description);
+    }
+
+    bool hasTransientResource(std::string name){
+        return transientResources->contains(name);
+    }
+
+    VulkanTransientResources::memoryStats getTransientMemoryStats(){
+        return transientResources->getStats();
+    }
+
     void validate(){
         // TODO validate
     }
 
     void render(uint64_t frameIndex){
 
+        if(pendingMergeSubpasses != mergeSubpasses){
+            // Pipelines used by the other mode may still be in flight
+            vkDeviceWaitIdle(*swapChain->getDevice());
+            mergeSubpasses = pendingMergeSubpasses;
+
+            for(auto& callback : renderPassChangeCallbacks){
+                callback(*this);
+            }
+        }
+
         inFlightFences[frameIndex]->reset();
 
         commandBuffers[frameIndex]->reset();
+        frameBytesUploaded = 0;
+
+        // Every frame is waited for before render returns, no frame set is in use here
+        if(frameSetsOutdated){
+            writeFrameSets();
+        }
 
         uint32_t imageId = swapChain->getNextImage(*imageAvailableSemaphores[frameIndex]);
 
@@ -210,19 +445,175 @@ public:
             return;
         }
 
-        for(auto node : nodesQueue){
+        std::shared_ptr<VulkanQueryPool> queryPool = statisticsQueryPools.empty() ? nullptr : statisticsQueryPools[frameIndex];
+        std::shared_ptr<VulkanQueryPool> timestampPool = timestampQueryPools.empty() ? nullptr : timestampQueryPools[frameIndex];
+
+        if(queryPool){
+            commandBuffers[frameIndex]->resetQueries(*queryPool);
+        }
+
+        if(timestampPool){
+            commandBuffers[frameIndex]->resetQueries(*timestampPool).writeTimestamp(*timestampPool, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+        }
+
+        renderExtent = getRenderExtent();
+        recordedFrame = frameIndex;
+
+        for(uint32_t i = 0; i < nodesQueue.size(); i++){
+            auto node = nodesQueue[i];
             // TODO synch
-            //auto frameBuffer = swapChain->getFramebuffer(imageId, std::static_pointer_cast<VulkanRenderPass>(node));
-            auto frameBuffer = node->getRenderPass()->getFramebuffer(imageId);
+
+            if(mergeSubpasses && node->getMergedRenderPass()){
+                if(node->getSubpassIndex() == 0){
+                    // Dispatches cannot be recorded inside the render pass, run them for the whole chain up front
+                    for(uint32_t j = i; j < nodesQueue.size() && nodesQueue[j]->getMergedRenderPass() == node->getMergedRenderPass(); j++){
+                        recordComputeFunctions(*commandBuffers[frameIndex], nodesQueue[j]);
+                    }
+
+                    auto frameBuffer = node->getMergedRenderPass()->getFramebuffer(imageId);
+                    frameBuffer->setRenderArea(node->isScaled() ? renderExtent : swapChain->getSwapChainExtent());
+                    commandBuffers[frameIndex]->beginRenderPass(frameBuffer);
+                }else{
+                    commandBuffers[frameIndex]->nextSubpass();
+                }
+
+                recordNode(*commandBuffers[frameIndex], node, queryPool, i);
+
+                bool lastSubpass = i + 1 == nodesQueue.size() || nodesQueue[i + 1]->getMergedRenderPass() != node->getMergedRenderPass();
+                if(lastSubpass){
+                    commandBuffers[frameIndex]->endRenderPass();
+                }
+                continue;
+            }
+
+            recordComputeFunctions(*commandBuffers[frameIndex], node);
+
+            if(!node->isEnabled()){
+                if(queryPool){
+                    commandBuffers[frameIndex]->beginQuery(*queryPool, i).endQuery(*queryPool, i);
+                }
+                continue;
+            }
+
+            auto frameBuffer = node->getRecordedRenderPass()->getFramebuffer(imageId);
+            frameBuffer->setRenderArea(node->isScaled() ? renderExtent : swapChain->getSwapChainExtent());
             commandBuffers[frameIndex]->beginRenderPass(frameBuffer);
-            node->getRenderFunction()(*commandBuffers[frameIndex]);
+            recordNode(*commandBuffers[frameIndex], node, queryPool, i);
             commandBuffers[frameIndex]->endRenderPass();
 
         }
+        if(timestampPool){
+            commandBuffers[frameIndex]->writeTimestamp(*timestampPool, 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+        }
+
         commandBuffers[frameIndex]->submit(*imageAvailableSemaphores[frameIndex], *renderFinishedSemaphores[frameIndex], *inFlightFences[frameIndex]);
 
         swapChain->presentImage(*renderFinishedSemaphores[frameIndex], imageId);
         inFlightFences[frameIndex]->waitFor();
+
+        std::vector<uint64_t> results;
+        if(queryPool && queryPool->getResults(results)){
+            for(uint32_t i = 0; i < nodesQueue.size(); i++){
+                fragmentInvocations.insert_or_assign(nodesQueue[i]->getName(), results[i]);
+            }
+        }
+
+        if(timestampPool && timestampPool->getResults(results)){
+            float timestampPeriod = swapChain->getDevice()->getPhysicalDevice().getDeviceLimits().timestampPeriod;
+            uint64_t ticks = (results[1] - results[0]) & timestampMask; // bits above the valid ones are undefined, also handles a wrap in between
+            gpuFrameTime = ticks * timestampPeriod / 1000000.0f;
+        }
+    }
+
+    // Time between the first and last command of the last frame, 0 when timestamps are not supported
+    float getGpuFrameTime(){
+        return gpuFrameTime;
+    }
+
+    void setRenderScale(float scale){
+        renderScale = std::clamp(scale, 0.1f, 1.0f);
+    }
+
+    float getRenderScale(){
+        return renderScale;
+    }
+
+    VkExtent2D getRenderExtent(){
+        VkExtent2D extent = swapChain->getSwapChainExtent();
+        return {
+            std::max(1u, static_cast<uint32_t>(extent.width * renderScale)),
+            std::max(1u, static_cast<uint32_t>(extent.height * renderScale))
+        };
+    }
+
+    // Extent scaled nodes were rendered with in the last recorded frame, to be used by nodes sampling them
+    VkExtent2D getRecordedRenderExtent(){
+        return renderExtent;
+    }
+
+    std::shared_ptr<VulkanImageView> getResourceView(std::string name){
+        return transientResources->getImageView(name);
+    }
+
+    // Empty when pipeline statistics queries are not supported by the device
+    std::map<std::string, uint64_t> getFragmentInvocations(){
+        return fragmentInvocations;
+    }
+
+    uint32_t getFramesInFlight(){
+        return commandBuffers.size();
+    }
+
+    // Frame slot of the command buffer being recorded, selects per frame resources
+    uint64_t getRecordedFrame(){
+        return recordedFrame;
+    }
+
+    // Buffers have to be set before descriptor sets using them are registered
+    void setGlobalBuffer(std::string name, std::vector<std::shared_ptr<VulkanBuffer>> perFrameBuffers){
+        if(perFrameBuffers.size() != commandBuffers.size()){
+            throw std::runtime_error(std::format("Global buffer {} needs one buffer per frame in flight", name));
+        }
+
+        globalBuffers.insert_or_assign(name, perFrameBuffers);
+        frameSetsOutdated = true;
+    }
+
+    // Textures have to be set before descriptor sets using them are registered, the view has to stay in SHADER_READ_ONLY_OPTIMAL outside of its owner's passes
+    void setGlobalTexture(std::string name, std::shared_ptr<VulkanImageView> view, VkSampler sampler){
+        globalTextures.insert_or_assign(name, std::pair<std::shared_ptr<VulkanImageView>, VkSampler>{view, sampler});
+        frameSetsOutdated = true;
+    }
+
+    // Camera and time of the frame being recorded, shared by every graphics pipeline through set 0
+    void setFrameData(const VulkanFrameData::frameBlock& data){
+        frameBuffers[recordedFrame]->uploadData(0, &data, sizeof(VulkanFrameData::frameBlock));
+        frameBytesUploaded += sizeof(VulkanFrameData::frameBlock);
+    }
+
+    // Host writes of uniform data in the last recorded frame, storage buffers filled by features are not included
+    size_t getUniformBytesUploaded(){
+        return frameBytesUploaded + commandBuffers[recordedFrame]->getUniformBytesUploaded();
+    }
+
+    // Summed over the uniform allocators of all frames in flight
+    VulkanUniformAllocator::memoryStats getUniformMemoryStats(){
+        VulkanUniformAllocator::memoryStats total;
+
+        for(auto& commandBuffer : commandBuffers){
+            auto stats = commandBuffer->getUniformMemoryStats();
+            total.pages += stats.pages;
+            total.descriptorSets += stats.descriptorSets;
+            total.capacity += stats.capacity;
+            total.used += stats.used;
+            total.highWater += stats.highWater;
+        }
+
+        return total;
+    }
+
+    VulkanUniformData getFrameUniformData(){
+        return VulkanFrameData::getUniformData(swapChain->getDevice()->getPhysicalDevice().getDeviceLimits().minUniformBufferOffsetAlignment);
     }
 
     void registerDescriptorSet(VulkanDescriptorSetOwner* owner){
@@ -233,8 +624,20 @@ public:
 
         VulkanUniformData uniformData = owner->getGraphicsPipeline()->getUniformData();
 
-        for(auto buffer : commandBuffers){
-            auto set = buffer->createDescriptorSet(uniformData);
+        for(uint32_t i = 0; i < commandBuffers.size(); i++){
+            auto set = commandBuffers[i]->createDescriptorSet(uniformData);
+
+            for(const auto& [name, buffers] : globalBuffers){
+                if(uniformData.contains(name)){
+                    set->setBuffer(name, *buffers[i]);
+                }
+            }
+
+            for(const auto& [name, texture] : globalTextures){
+                if(uniformData.contains(name)){
+                    set->setTexture(name, *texture.first, texture.second);
+                }
+            }
             //set->setDefaultTexture(defaultTex.first, defaultTex.second);
             //set->writeDescriptorSet(uniformData);
             sets.push_back(set);
@@ -251,12 +654,157 @@ public:
         return nodes[name]->getRenderPass();
     }
 
+    // Render pass and subpass the node is currently recorded in, pipelines created by users of the node have to be compatible with it
+    std::shared_ptr<VulkanRenderPass> getActiveRenderPass(std::string name){
+        if(!isBaked){
+            throw std::runtime_error("Renderpass needs to be baked");
+        }
+
+        if(mergeSubpasses && nodes[name]->getMergedRenderPass()){
+            return nodes[name]->getMergedRenderPass();
+        }
+        return nodes[name]->getRenderPass();
+    }
+
+    uint32_t getActiveSubpass(std::string name){
+        if(mergeSubpasses && nodes[name]->getMergedRenderPass()){
+            return nodes[name]->getSubpassIndex();
+        }
+        return 0;
+    }
+
+    void setSubpassMerging(bool value){
+        pendingMergeSubpasses = value;
+    }
+
+    bool isSubpassMerging(){
+        return pendingMergeSubpasses;
+    }
+
+    // Disabled nodes only record their compute functions, the next node clears what it would have loaded from them.
+    // Only nodes added with Optional can be disabled
+    void setNodeEnabled(std::string name, bool value){
+        if(!nodes.at(name)->isOptional()){
+            throw std::runtime_error(std::format("RenderGraph node {} is not optional", name));
+        }
+        nodes.at(name)->setEnabled(value);
+    }
+
+    void addRenderPassChangeCallback(std::function<void(VulkanRenderGraph&)> callback){
+        renderPassChangeCallbacks.push_back(callback);
+    }
+
 private:
 
+    void writeFrameSets(){
+        VulkanUniformData frameData = getFrameUniformData();
+
+        for(uint32_t i = 0; i < frameSets.size(); i++){
+            for(const auto& [name, buffers] : globalBuffers){
+                if(frameData.contains(name)){
+                    frameSets[i]->setBuffer(name, *buffers[i]);
+                }
+            }
+
+            for(const auto& [name, texture] : globalTextures){
+                if(frameData.contains(name)){
+                    frameSets[i]->setTexture(name, *texture.first, texture.second);
+                }
+            }
+
+            frameSets[i]->writeDescriptorSet(frameData);
+        }
+
+        frameSetsOutdated = false;
+    }
+
+    void recordComputeFunctions(VulkanCommandBuffer& commandBuffer, std::shared_ptr<RenderGraphNode> node){
+        for(auto& computeFunction : node->getComputeFunctions()){
+            computeFunction(commandBuffer);
+        }
+    }
+
+    void recordNode(VulkanCommandBuffer& commandBuffer, std::shared_ptr<RenderGraphNode> node, std::shared_ptr<VulkanQueryPool> queryPool, uint32_t queryId){
+        if(queryPool){
+            commandBuffer.beginQuery(*queryPool, queryId);
+        }
+
+        node->getRenderFunction()(commandBuffer);
+
+        if(queryPool){
+            commandBuffer.endQuery(*queryPool, queryId);
+        }
+    }
+
     std::shared_ptr<RenderGraphNode> getNode(std::string name){
         return nodes[name];
     }
 
+    // Linear chains of nodes, each reading the previous one's target, are recorded as subpasses of one render pass, so tile based GPUs keep the attachments on chip
+    void bakeMergedRenderPasses(){
+        mergedRenderPasses.clear();
+
+        std::vector<std::shared_ptr<RenderGraphNode>> chain;
+
+        auto flush = [&](){
+            if(chain.size() > 1){
+                std::vector<std::shared_ptr<VulkanRenderPass>> passes;
+                for(auto node : chain){
+                    passes.push_back(node->getRenderPass());
+                }
+
+                auto merged = std::shared_ptr<VulkanRenderPass>(new VulkanRenderPass(swapChain));
+                merged->bakeMerged(passes);
+                mergedRenderPasses.push_back(merged);
+
+                for(uint32_t i = 0; i < chain.size(); i++){
+                    chain[i]->setMergedRenderPass(merged, i);
+                }
+            }
+            chain.clear();
+        };
+
+        for(auto node : nodesQueue){
+            if(!chain.empty() && !(node->isMergeable() && !node->isStandalone() && !chain.back()->isStandalone() && node->getInputNode() == chain.back() && node->isScaled() == chain.back()->isScaled())){
+                flush();
+            }
+            chain.push_back(node);
+        }
+        flush();
+    }
+
+    void allocateTransientResources(){
+        transientResources->clearUses();
+
+        // Lifetimes are positions in execution order, nodes outside of the queue are placed after it
+        uint32_t order = 0;
+        std::vector<std::shared_ptr<RenderGraphNode>> orderedNodes(nodesQueue.begin(), nodesQueue.end());
+
+        for(auto [name, node] : nodes){
+            if(std::find(nodesQueue.begin(), nodesQueue.end(), node) == nodesQueue.end()){
+                orderedNodes.push_back(node);
+            }
+        }
+
+        for(auto node : orderedNodes){
+            for(const auto& [resourceName, viewName] : node->getAttachmentResources()){
+                transientResources->addUse(resourceName, order);
+            }
+            for(const auto& resourceName : node->getSampledResources()){
+                transientResources->addUse(resourceName, order);
+            }
+            order++;
+        }
+
+        transientResources->allocate(swapChain->getSwapChainExtent());
+
+        for(auto node : orderedNodes){
+            for(const auto& [resourceName, viewName] : node->getAttachmentResources()){
+                node->getRenderPass()->addImageView(viewName, transientResources->getImageView(resourceName), true);
+            }
+        }
+    }
+
 public:
     class DepthOnly : public Dependency{
     public:
@@ -264,10 +812,25 @@ public:
         DepthOnly(const DepthOnly& other): Dependency(None){}
         ~DepthOnly(){}
 
-        void apply(RenderGraphNode& node){}
+        void apply(RenderGraphNode& node){
+            node.getRenderPass()->removeAttachment("Color");
+        }
         Dependency* clone() const{return new DepthOnly(*this);}
     };
 
+    // Node can be disabled with setNodeEnabled, e.g. a pre-pass
+    class Optional : public Dependency{
+    public:
+        Optional(): Dependency(None){}
+        Optional(const Optional& other): Dependency(None){}
+        ~Optional(){}
+
+        void apply(RenderGraphNode& node){
+            node.setOptional(true);
+        }
+        Dependency* clone() const{return new Optional(*this);}
+    };
+
     class AddInput : public Dependency{
     public:
         AddInput(std::string a, std::string b): Dependency(None){}
@@ -293,6 +856,22 @@ public:
         Dependency* clone() const{return new AddRenderFunction(*this);}
     };
 
+    // Work recorded outside of render passes before the node, e.g. compute dispatches producing data the node reads
+    class AddComputeFunction : public Dependency{
+    private:
+        std::function<void(VulkanCommandBuffer&)> fun;
+
+    public:
+        AddComputeFunction(std::function<void(VulkanCommandBuffer&)> fun): Dependency(None), fun(std::move(fun)){}
+        AddComputeFunction(const AddComputeFunction& other): Dependency(None), fun(other.fun){}
+        ~AddComputeFunction(){}
+
+        void apply(RenderGraphNode& node){
+            node.addComputeFunction(fun);
+        }
+        Dependency* clone() const{return new AddComputeFunction(*this);}
+    };
+
     class SetRenderTargetInput : public Dependency{
     private:
         std::string nodeName;
@@ -321,10 +900,10 @@ public:
 
     class AddDepthBuffer : public Dependency{
     private:
-        std::shared_ptr<VulkanImageView> depthView;
+        std::string resourceName;
 
     public:
-        AddDepthBuffer(): Dependency(None){}
+        AddDepthBuffer(std::string resourceName = ""): Dependency(None), resourceName(resourceName){}
         ~AddDepthBuffer(){}
 
         void apply(RenderGraphNode& node){
@@ -333,27 +912,104 @@ public:
 
             // TODO has stencil component https://vulkan-tutorial.com/Depth_buffering
 
-            std::shared_ptr<VulkanImage> depthImage = node.getRenderPass()->getSwapChain()->getDevice()->getMemoryManager()->createImage<VulkanImage>(
-                std::pair<uint32_t, uint32_t>({node.getRenderPass()->getSwapChain()->getSwapChainExtent().width, node.getRenderPass()->getSwapChain()->getSwapChainExtent().height}),
-                VulkanImage::constructParameters({
-                    .format = depthFormat, 
-                    .tiling = VK_IMAGE_TILING_OPTIMAL, 
-                    .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 
-                    .properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-                })
-            );
-            
-            depthView = depthImage->createImageView(VK_IMAGE_ASPECT_DEPTH_BIT);
+            // Image is allocated by the render graph at bake time, depth buffers of nodes that do not overlap share memory
+            std::string name = resourceName.empty() ? node.getName() + "Depth" : resourceName;
+
+            node.getRenderGraph()->declareTransientResource(name, {
+                .format = depthFormat,
+                .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                .aspect = VK_IMAGE_ASPECT_DEPTH_BIT
+            });
+            node.addAttachmentResource(name, "Depth");
 
             node.getRenderPass()->addAttachment("Depth", depthFormat, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
 
             node.getRenderPass()->addDependencyMask(VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
-
-            node.getRenderPass()->addImageView("DepthBuffer", depthView);
         }
         Dependency* clone() const{return new AddDepthBuffer(*this);}
     };
 
+    // Renders into a graph owned image instead of the swapchain, so later nodes can sample it
+    class AddColorTarget : public Dependency{
+    private:
+        std::string resourceName;
+
+    public:
+        AddColorTarget(std::string resourceName): Dependency(None), resourceName(resourceName){}
+        ~AddColorTarget(){}
+
+        void apply(RenderGraphNode& node){
+            node.getRenderGraph()->declareTransientResource(resourceName, {
+                .format = node.getRenderPass()->getSwapChain()->getImageFormat(),
+                .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                .aspect = VK_IMAGE_ASPECT_COLOR_BIT,
+                .external = true
+            });
+            node.addAttachmentResource(resourceName, "Color");
+
+            node.getRenderPass()->setOffscreen(true);
+            node.getRenderPass()->getAttachment("Color").finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        }
+        Dependency* clone() const{return new AddColorTarget(*this);}
+    };
+
+    // Resource written by an earlier node is read in the fragment shader, the node cannot be merged into a subpass
+    class AddSampledInput : public Dependency{
+    private:
+        std::string resourceName;
+
+    public:
+        AddSampledInput(std::string resourceName): Dependency(None), resourceName(resourceName){}
+        ~AddSampledInput(){}
+
+        void apply(RenderGraphNode& node){
+            node.addSampledResource(resourceName);
+            node.setMergeable(false);
+
+            node.getRenderPass()->addDependencyMask(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        }
+        Dependency* clone() const{return new AddSampledInput(*this);}
+    };
+
+    // Resource written by the input node is read by compute functions of the node (e.g. a depth pyramid build), the node cannot be merged into a subpass,
+    // so its compute functions run after the input's render pass ended. They transition the image and restore the layout the input node left it in.
+    // The resource has to be declared already (e.g. by AddDepthBuffer of the node), only the usage is added
+    class AddComputeInput : public Dependency{
+    private:
+        std::string resourceName;
+
+    public:
+        AddComputeInput(std::string resourceName): Dependency(None), resourceName(resourceName){}
+        ~AddComputeInput(){}
+
+        void apply(RenderGraphNode& node){
+            if(!node.getRenderGraph()->hasTransientResource(resourceName)){
+                throw std::runtime_error(std::format("Compute input {} of node {} has to be declared before", resourceName, node.getName()));
+            }
+
+            node.getRenderGraph()->declareTransientResource(resourceName, {
+                .format = VK_FORMAT_UNDEFINED,
+                .usage = VK_IMAGE_USAGE_SAMPLED_BIT,
+                .external = true
+            });
+            node.addSampledResource(resourceName);
+            node.setMergeable(false);
+        }
+        Dependency* clone() const{return new AddComputeInput(*this);}
+    };
+
+    // Node renders at the graph render scale (top left part of its attachments)
+    class UseRenderScale : public Dependency{
+    public:
+        UseRenderScale(): Dependency(None){}
+        ~UseRenderScale(){}
+
+        void apply(RenderGraphNode& node){
+            node.setScaled(true);
+        }
+        Dependency* clone() const{return new UseRenderScale(*this);}
+    };
+
 };
 
 
@@ -16,6 +16,7 @@
 #include <algorithm> 
 #include <functional>
 #include <deque>
+#include <set>
 
 namespace MSIVulkanDemo{
 
@@ -35,7 +36,11 @@ private:
 
 protected:
     
-    std::map<std::string, std::shared_ptr<VulkanImageView>> imageViews;
+    std::map<std::string, std::shared_ptr<VulkanImageView>> imageViews; // keyed by attachment name
+    std::set<std::string> managedImageViews; // resized by their owner (render graph), not by the render pass
+
+    bool offscreen = false; // "Color" is an image view instead of the swapchain image
+    bool externalFramebuffers = false; // framebuffers are created by the owner of the pass, not one per swapchain image
 
     std::map<std::string, std::pair<VkAttachmentDescription, VkAttachmentReference>> attachments;
 
@@ -82,7 +87,7 @@ public:
 
         VkSubpassDescription subpass{};
         subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS; 
-        subpass.colorAttachmentCount = 1; // TODO allow for more
+        subpass.colorAttachmentCount = 0; // TODO allow for more than one
 
         for(const auto& [name, attach] : attachments){
             if(attach.second.layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL){
@@ -90,13 +95,14 @@ public:
             }
             if(attach.second.layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL){
                 subpass.pColorAttachments = &attach.second;
+                subpass.colorAttachmentCount = 1;
             }
         }
 
-        std::vector<VkAttachmentDescription> attachs;
+        std::vector<VkAttachmentDescription> attachs(attachments.size());
 
         for(const auto& [name, attach] : attachments){
-            attachs.push_back(attach.first);
+            attachs[attach.second.attachment] = attach.first;
         }
 
         VkRenderPassCreateInfo renderPassInfo{};
@@ -112,14 +118,129 @@ public:
             throw std::runtime_error(std::format("failed to create render pass: {}", static_cast<int>(errCode)));
         }
 
-        for(auto image : swapChain->getSwapChainImageViews()){
-            std::vector<std::shared_ptr<VulkanImageView>> views;
-            views.push_back(image);
+        createFramebuffers();
+    }
 
-            std::transform(imageViews.begin(), imageViews.end(), std::back_inserter(views), [](auto &kv){ return kv.second;});
+    void bakeMerged(std::vector<std::shared_ptr<VulkanRenderPass>> chain){
 
-            framebuffers.push_back(std::shared_ptr<VulkanFramebuffer>(new VulkanFramebuffer(shared_from_this(), views)));
+        attachments.clear();
+        imageViews.clear();
+        managedImageViews.clear();
+        offscreen = false;
+
+        std::vector<std::vector<std::string>> subpassAttachments;
+
+        // Swapchain image is always the first framebuffer attachment
+        for(auto pass : chain){
+            if(pass->attachments.contains("Color")){
+                attachments.insert({"Color", {pass->attachments.at("Color").first, {0, pass->attachments.at("Color").second.layout}}});
+                offscreen = pass->offscreen;
+                break;
+            }
+        }
+
+        for(auto pass : chain){
+            std::vector<std::pair<std::string, std::pair<VkAttachmentDescription, VkAttachmentReference>>> ordered(pass->attachments.begin(), pass->attachments.end());
+            std::sort(ordered.begin(), ordered.end(), [](auto& a, auto& b){ return a.second.second.attachment < b.second.second.attachment; });
+
+            std::vector<std::string> names;
+
+            for(const auto& [name, attach] : ordered){
+                if(!attachments.contains(name)){
+                    VkAttachmentReference ref = {static_cast<uint32_t>(attachments.size()), attach.second.layout};
+                    attachments.insert({name, {attach.first, ref}});
+                }else{
+                    // first user loads, last user stores
+                    auto& merged = attachments.at(name).first;
+                    merged.storeOp = attach.first.storeOp;
+                    merged.stencilStoreOp = attach.first.stencilStoreOp;
+                    merged.finalLayout = attach.first.finalLayout;
+                }
+                names.push_back(name);
+            }
+
+            for(const auto& [name, view] : pass->imageViews){
+                addImageView(name, view, pass->managedImageViews.contains(name));
+            }
+
+            subpassAttachments.push_back(names);
+        }
+
+        // Depth never leaves the merged pass, so it is never written back to memory
+        for(auto& [name, attach] : attachments){
+            if(attach.second.layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL){
+                attach.first.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                attach.first.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            }
+        }
+
+        std::vector<std::vector<VkAttachmentReference>> colorRefs(chain.size());
+        std::vector<VkAttachmentReference> depthRefs(chain.size());
+        std::vector<VkSubpassDescription> subpasses(chain.size());
+        std::vector<VkSubpassDependency> dependencies;
+
+        for(uint32_t i = 0; i < chain.size(); i++){
+            subpasses[i] = {};
+            subpasses[i].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+
+            for(const auto& name : subpassAttachments[i]){
+                const auto& ref = attachments.at(name).second;
+
+                if(ref.layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL){
+                    depthRefs[i] = ref;
+                    subpasses[i].pDepthStencilAttachment = &depthRefs[i];
+                }
+                if(ref.layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL){
+                    colorRefs[i].push_back(ref);
+                }
+            }
+
+            subpasses[i].colorAttachmentCount = colorRefs[i].size();
+            subpasses[i].pColorAttachments = colorRefs[i].data();
+
+            if(i == 0){
+                VkSubpassDependency external = chain[0]->dependency;
+                for(auto pass : chain){
+                    external.srcStageMask |= pass->dependency.srcStageMask;
+                    external.srcAccessMask |= pass->dependency.srcAccessMask;
+                    external.dstStageMask |= pass->dependency.dstStageMask;
+                    external.dstAccessMask |= pass->dependency.dstAccessMask;
+                }
+                dependencies.push_back(external);
+                continue;
+            }
+
+            VkSubpassDependency dep{};
+            dep.srcSubpass = i - 1;
+            dep.dstSubpass = i;
+            dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            dep.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            dep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+            dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            dep.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+            dependencies.push_back(dep);
+        }
+
+        std::vector<VkAttachmentDescription> attachs(attachments.size());
+
+        for(const auto& [name, attach] : attachments){
+            attachs[attach.second.attachment] = attach.first;
         }
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = attachs.size();
+        renderPassInfo.pAttachments = attachs.data();
+        renderPassInfo.subpassCount = subpasses.size();
+        renderPassInfo.pSubpasses = subpasses.data();
+        renderPassInfo.dependencyCount = dependencies.size();
+        renderPassInfo.pDependencies = dependencies.data();
+
+        if (VkResult errCode = vkCreateRenderPass(*swapChain->getDevice(), &renderPassInfo, nullptr, &renderPass); errCode != VK_SUCCESS) {
+            throw std::runtime_error(std::format("failed to create merged render pass: {}", static_cast<int>(errCode)));
+        }
+
+        createFramebuffers();
     }
 
     operator VkRenderPass() const{
@@ -170,8 +291,53 @@ public:
         return attachments.at(name).first;
     }
 
-    void addImageView(std::string name, std::shared_ptr<VulkanImageView> imageView){
-        imageViews.insert({name, imageView});
+    bool hasAttachment(std::string name){
+        return attachments.contains(name);
+    }
+
+    void setOffscreen(bool value){
+        offscreen = value;
+    }
+
+    bool isOffscreen(){
+        return offscreen;
+    }
+
+    void setExternalFramebuffers(bool value){
+        externalFramebuffers = value;
+    }
+
+    void removeAttachment(std::string name){
+        uint32_t index = attachments.at(name).second.attachment;
+        attachments.erase(name);
+
+        for(auto& [attachName, attach] : attachments){
+            if(attach.second.attachment > index){
+                attach.second.attachment--;
+            }
+        }
+    }
+
+    std::vector<VkClearValue> getClearValues(){
+        std::vector<VkClearValue> clearValues(attachments.size());
+
+        for(const auto& [name, attach] : attachments){
+            if(attach.second.layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL){
+                clearValues[attach.second.attachment].depthStencil = {1.0f, 0};
+            }else{
+                clearValues[attach.second.attachment].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+            }
+        }
+
+        return clearValues;
+    }
+
+    void addImageView(std::string name, std::shared_ptr<VulkanImageView> imageView, bool managed = false){
+        imageViews.insert_or_assign(name, imageView);
+
+        if(managed){
+            managedImageViews.insert(name);
+        }
     }
 
     void addDependencyMask(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkPipelineStageFlags dstAccessMask){
@@ -181,24 +347,69 @@ public:
         dependency.dstAccessMask |= dstAccessMask;
     }
 
+    // Compatible pass over the same image views that clears the attachments this one loads, for when the pass writing them is skipped
+    std::shared_ptr<VulkanRenderPass> createClearingVariant(){
+        auto variant = std::shared_ptr<VulkanRenderPass>(new VulkanRenderPass(swapChain));
+
+        variant->attachments = attachments;
+        variant->imageViews = imageViews;
+        variant->managedImageViews = managedImageViews;
+        variant->offscreen = offscreen;
+        variant->externalFramebuffers = externalFramebuffers;
+        variant->dependency = dependency;
+
+        for(auto& [name, attach] : variant->attachments){
+            if(attach.first.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD){
+                attach.first.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                attach.first.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            }
+        }
+
+        variant->bake();
+        return variant;
+    }
+
     std::shared_ptr<VulkanFramebuffer> getFramebuffer(uint32_t imageId){
         return framebuffers[imageId];
     }
 
     void recreateFramebuffers(VulkanSwapChainI& swapChain){
+        if(externalFramebuffers){
+            return;
+        }
 
         for(auto [name, view] : imageViews){
+            if(managedImageViews.contains(name)){
+                continue;
+            }
             view->resize(std::pair<uint32_t, uint32_t>(swapChain.getSwapChainExtent().width, swapChain.getSwapChainExtent().height));
         }
 
+        if(renderPass){
+            createFramebuffers();
+        }
+    }
+
+private:
+
+    void createFramebuffers(){
         framebuffers.clear();
-        for(auto image : swapChain.getSwapChainImageViews()){
-            std::vector<std::shared_ptr<VulkanImageView>> views;
-            views.push_back(image);
 
-            std::transform(imageViews.begin(), imageViews.end(), std::back_inserter(views), [](auto &kv){ return kv.second;});
+        if(externalFramebuffers){
+            return;
+        }
+
+        for(auto image : swapChain->getSwapChainImageViews()){
+            std::vector<std::shared_ptr<VulkanImageView>> views(attachments.size());
+
+            for(const auto& [name, attach] : attachments){
+                if(name == "Color" && !offscreen){
+                    views[attach.second.attachment] = image;
+                }else{
+                    views[attach.second.attachment] = imageViews.at(name);
+                }
+            }
 
-            //views.insert(views.end(), imageViews.begin(), imageViews.end());
             framebuffers.push_back(std::shared_ptr<VulkanFramebuffer>(new VulkanFramebuffer(shared_from_this(), views)));
         }
     }
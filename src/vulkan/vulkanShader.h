@@ -8,6 +8,7 @@
 #include "interface/vulkanDeviceI.h"
 #include "vulkanVertexData.h"
 #include "vulkanUniform.h"
+#include "vulkanFrameData.h"
 
 #include <iostream>
 #include <fstream>
@@ -18,7 +19,8 @@ namespace MSIVulkanDemo{
 
 enum ShaderType{
     Vertex = shaderc_vertex_shader,
-    Fragment = shaderc_fragment_shader
+    Fragment = shaderc_fragment_shader,
+    Compute = shaderc_compute_shader
 };
 
 class VulkanShader{
@@ -49,10 +51,29 @@ public:
         return type;
     }
 
+    VkShaderStageFlags getStage(){
+        switch(type){
+        case Vertex:
+            return VK_SHADER_STAGE_VERTEX_BIT;
+        case Fragment:
+            return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case Compute:
+            return VK_SHADER_STAGE_COMPUTE_BIT;
+        default:
+            return 0;
+        }
+    }
+
     virtual VulkanVertexData getVertexData() = 0;
 
+    // Bindings of the shader's own set, the material set of graphics stages (VulkanFrameData), set 0 of compute shaders
     virtual std::vector<VulkanUniformData::bindingBlock> getUniformData() = 0;
 
+    // The global VulkanBindlessTextures table is not part of the uniform data
+    virtual bool usesBindlessTextures() = 0;
+
+    virtual VulkanPushConstantData getPushConstantData() = 0;
+
 protected:
 
     void loadCode(const std::vector<uint32_t>& compiledCode){
@@ -36,6 +36,12 @@ private:
 
     uint32_t imageCount;
     uint32_t minImageCount;
+    uint32_t maxImageCount;
+
+    VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    VkPresentModeKHR presentMode;
+    std::vector<VkPresentModeKHR> availablePresentModes;
+    uint32_t requestedImageCount = 0; // 0 - minImageCount + 1
 
 public:
     VulkanSwapChain(std::shared_ptr<VulkanDeviceI> device): device(device){
@@ -139,23 +145,48 @@ public:
         return imageCount;
     }
 
+    uint32_t getMaxImageCount(){
+        return maxImageCount;
+    }
+
+    VkPresentModeKHR getPresentMode(){
+        return presentMode;
+    }
+
+    std::vector<VkPresentModeKHR>& getAvailablePresentModes(){
+        return availablePresentModes;
+    }
+
+    // Falls back to FIFO when the mode is not supported by the surface
+    void setPresentMode(VkPresentModeKHR mode){
+        requestedPresentMode = mode;
+        recreateSwapChain();
+    }
+
+    void setImageCount(uint32_t count){
+        requestedImageCount = count;
+        recreateSwapChain();
+    }
+
 private:
 
     void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE){
         SwapChainSupportDetails swapChainSupport = device->getPhysicalDevice().querySwapChainSupport(device->getPhysicalDevice());
 
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-        VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+        availablePresentModes = swapChainSupport.presentModes;
+        presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
         swapChainExtent = chooseSwapExtent(swapChainSupport.capabilities);
 
         swapChainImageFormat = surfaceFormat.format;
 
         minImageCount = swapChainSupport.capabilities.minImageCount;
-        imageCount = swapChainSupport.capabilities.minImageCount + 1;
+        maxImageCount = swapChainSupport.capabilities.maxImageCount > 0 ? swapChainSupport.capabilities.maxImageCount : std::max(minImageCount + 2, 8u);
+        imageCount = requestedImageCount > 0 ? requestedImageCount : swapChainSupport.capabilities.minImageCount + 1;
 
-        if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
-            // TODO log that
-            imageCount = swapChainSupport.capabilities.maxImageCount;
+        if (imageCount < minImageCount || imageCount > maxImageCount) {
+            std::cout << std::format("Swapchain image count {} out of supported range {}-{}, clamping", imageCount, minImageCount, maxImageCount) << std::endl;
+            imageCount = std::clamp(imageCount, minImageCount, maxImageCount);
         }
 
         VkSwapchainCreateInfoKHR createInfo{};
@@ -216,12 +247,12 @@ private:
 
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
         for (const auto& availablePresentMode : availablePresentModes) {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+            if (availablePresentMode == requestedPresentMode) {
                 return availablePresentMode;
             }
         }
 
-        return VK_PRESENT_MODE_FIFO_KHR;
+        return VK_PRESENT_MODE_FIFO_KHR; // always supported
     }
 
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
@@ -0,0 +1,213 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "vulkanMemory.h"
+#include "vulkanImageData.h"
+#include "vulkanBindlessTextures.h"
+#include "vulkanTextureSampler.h"
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <tuple>
+
+namespace MSIVulkanDemo{
+
+
+// Small 2D textures of the same resolution, format, mip levels and sampler share the layers of one array image instead of owning an image each.
+// Arrays are in the bindless table, the index of a packed texture holds the array's index and the layer (textureBindless in shaders/include/bindless.glsl).
+// An array starts with one layer and doubles its image when full, the layers are copied over and the table entry keeps its index
+class VulkanTextureArrays{
+public:
+    static constexpr uint32_t maxSize = 256; // largest side of packed textures
+    static constexpr uint32_t layersPerArray = 16;
+    static constexpr uint32_t packedBit = 0x80000000u;
+    static constexpr uint32_t layerShift = 12; // above the array's index, VulkanBindlessTextures::maxTextures fits in 12 bits
+
+    struct arraysStats{
+        uint32_t arrays = 0;
+        uint32_t textures = 0;
+        uint32_t layers = 0; // allocated, used or not
+        VkDeviceSize bytes = 0;
+    };
+
+private:
+    typedef std::tuple<uint32_t, uint32_t, VkFormat, uint32_t> arrayKey; // width, height, format, mip levels
+
+    struct textureArray{
+        arrayKey key;
+        VulkanSamplerDescription samplerDescription;
+        std::shared_ptr<VulkanTextureSampler> sampler;
+        std::shared_ptr<VulkanImage> image;
+        std::shared_ptr<VulkanImageView> view;
+        std::vector<bool> usedLayers; // one per allocated layer
+        uint32_t used = 0;
+        uint64_t generation = 0; // changes whenever the image is replaced
+    };
+
+    std::shared_ptr<VulkanMemoryManager> memoryManager;
+    std::shared_ptr<VulkanBindlessTextures> bindlessTextures;
+
+    std::map<uint32_t, textureArray> arrays; // by the array's bindless index
+    uint64_t generations = 0;
+
+public:
+    VulkanTextureArrays(std::shared_ptr<VulkanMemoryManager> memoryManager): memoryManager(memoryManager){
+        bindlessTextures = memoryManager->getDevice()->getBindlessTextures();
+    }
+
+    ~VulkanTextureArrays(){
+        for(const auto& [index, array] : arrays){
+            bindlessTextures->remove(index);
+        }
+    }
+
+    bool canPack(VulkanImageData& data){
+        auto [width, height] = data.getResolution();
+        return data.getLayersNum() == 1 && !data.isCubemap() && std::max(width, height) <= maxSize;
+    }
+
+    // Uploads the texture to a free layer of an array of its kind, returns the packed bindless index
+    uint32_t add(VulkanImageData& data, const VulkanSamplerDescription& samplerDescription){
+        auto [width, height] = data.getResolution();
+        uint32_t arrayIndex = getFreeArray({width, height, data.getFormat(), data.getMipLevelsNum()}, samplerDescription); // counts the texture in
+        textureArray& array = arrays.at(arrayIndex);
+
+        uint32_t layer = 0;
+        while(array.usedLayers[layer]){
+            layer++;
+        }
+
+        upload(array, data, layer);
+
+        array.usedLayers[layer] = true;
+
+        return packedBit | (layer << layerShift) | arrayIndex;
+    }
+
+    // Arrays without textures are released, frames are synchronous so nothing samples them anymore
+    void remove(uint32_t index){
+        auto it = arrays.find(getArrayIndex(index));
+        if(it == arrays.end()){
+            return;
+        }
+
+        textureArray& array = it->second;
+        array.usedLayers[getLayer(index)] = false;
+
+        if(--array.used == 0){
+            bindlessTextures->remove(it->first);
+            arrays.erase(it);
+        }
+    }
+
+    // Layer views of an older generation are of a replaced image, textures create them again
+    uint64_t getGeneration(uint32_t index){
+        return arrays.at(getArrayIndex(index)).generation;
+    }
+
+    // The array's image split among its textures, so the residency budget sees the unused layers too
+    VkDeviceSize getTextureBytes(uint32_t index){
+        const textureArray& array = arrays.at(getArrayIndex(index));
+        return array.image->getSize() / array.used;
+    }
+
+    // View of the texture's layer alone, for descriptor sets outside of the bindless table
+    std::shared_ptr<VulkanImageView> createLayerView(uint32_t index){
+        textureArray& array = arrays.at(getArrayIndex(index));
+        return array.image->createImageView(VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D, 1, getLayer(index), 0, array.image->getMipLevels());
+    }
+
+    static bool isPacked(uint32_t index){
+        return (index & packedBit) != 0;
+    }
+
+    arraysStats getStats(){
+        arraysStats stats;
+
+        for(const auto& [index, array] : arrays){
+            stats.arrays++;
+            stats.textures += array.used;
+            stats.layers += array.image->getArrayLayers();
+            stats.bytes += array.image->getSize();
+        }
+
+        return stats;
+    }
+
+private:
+    static uint32_t getArrayIndex(uint32_t index){
+        return index & ((1u << layerShift) - 1);
+    }
+
+    static uint32_t getLayer(uint32_t index){
+        return (index & ~packedBit) >> layerShift;
+    }
+
+    // The texture is counted before any allocation, evictions for the allocation's budget can remove other textures of the array
+    uint32_t getFreeArray(arrayKey key, const VulkanSamplerDescription& samplerDescription){
+        for(auto& [index, array] : arrays){
+            if(array.key == key && array.samplerDescription == samplerDescription && array.used < layersPerArray){
+                if(++array.used > array.usedLayers.size()){
+                    grow(index, array);
+                }
+                return index;
+            }
+        }
+
+        textureArray array;
+        array.used = 1;
+        array.key = key;
+        array.samplerDescription = samplerDescription;
+        array.sampler = memoryManager->getDevice()->getTextureSampler(samplerDescription);
+        createImage(array, 1);
+
+        uint32_t index = bindlessTextures->add(*array.view, *array.sampler, VulkanBindlessTextures::Texture2DArray);
+        arrays.insert({index, std::move(array)});
+
+        return index;
+    }
+
+    void createImage(textureArray& array, uint32_t layers){
+        auto [width, height, format, mipLevels] = array.key;
+
+        array.image = std::make_shared<VulkanImage>(memoryManager, std::pair<uint32_t, uint32_t>(width, height), VulkanImage::constructParameters{.layers = layers, .format = format, .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, .mipLevels = mipLevels, .category = VulkanMemoryManager::Category::Textures});
+        array.image->setOwner(std::format("Texture array {}x{}", width, height));
+        array.view = array.image->createImageView(VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, layers, 0, 0, mipLevels);
+        array.usedLayers.resize(layers, false);
+        array.generation = ++generations;
+    }
+
+    // The old image lives on in the layer views of its textures until they are created again
+    void grow(uint32_t index, textureArray& array){
+        std::shared_ptr<VulkanImage> oldImage = array.image;
+        uint32_t oldLayers = oldImage->getArrayLayers();
+
+        createImage(array, std::min(oldLayers * 2, layersPerArray));
+
+        array.image->transitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        oldImage->copyLayersToImage(*array.image, 0, oldLayers);
+        array.image->transitionImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        bindlessTextures->update(index, *array.view, *array.sampler, VulkanBindlessTextures::Texture2DArray);
+    }
+
+    void upload(textureArray& array, VulkanImageData& data, uint32_t layer){
+        VulkanStagingBuffer<uint8_t> stagingBuffer(memoryManager, data.data(), data.size());
+
+        std::vector<VkDeviceSize> levelOffsets;
+        for(uint32_t level = 0; level < data.getMipLevelsNum(); level++){
+            levelOffsets.push_back(data.getMipOffset(level));
+        }
+
+        array.image->transitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        array.image->copyBufferToImage(stagingBuffer, *array.image, levelOffsets, layer, 1);
+        array.image->transitionImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+};
+
+
+}
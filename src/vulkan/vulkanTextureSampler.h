@@ -11,52 +11,119 @@
 #include <cstdint> 
 #include <limits> 
 #include <algorithm> 
+#include <functional>
 
 namespace MSIVulkanDemo{
 
 
+// Full sampler state, equal descriptions share one sampler through VulkanDevice::getTextureSampler
+struct VulkanSamplerDescription{
+    VkFilter magFilter = VK_FILTER_LINEAR;
+    VkFilter minFilter = VK_FILTER_LINEAR;
+    VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT; // of U, V and W
+    float maxAnisotropy = 16.0f; // clamped to the device limit, 1 disables anisotropic filtering
+    float mipLodBias = 0.0f;
+    float minLod = 0.0f;
+    float maxLod = VK_LOD_CLAMP_NONE; // the view limits the levels
+    bool compareEnable = false;
+    VkCompareOp compareOp = VK_COMPARE_OP_ALWAYS;
+    VkBorderColor borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+
+    bool operator==(const VulkanSamplerDescription&) const = default;
+
+    // Depth comparison for shadow maps, filtering gives 2x2 PCF, outside of the map is lit
+    static VulkanSamplerDescription comparison(VkCompareOp compareOp){
+        return {
+            .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+            .addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+            .maxAnisotropy = 1.0f,
+            .maxLod = 0.0f,
+            .compareEnable = true,
+            .compareOp = compareOp,
+            .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE
+        };
+    }
+
+    struct hash{
+        size_t operator()(const VulkanSamplerDescription& description) const{
+            size_t seed = 0;
+
+            auto combine = [&](size_t value){
+                seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            };
+
+            combine(std::hash<int>()(description.magFilter));
+            combine(std::hash<int>()(description.minFilter));
+            combine(std::hash<int>()(description.mipmapMode));
+            combine(std::hash<int>()(description.addressMode));
+            combine(std::hash<float>()(description.maxAnisotropy));
+            combine(std::hash<float>()(description.mipLodBias));
+            combine(std::hash<float>()(description.minLod));
+            combine(std::hash<float>()(description.maxLod));
+            combine(std::hash<bool>()(description.compareEnable));
+            combine(std::hash<int>()(description.compareOp));
+            combine(std::hash<int>()(description.borderColor));
+
+            return seed;
+        }
+    };
+};
+
+
 class VulkanTextureSampler{
 private:
     std::shared_ptr<VulkanDeviceI> device;
 
     VkSampler textureSampler;
+    VulkanSamplerDescription description;
     
 public:
-    VulkanTextureSampler(std::shared_ptr<VulkanDeviceI> device): device(device){
+    VulkanTextureSampler(std::shared_ptr<VulkanDeviceI> device, VulkanSamplerDescription description = {}): device(device), description(description){
+
+        float maxAnisotropy = std::min(description.maxAnisotropy, device->getPhysicalDevice().getProperties().limits.maxSamplerAnisotropy);
 
         VkSamplerCreateInfo samplerInfo{};
         samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-        samplerInfo.magFilter = VK_FILTER_LINEAR;
-        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.magFilter = description.magFilter;
+        samplerInfo.minFilter = description.minFilter;
 
-        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeU = description.addressMode;
+        samplerInfo.addressModeV = description.addressMode;
+        samplerInfo.addressModeW = description.addressMode;
 
-        samplerInfo.anisotropyEnable = VK_TRUE;
-        samplerInfo.maxAnisotropy = device->getPhysicalDevice().getProperties().limits.maxSamplerAnisotropy;
+        samplerInfo.anisotropyEnable = maxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+        samplerInfo.maxAnisotropy = std::max(maxAnisotropy, 1.0f);
 
-        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        samplerInfo.borderColor = description.borderColor;
         samplerInfo.unnormalizedCoordinates = VK_FALSE;
-        samplerInfo.compareEnable = VK_FALSE;
-        samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+        samplerInfo.compareEnable = description.compareEnable ? VK_TRUE : VK_FALSE;
+        samplerInfo.compareOp = description.compareOp;
         
-        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-        samplerInfo.mipLodBias = 0.0f;
-        samplerInfo.minLod = 0.0f;
-        samplerInfo.maxLod = 0.0f;
+        samplerInfo.mipmapMode = description.mipmapMode;
+        samplerInfo.mipLodBias = description.mipLodBias;
+        samplerInfo.minLod = description.minLod;
+        samplerInfo.maxLod = description.maxLod;
 
         if (VkResult errCode = vkCreateSampler(*device, &samplerInfo, nullptr, &textureSampler); errCode != VK_SUCCESS) {
             throw std::runtime_error(std::format("failed to create texture sampler: {}", static_cast<int>(errCode)));
         }
     }
 
-    ~VulkanTextureSampler(){}
+    ~VulkanTextureSampler(){
+        if(textureSampler){
+            vkDestroySampler(*device, textureSampler, nullptr);
+        }
+    }
 
     operator VkSampler() const{
         return textureSampler;
     }
 
+    const VulkanSamplerDescription& getDescription(){
+        return description;
+    }
+
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,314 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "interface/vulkanSwapChainI.h"
+#include "vulkanMemory.h"
+
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+namespace MSIVulkanDemo{
+
+
+class VulkanTransientResources{
+public:
+    struct resourceDescription{
+        VkFormat format;
+        VkImageUsageFlags usage;
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        bool external = false; // content has to survive the pass (stored, sampled later or kept across frames)
+    };
+
+    struct memoryStats{
+        VkDeviceSize requestedSize = 0; // sum of all resources as if every one had its own memory
+        VkDeviceSize aliasedSize = 0; // memory actually allocated after aliasing
+        VkDeviceSize lazySize = 0; // lazily allocated memory, not backed by physical pages on tilers
+        uint32_t resourceCount = 0;
+        uint32_t allocationCount = 0;
+    };
+
+private:
+    struct resource{
+        resourceDescription description;
+        std::vector<uint32_t> users; // positions of nodes in execution order
+        bool isTransient = false;
+        bool isLazy = false;
+        uint32_t slot = 0;
+
+        std::shared_ptr<VulkanImage> image;
+        std::shared_ptr<VulkanImageView> view;
+        VkMemoryRequirements requirements = {};
+
+        uint32_t firstUse() const{
+            return *std::min_element(users.begin(), users.end());
+        }
+
+        uint32_t lastUse() const{
+            return *std::max_element(users.begin(), users.end());
+        }
+    };
+
+    struct memorySlot{
+        VmaAllocation allocation = nullptr;
+        VkDeviceSize size = 0;
+        VkDeviceSize alignment = 1;
+        uint32_t memoryTypeBits = std::numeric_limits<uint32_t>::max();
+        bool isLazy = false;
+        std::vector<std::pair<uint32_t, uint32_t>> lifetimes;
+
+        bool overlaps(uint32_t first, uint32_t last) const{
+            for(const auto& [begin, end] : lifetimes){
+                if(first <= end && begin <= last){
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    std::shared_ptr<VulkanMemoryManager> memoryManager;
+
+    std::map<std::string, resource> resources;
+    std::vector<memorySlot> slots;
+
+    memoryStats stats;
+    bool isAllocated = false;
+
+public:
+    VulkanTransientResources(std::shared_ptr<VulkanMemoryManager> memoryManager): memoryManager(memoryManager){
+
+    }
+
+    ~VulkanTransientResources(){
+        release();
+    }
+
+    void declare(std::string name, resourceDescription description){
+        if(resources.contains(name)){
+            resources.at(name).description.usage |= description.usage;
+            resources.at(name).description.external |= description.external;
+            return;
+        }
+
+        resources.insert({name, resource{.description = description}});
+    }
+
+    bool contains(std::string name){
+        return resources.contains(name);
+    }
+
+    void addUse(std::string name, uint32_t nodeOrder){
+        resources.at(name).users.push_back(nodeOrder);
+    }
+
+    void clearUses(){
+        for(auto& [name, res] : resources){
+            res.users.clear();
+        }
+    }
+
+    std::shared_ptr<VulkanImageView> getImageView(std::string name){
+        return resources.at(name).view;
+    }
+
+    std::shared_ptr<VulkanImage> getImage(std::string name){
+        return resources.at(name).image;
+    }
+
+    bool isTransient(std::string name){
+        return resources.at(name).isTransient;
+    }
+
+    memoryStats getStats(){
+        return stats;
+    }
+
+    void allocate(VkExtent2D extent){
+
+        if(isAllocated){
+            release();
+        }
+
+        stats = memoryStats();
+
+        for(auto& [name, res] : resources){
+            if(res.users.empty()){
+                continue;
+            }
+
+            res.isTransient = !res.description.external && res.users.size() == 1;
+
+            VkImageUsageFlags usage = res.description.usage;
+            if(res.isTransient){
+                usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+            }
+
+            if(!res.image){
+                res.image = memoryManager->createImage<VulkanImage>(
+                    std::pair<uint32_t, uint32_t>({extent.width, extent.height}),
+                    VulkanImage::constructParameters({
+                        .format = res.description.format,
+                        .tiling = VK_IMAGE_TILING_OPTIMAL,
+                        .usage = usage,
+                        .deferAllocation = true
+                    })
+                );
+            }else{
+                res.image->resize({extent.width, extent.height});
+            }
+
+            res.requirements = res.image->getMemoryRequirements();
+            res.isLazy = res.isTransient && supportsLazyAllocation(res.requirements.memoryTypeBits);
+
+            stats.requestedSize += res.requirements.size;
+            stats.resourceCount++;
+        }
+
+        assignSlots();
+
+        for(auto& slot : slots){
+            allocateSlot(slot);
+        }
+
+        for(auto& [name, res] : resources){
+            if(res.users.empty()){
+                continue;
+            }
+
+            res.image->bindMemory(slots[res.slot].allocation);
+
+            if(!res.view){
+                res.view = res.image->createImageView(res.description.aspect);
+            }else{
+                res.view->recreate();
+            }
+        }
+
+        isAllocated = true;
+    }
+
+    void resize(VkExtent2D extent){
+        if(!isAllocated){
+            return;
+        }
+
+        allocate(extent);
+    }
+
+    void release(){
+        for(auto& slot : slots){
+            if(slot.allocation){
+                memoryManager->unregisterAllocation(slot.allocation);
+                vmaFreeMemory(*memoryManager, slot.allocation);
+            }
+        }
+        slots.clear();
+
+        isAllocated = false;
+    }
+
+private:
+
+    bool supportsLazyAllocation(uint32_t memoryTypeBits){
+        VmaAllocationCreateInfo allocInfo = {};
+        allocInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+
+        uint32_t memoryTypeIndex;
+        return vmaFindMemoryTypeIndex(*memoryManager, memoryTypeBits, &allocInfo, &memoryTypeIndex) == VK_SUCCESS;
+    }
+
+    void assignSlots(){
+        std::vector<resource*> order;
+
+        for(auto& [name, res] : resources){
+            if(!res.users.empty()){
+                order.push_back(&res);
+            }
+        }
+
+        // Biggest first, so smaller resources fill the gaps of the big ones
+        std::sort(order.begin(), order.end(), [](resource* a, resource* b){
+            return a->requirements.size > b->requirements.size;
+        });
+
+        for(resource* res : order){
+            uint32_t first = res->firstUse(), last = res->lastUse();
+            bool placed = false;
+
+            for(uint32_t i = 0; i < slots.size() && !placed; i++){
+                auto& slot = slots[i];
+
+                if(slot.isLazy != res->isLazy || (slot.memoryTypeBits & res->requirements.memoryTypeBits) == 0 || slot.overlaps(first, last)){
+                    continue;
+                }
+
+                slot.size = std::max(slot.size, res->requirements.size);
+                slot.alignment = std::max(slot.alignment, res->requirements.alignment);
+                slot.memoryTypeBits &= res->requirements.memoryTypeBits;
+                slot.lifetimes.push_back({first, last});
+                res->slot = i;
+                placed = true;
+            }
+
+            if(!placed){
+                memorySlot slot;
+                slot.size = res->requirements.size;
+                slot.alignment = res->requirements.alignment;
+                slot.memoryTypeBits = res->requirements.memoryTypeBits;
+                slot.isLazy = res->isLazy;
+                slot.lifetimes.push_back({first, last});
+
+                res->slot = slots.size();
+                slots.push_back(slot);
+            }
+        }
+    }
+
+    void allocateSlot(memorySlot& slot){
+        VkMemoryRequirements memRequirements = {};
+        memRequirements.size = slot.size;
+        memRequirements.alignment = slot.alignment;
+        memRequirements.memoryTypeBits = slot.memoryTypeBits;
+
+        VmaAllocationCreateInfo allocInfo = {};
+        if(slot.isLazy){
+            allocInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+        }else{
+            allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        }
+        allocInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+        // Lazily allocated memory has almost no backing, it is left out of the render target pools and the budget
+        if(!slot.isLazy){
+            uint32_t memoryTypeIndex;
+            if (VkResult errCode = vmaFindMemoryTypeIndex(*memoryManager, slot.memoryTypeBits, &allocInfo, &memoryTypeIndex); errCode != VK_SUCCESS) {
+                throw std::runtime_error(std::format("failed to find transient memory type: {}", static_cast<int>(errCode)));
+            }
+
+            memoryManager->prepareAllocation(VulkanMemoryManager::Category::RenderTargets, memoryTypeIndex, slot.size, allocInfo);
+        }
+
+        if (VkResult errCode = vmaAllocateMemory(*memoryManager, &memRequirements, &allocInfo, &slot.allocation, nullptr); errCode != VK_SUCCESS) {
+            throw std::runtime_error(std::format("failed to allocate transient memory: {}", static_cast<int>(errCode)));
+        }
+
+        memoryManager->registerAllocation(slot.allocation, VulkanMemoryManager::Category::RenderTargets, "RenderGraph transient attachments");
+
+        if(slot.isLazy){
+            stats.lazySize += slot.size;
+        }else{
+            stats.aliasedSize += slot.size;
+        }
+        stats.allocationCount++;
+    }
+
+};
+
+
+
+}
@@ -5,6 +5,7 @@
 
 #include "interface/vulkanDeviceI.h"
 #include "interface/vulkanBufferI.h"
+#include "vulkanTextureSampler.h"
 
 #include <iostream>
 #include <vector>
@@ -25,6 +26,7 @@ public:
         std::string name;
         size_t size;
         uint32_t componentCount;
+        bool bindlessTexture = false; // Texture2D/TextureCube index into the bindless table, componentCount 6 for cubemaps
     };
 
     struct bindingBlock{
@@ -42,6 +44,7 @@ private:
 
     size_t descriptorSize = 0;
     std::weak_ptr<VulkanUniformLayout> uniformLayout;
+    std::map<std::string, std::shared_ptr<VulkanTextureSampler>> immutableSamplers; // baked into the layout, by sampler name
 
     const size_t minOffset;
 
@@ -63,7 +66,7 @@ public:
         }
     }
 
-    VulkanUniformData(VulkanUniformData& copy): attributes(copy.attributes), uniformLayout(copy.uniformLayout), blocks(copy.blocks), descriptorSize(copy.descriptorSize), minOffset(copy.minOffset){
+    VulkanUniformData(VulkanUniformData& copy): attributes(copy.attributes), uniformLayout(copy.uniformLayout), immutableSamplers(copy.immutableSamplers), blocks(copy.blocks), descriptorSize(copy.descriptorSize), minOffset(copy.minOffset){
 
     }
 
@@ -119,6 +122,10 @@ public:
         return attributes.at(name);
     }
 
+    VkDescriptorType getBindingType(std::string name) const{
+        return blocks.at(attributes.at(name).binding).type;
+    }
+
     size_t getOffset(std::string name) const{
 
         auto& block = blocks.at(attributes.at(name).binding);
@@ -174,11 +181,26 @@ public:
         return attributes.count(key) > 0;
     }
 
+    // Has to be set before any layout is created from the data, sets written later ignore their own sampler for it
+    void setImmutableSampler(std::string name, std::shared_ptr<VulkanTextureSampler> sampler){
+        if(getBindingType(name) != VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER){
+            throw std::runtime_error(std::format("Immutable sampler needs a combined image sampler: {}", name));
+        }
+
+        immutableSamplers.insert_or_assign(name, sampler);
+    }
+
+    std::shared_ptr<VulkanTextureSampler> getImmutableSampler(std::string name) const{
+        auto it = immutableSamplers.find(name);
+        return it != immutableSamplers.end() ? it->second : nullptr;
+    }
+
     VulkanUniformData operator+(VulkanUniformData& other){
         VulkanUniformData newUniformData(*this);
 
         newUniformData.blocks.insert(other.blocks.begin(), other.blocks.end()); // FIXME merge "blocks"
         newUniformData.attributes.insert(other.attributes.begin(), other.attributes.end());
+        newUniformData.immutableSamplers.insert(other.immutableSamplers.begin(), other.immutableSamplers.end());
 
         newUniformData.descriptorSize = 0;
 
@@ -196,9 +218,92 @@ public:
 };
 
 
+// Members of the push constant blocks of all stages, pushed as one range visible to every stage declaring a block
+class VulkanPushConstantData{
+public:
+    struct attribute{
+        std::string name;
+        uint32_t offset;
+        uint32_t size;
+        uint32_t componentCount;
+    };
+
+private:
+    std::map<std::string, attribute> attributes;
+
+    uint32_t size = 0;
+    VkShaderStageFlags stages = 0;
+
+public:
+    VulkanPushConstantData(std::vector<attribute> attribs, VkShaderStageFlags stage){
+        for(auto& attrib : attribs){
+            attributes.insert({attrib.name, attrib});
+            size = std::max(size, attrib.offset + attrib.size);
+        }
+
+        if(size > 0){
+            stages = stage;
+        }
+    }
+
+    std::vector<attribute> getAttributes() const{
+        std::vector<attribute> attribs;
+
+        for(const auto& [key, val] : attributes){
+            attribs.push_back(val);
+        }
+
+        return attribs;
+    }
+
+    attribute getAttribute(std::string name) const{
+        return attributes.at(name);
+    }
+
+    size_t getOffset(std::string name) const{
+        return attributes.at(name).offset;
+    }
+
+    uint32_t getSize() const{
+        return size;
+    }
+
+    VkShaderStageFlags getStages() const{
+        return stages;
+    }
+
+    bool contains(std::string key) const{
+        return attributes.count(key) > 0;
+    }
+
+    // Stages declaring the same member have to agree on its layout
+    VulkanPushConstantData operator+(const VulkanPushConstantData& other) const{
+        VulkanPushConstantData newData(*this);
+
+        for(const auto& [key, attrib] : other.attributes){
+            if(newData.attributes.contains(key) && newData.attributes.at(key).offset != attrib.offset){
+                throw std::runtime_error(std::format("Push constant {} has different offsets in shader stages", key));
+            }
+            newData.attributes.insert({key, attrib});
+        }
+
+        newData.size = std::max(size, other.size);
+        newData.stages = stages | other.stages;
+
+        return newData;
+    }
+
+    VkPushConstantRange getRange() const{
+        return {stages, 0, size};
+    }
+
+};
+
+
 class VulkanUniformLayout{
 private:
     std::shared_ptr<VulkanDeviceI> device;
+    std::vector<std::shared_ptr<VulkanTextureSampler>> immutableSamplers; // kept alive with the layout
 
     VkDescriptorSetLayout descriptorSetLayout = nullptr;
 
@@ -206,6 +311,7 @@ public:
     VulkanUniformLayout(std::shared_ptr<VulkanDeviceI> device, const VulkanUniformData& uniformData): device(device){
 
         std::vector<VkDescriptorSetLayoutBinding> bindings;
+        std::vector<VkSampler> samplers(uniformData.getBindings().size()); // one per binding at most, pointed to by the bindings
 
         for(const auto& binding : uniformData.getBindings()){
             VkDescriptorSetLayoutBinding uboLayoutBinding = {};
@@ -215,6 +321,14 @@ public:
             uboLayoutBinding.stageFlags = VK_SHADER_STAGE_ALL;
             uboLayoutBinding.pImmutableSamplers = nullptr;
 
+            if(binding.type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER){
+                if(auto sampler = uniformData.getImmutableSampler(binding.attribs[0].name)){
+                    immutableSamplers.push_back(sampler);
+                    samplers[bindings.size()] = *sampler;
+                    uboLayoutBinding.pImmutableSamplers = &samplers[bindings.size()];
+                }
+            }
+
             bindings.push_back(uboLayoutBinding);
         }
 
@@ -246,6 +360,13 @@ public:
 
 class VulkanDescriptorSet;
 
+// Part of a descriptor set's uniform data with the version of its last change
+struct VulkanUniformRange{
+    uint32_t offset;
+    uint32_t size;
+    uint64_t version;
+};
+
 class VulkanDescriptorPool{
 private:
     VkDescriptorPool descriptorPool = nullptr;
@@ -255,7 +376,7 @@ private:
     std::vector<std::weak_ptr<VulkanDescriptorSet>> sets;
 
 public:
-    VulkanDescriptorPool(std::shared_ptr<VulkanDeviceI> device, std::vector<std::pair<VkDescriptorType, uint32_t>> customSizes = {}): device(device){
+    VulkanDescriptorPool(std::shared_ptr<VulkanDeviceI> device, std::vector<std::pair<VkDescriptorType, uint32_t>> customSizes = {}, VkDescriptorPoolCreateFlags flags = 0): device(device){
 
         std::vector<VkDescriptorPoolSize> poolSizes;
 
@@ -275,10 +396,15 @@ public:
             poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
             poolSize.descriptorCount = 3;
             poolSizes.push_back(poolSize);
+
+            poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            poolSize.descriptorCount = 3;
+            poolSizes.push_back(poolSize);
         }
 
         VkDescriptorPoolCreateInfo poolInfo = {};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = flags;
         poolInfo.poolSizeCount = poolSizes.size();
         poolInfo.pPoolSizes = poolSizes.data();
         poolInfo.maxSets = 1000; // TODO to count
@@ -316,12 +442,15 @@ private:
 
     std::shared_ptr<VulkanBufferI> uniformBuffer;
     std::map<std::string, std::pair<VkImageView, VkSampler>> textures;
-    VkImageView defaultImageView;
-    VkSampler defaultSampler;
+    std::map<std::string, std::pair<VkBuffer, VkDeviceSize>> buffers; // storage buffers owned by the engine, bound by block instance name
+    VkImageView defaultImageView = VK_NULL_HANDLE;
+    VkSampler defaultSampler = VK_NULL_HANDLE;
 
     VkDescriptorSet descriptorSet = nullptr;
     size_t offset;
 
+    std::vector<uint64_t> uploadedVersions; // of the VulkanUniformRange held in this set's part of the uniform buffer
+
 public:
     VulkanDescriptorSet(VulkanDescriptorPool* descriptorPool, std::shared_ptr<VulkanUniformLayout> layout, std::shared_ptr<VulkanBufferI> uniformBuffer, size_t offset): descriptorPool(descriptorPool), layout(layout), uniformBuffer(uniformBuffer), offset(offset){
 
@@ -344,10 +473,23 @@ public:
         return offset;
     }
 
+    // The set's part of the uniform buffer keeps its data between frames, only changed ranges have to be written again
+    bool isUploaded(size_t range, uint64_t version) const{
+        return range < uploadedVersions.size() && uploadedVersions[range] == version;
+    }
+
+    void setUploaded(size_t range, uint64_t version){
+        if(range >= uploadedVersions.size()){
+            uploadedVersions.resize(range + 1, 0);
+        }
+        uploadedVersions[range] = version;
+    }
+
     operator VkDescriptorSet() const{
         return descriptorSet;
     }
 
+    // Storage images are set without a sampler and have to be in GENERAL layout when used
     void setTexture(std::string name, VkImageView view, VkSampler sampler){
         if(textures.contains(name)){
             textures.at(name) = {view, sampler};
@@ -356,6 +498,10 @@ public:
         }
     }
 
+    void setBuffer(std::string name, VkBuffer buffer, VkDeviceSize range = VK_WHOLE_SIZE){
+        buffers.insert_or_assign(name, std::pair<VkBuffer, VkDeviceSize>{buffer, range});
+    }
+
     void writeDescriptorSet(const VulkanUniformData& uniformData){
         
         std::vector<VkWriteDescriptorSet> sets;
@@ -402,9 +548,12 @@ public:
                 if(textures.contains(name)){
                     sampler = textures.at(name).second;
                     view = textures.at(name).first;
-                }else{
+                }else if(defaultImageView){
                     sampler = defaultSampler;
                     view = defaultImageView;
+                }else{
+                    std::cout << std::format("Texture {} was not provided", name) << std::endl;
+                    continue;
                 }
 
                 
@@ -419,6 +568,42 @@ public:
                 imgCounter++;
                 break;
 
+            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+
+                if(!textures.contains(name)){
+                    std::cout << std::format("Storage image {} was not provided", name) << std::endl;
+                    continue;
+                }
+
+                imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                imageInfo.imageView = textures.at(name).first;
+                imageInfo.sampler = VK_NULL_HANDLE;
+                imageInfos[imgCounter] = imageInfo;
+
+                descriptorWrite.descriptorCount = 1;
+                descriptorWrite.pImageInfo = &imageInfos[imgCounter];
+
+                imgCounter++;
+                break;
+
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+
+                if(!buffers.contains(name)){
+                    std::cout << std::format("Storage buffer {} was not provided", name) << std::endl;
+                    continue;
+                }
+
+                bufferInfo.buffer = buffers.at(name).first;
+                bufferInfo.offset = 0;
+                bufferInfo.range = buffers.at(name).second;
+                bufferInfos[bufCounter] = bufferInfo;
+
+                descriptorWrite.descriptorCount = 1;
+                descriptorWrite.pBufferInfo = &bufferInfos[bufCounter];
+
+                bufCounter++;
+                break;
+
             default:
                 std::cout << "Unsupported descriptor type" << std::endl;
                 continue;